@@ -0,0 +1,681 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#define _XOPEN_SOURCE 700
+
+#include <ftw.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "detector.h"
+#include "detector_file.h"
+#include "hal.h"
+#include "labels.h"
+#include "pipeline.h"
+#include "program.h"
+#include "softmax.h"
+#include "wav.h"
+#include "xstatus.h"
+
+/*
+ * Scores a corpus of one second clips through the firmware pipeline
+ * (STFT, model input layout, inference, softmax and argmax) on many
+ * threads and reports throughput, accuracy and the confusion matrix.
+ *
+ * Usage: batch [-j threads] [-s] [-p model.tprog] [-c model.tdata]
+ *              [-l model.labels] [-d detector.bin | -t detector.bin]
+ *              [-r recall] path...
+ *
+ * Paths are WAV files (.wav), raw 16-bit PCM files at 16kHz (.pcm or
+ * .raw) or directories searched for them recursively. The expected
+ * command is the name of the directory containing the clip as in the
+ * speech commands dataset. Clips in directories not named after one of
+ * the labels are expected to be "_unknown_".
+ *
+ * With -s the corpus is scored with 1, 2, 4 and so on threads up to
+ * the number given with -j to show how throughput scales with cores.
+ *
+ * The keyword detector of the cascade in vitis/detector.h is evaluated
+ * with -d, or trained on the corpus and written with -t. The detector
+ * is trained to pass the clips on which the full model decides a
+ * command, that is its most probable class has a threshold in the
+ * labels file and is above it, so no labelled corpus is needed. It is
+ * a logistic regression on the standardized features, and the threshold
+ * is set to pass the fraction given with -r of those clips. The report
+ * has the fraction of clips passed, which is the fraction of inferences
+ * left to the TCU, the recall of the full model decisions and of the
+ * clips of commands, and the time the detector takes per window.
+ */
+
+#define BATCH_DEFAULT_PROG "model/speech_commands_onnx_speech_robot.tprog"
+#define BATCH_DEFAULT_CONSTS "model/speech_commands_onnx_speech_robot.tdata"
+#define BATCH_DEFAULT_LABELS "model/speech_commands.labels"
+#define BATCH_DEFAULT_RECALL 0.95
+
+#define BATCH_MAX_DESCRIPTORS 16
+
+/*
+ * Training is a full batch gradient descent. Weights are quantized so
+ * that the largest is BATCH_MAX_WEIGHT, which keeps the score of the
+ * largest features within 32 bits.
+ */
+
+#define BATCH_TRAIN_ITERATIONS 2000
+#define BATCH_TRAIN_RATE 0.5
+#define BATCH_TRAIN_L2 1e-3
+#define BATCH_MAX_WEIGHT 8191
+
+static struct labels labels;
+static size_t unknown_command;
+
+struct clip {
+    const char *path;
+    struct wav wav;
+    size_t expected;
+    size_t predicted;
+    double probability;
+
+    /*
+     * Whether the full model decides on a command, the features of the
+     * keyword detector and the time taken by it and by the pipeline.
+     */
+
+    bool decided;
+    u16 features[DETECTOR_FEATURES];
+    u64 detector_ns;
+    u64 pipeline_ns;
+};
+
+struct batch {
+    const struct program *program;
+
+    struct clip *clips;
+    size_t clips_length;
+    size_t clips_capacity;
+
+    atomic_size_t next;
+    atomic_int status;
+};
+
+static struct batch batch;
+
+static u64 get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool has_suffix(const char *path, const char *suffix) {
+    size_t path_length = strlen(path);
+    size_t suffix_length = strlen(suffix);
+
+    return path_length >= suffix_length &&
+           !strcmp(path + path_length - suffix_length, suffix);
+}
+
+static size_t get_expected_command(const char *path) {
+    const char *end = strrchr(path, '/');
+
+    if (!end)
+        return unknown_command;
+
+    const char *start = end;
+
+    while (start > path && start[-1] != '/')
+        start--;
+
+    size_t i = labels_find(&labels, start, end - start);
+
+    return i < labels.length ? i : unknown_command;
+}
+
+static int add_clip(const char *path) {
+    struct wav wav;
+    int status;
+
+    if (has_suffix(path, ".wav"))
+        status = wav_read(path, &wav);
+    else if (has_suffix(path, ".pcm") || has_suffix(path, ".raw"))
+        status = wav_read_pcm(path, HAL_ACQ_SAMPLE_RATE, &wav);
+    else
+        return XST_SUCCESS;
+
+    if (status != XST_SUCCESS) {
+        fprintf(stderr, "warning: cannot read %s\n", path);
+        return XST_SUCCESS;
+    }
+
+    if (wav.sample_rate != HAL_ACQ_SAMPLE_RATE)
+        fprintf(stderr, "warning: %s is sampled at %u Hz, not %u Hz\n", path,
+                wav.sample_rate, HAL_ACQ_SAMPLE_RATE);
+
+    if (batch.clips_length == batch.clips_capacity) {
+        size_t capacity = batch.clips_capacity ? 2 * batch.clips_capacity : 64;
+        struct clip *clips =
+            realloc(batch.clips, capacity * sizeof(struct clip));
+
+        if (!clips) {
+            wav_free(&wav);
+            return XST_FAILURE;
+        }
+
+        batch.clips = clips;
+        batch.clips_capacity = capacity;
+    }
+
+    struct clip *clip = &batch.clips[batch.clips_length++];
+
+    clip->path = strdup(path);
+    clip->wav = wav;
+    clip->expected = get_expected_command(path);
+
+    return XST_SUCCESS;
+}
+
+static int add_clip_entry(const char *path, const struct stat *sb, int type,
+                          struct FTW *ftw) {
+    (void)sb;
+    (void)ftw;
+
+    if (type != FTW_F)
+        return 0;
+
+    return add_clip(path) != XST_SUCCESS;
+}
+
+static int compare_clips(const void *a, const void *b) {
+    return strcmp(((const struct clip *)a)->path,
+                  ((const struct clip *)b)->path);
+}
+
+/*
+ * Pushes the resized input, which the pipeline leaves in the first lane
+ * of DRAM0 vectors, through the keyword detector as the firmware does
+ * with its rows.
+ */
+
+static void detect(const struct pipeline *pipeline, struct clip *clip) {
+    const TCU_DT *input = (const TCU_DT *)pipeline->dram0_ptr +
+                          PIPELINE_RESIZED_OFFSET_VECTORS * TCU_VECTOR_LENGTH;
+    struct detector detector;
+    static const struct detector_params params;
+
+    detector_init(&detector, NULL);
+
+    for (size_t i = 0; i < RESIZE_HEIGHT; i++)
+        detector_push_row(&detector,
+                          &input[i * RESIZE_WIDTH * TCU_VECTOR_LENGTH],
+                          TCU_VECTOR_LENGTH);
+
+    detector_get_features(&detector, clip->features);
+
+    /*
+     * The score is computed to be timed with the features.
+     */
+
+    volatile int32_t score = detector_get_score(&params, clip->features);
+    (void)score;
+}
+
+static void *score_clips(void *arg) {
+    struct pipeline *pipeline = arg;
+    TCU_DT logits[PIPELINE_OUTPUT_LENGTH];
+
+    while (true) {
+        size_t i = atomic_fetch_add(&batch.next, 1);
+
+        if (i >= batch.clips_length)
+            break;
+
+        struct clip *clip = &batch.clips[i];
+        u64 start_ns = get_time_ns();
+
+        if (pipeline_infer(pipeline, clip->wav.samples, clip->wav.length,
+                           logits) != XST_SUCCESS) {
+            atomic_store(&batch.status, XST_FAILURE);
+            break;
+        }
+
+        u64 pipeline_end_ns = get_time_ns();
+
+        detect(pipeline, clip);
+
+        clip->pipeline_ns = pipeline_end_ns - start_ns;
+        clip->detector_ns = get_time_ns() - pipeline_end_ns;
+
+        /*
+         * Softmax and argmax in fixed point as done in speech_robot.c.
+         */
+
+        struct softmax_result result;
+
+        softmax_top2(logits, PIPELINE_OUTPUT_LENGTH, &result);
+
+        clip->predicted = result.first;
+        clip->probability =
+            (double)result.probability / SOFTMAX_PROBABILITY_ONE;
+        clip->decided = labels.thresholds[result.first] &&
+                        result.probability >= labels.thresholds[result.first];
+    }
+
+    return NULL;
+}
+
+/*
+ * Scores all clips with `threads` workers, each owning its pipeline.
+ * Returns elapsed time in nanoseconds or 0 on failure.
+ */
+
+static u64 score(struct pipeline **pipelines, size_t threads) {
+    pthread_t workers[threads];
+
+    atomic_store(&batch.next, 0);
+    atomic_store(&batch.status, XST_SUCCESS);
+
+    u64 start_ns = get_time_ns();
+
+    for (size_t i = 0; i < threads; i++)
+        if (pthread_create(&workers[i], NULL, score_clips, pipelines[i]))
+            return 0;
+
+    for (size_t i = 0; i < threads; i++)
+        pthread_join(workers[i], NULL);
+
+    u64 elapsed_ns = get_time_ns() - start_ns;
+
+    return atomic_load(&batch.status) == XST_SUCCESS ? elapsed_ns : 0;
+}
+
+static void print_report() {
+    size_t confusion[PIPELINE_OUTPUT_LENGTH][PIPELINE_OUTPUT_LENGTH] = {0};
+    size_t correct = 0;
+
+    for (size_t i = 0; i < batch.clips_length; i++) {
+        struct clip *clip = &batch.clips[i];
+
+        confusion[clip->expected][clip->predicted]++;
+
+        if (clip->expected == clip->predicted)
+            correct++;
+    }
+
+    printf("accuracy: %.2f%% (%zu of %zu)\n",
+           100.0 * correct / batch.clips_length, correct,
+           batch.clips_length);
+
+    printf("\nconfusion matrix (rows are expected, columns are predicted):"
+           "\n\n%10s", "");
+
+    for (size_t j = 0; j < PIPELINE_OUTPUT_LENGTH; j++)
+        printf(" %6.6s", labels.names[j]);
+
+    printf(" %7s\n", "recall");
+
+    for (size_t i = 0; i < PIPELINE_OUTPUT_LENGTH; i++) {
+        size_t total = 0;
+
+        printf("%10s", labels.names[i]);
+
+        for (size_t j = 0; j < PIPELINE_OUTPUT_LENGTH; j++) {
+            printf(" %6zu", confusion[i][j]);
+            total += confusion[i][j];
+        }
+
+        if (total)
+            printf(" %6.1f%%\n", 100.0 * confusion[i][i] / total);
+        else
+            printf(" %7s\n", "-");
+    }
+}
+
+static int compare_scores(const void *a, const void *b) {
+    int32_t score_a = *(const int32_t *)a;
+    int32_t score_b = *(const int32_t *)b;
+
+    return (score_a > score_b) - (score_a < score_b);
+}
+
+/*
+ * Trains the detector on the features of all clips against the
+ * decisions of the full model. Positive and negative clips are weighted
+ * to contribute equally. The standardization of features is folded into
+ * the weights before they are quantized.
+ */
+
+static int train_detector(struct detector_params *params, double recall) {
+    size_t n = batch.clips_length;
+    size_t positives = 0;
+    double mean[DETECTOR_FEATURES] = {0};
+    double deviation[DETECTOR_FEATURES] = {0};
+
+    for (size_t i = 0; i < n; i++) {
+        if (batch.clips[i].decided)
+            positives++;
+
+        for (size_t k = 0; k < DETECTOR_FEATURES; k++)
+            mean[k] += (double)batch.clips[i].features[k] / n;
+    }
+
+    if (!positives || positives == n) {
+        fprintf(stderr, "full model decides on %zu of %zu clips, cannot "
+                        "train detector\n",
+                positives, n);
+        return XST_FAILURE;
+    }
+
+    for (size_t i = 0; i < n; i++)
+        for (size_t k = 0; k < DETECTOR_FEATURES; k++) {
+            double d = batch.clips[i].features[k] - mean[k];
+
+            deviation[k] += d * d / n;
+        }
+
+    for (size_t k = 0; k < DETECTOR_FEATURES; k++)
+        deviation[k] = deviation[k] > 0 ? sqrt(deviation[k]) : 1;
+
+    double weights[DETECTOR_FEATURES] = {0};
+    double bias = 0;
+    double positive_weight = 0.5 / positives;
+    double negative_weight = 0.5 / (n - positives);
+
+    for (size_t t = 0; t < BATCH_TRAIN_ITERATIONS; t++) {
+        double weight_gradients[DETECTOR_FEATURES] = {0};
+        double bias_gradient = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            const struct clip *clip = &batch.clips[i];
+            double x[DETECTOR_FEATURES];
+            double z = bias;
+
+            for (size_t k = 0; k < DETECTOR_FEATURES; k++) {
+                x[k] = (clip->features[k] - mean[k]) / deviation[k];
+                z += weights[k] * x[k];
+            }
+
+            double error = 1 / (1 + exp(-z)) - clip->decided;
+            double g =
+                error * (clip->decided ? positive_weight : negative_weight);
+
+            for (size_t k = 0; k < DETECTOR_FEATURES; k++)
+                weight_gradients[k] += g * x[k];
+
+            bias_gradient += g;
+        }
+
+        for (size_t k = 0; k < DETECTOR_FEATURES; k++)
+            weights[k] -= BATCH_TRAIN_RATE *
+                          (weight_gradients[k] + BATCH_TRAIN_L2 * weights[k]);
+
+        bias -= BATCH_TRAIN_RATE * bias_gradient;
+    }
+
+    double max_weight = 0;
+
+    for (size_t k = 0; k < DETECTOR_FEATURES; k++) {
+        weights[k] /= deviation[k];
+        bias -= weights[k] * mean[k];
+
+        if (fabs(weights[k]) > max_weight)
+            max_weight = fabs(weights[k]);
+    }
+
+    if (!max_weight)
+        return XST_FAILURE;
+
+    double scale = BATCH_MAX_WEIGHT / max_weight;
+
+    for (size_t k = 0; k < DETECTOR_FEATURES; k++)
+        params->weights[k] = (int16_t)lround(weights[k] * scale);
+
+    params->bias = (int32_t)lround(bias * scale);
+
+    /*
+     * The threshold is the lowest score that still passes `recall` of
+     * the positive clips.
+     */
+
+    int32_t *scores = malloc(positives * sizeof(int32_t));
+    size_t length = 0;
+
+    if (!scores)
+        return XST_FAILURE;
+
+    for (size_t i = 0; i < n; i++)
+        if (batch.clips[i].decided)
+            scores[length++] =
+                detector_get_score(params, batch.clips[i].features);
+
+    qsort(scores, length, sizeof(int32_t), compare_scores);
+
+    size_t index = (size_t)((1 - recall) * length);
+
+    params->threshold = scores[index < length ? index : length - 1];
+    free(scores);
+
+    return XST_SUCCESS;
+}
+
+static void print_percentage(const char *name, size_t count, size_t total) {
+    if (total)
+        printf("%s: %.1f%% (%zu of %zu)\n", name, 100.0 * count / total,
+               count, total);
+    else
+        printf("%s: -\n", name);
+}
+
+static void print_detector_report(const struct detector_params *params) {
+    size_t passed = 0;
+    size_t decided = 0, decided_passed = 0;
+    size_t commands = 0, commands_passed = 0;
+    u64 detector_ns = 0, pipeline_ns = 0;
+
+    for (size_t i = 0; i < batch.clips_length; i++) {
+        const struct clip *clip = &batch.clips[i];
+        bool is_passed =
+            detector_get_score(params, clip->features) >= params->threshold;
+
+        passed += is_passed;
+        detector_ns += clip->detector_ns;
+        pipeline_ns += clip->pipeline_ns;
+
+        if (clip->decided) {
+            decided++;
+            decided_passed += is_passed;
+        }
+
+        if (labels.thresholds[clip->expected]) {
+            commands++;
+            commands_passed += is_passed;
+        }
+    }
+
+    printf("\ndetector threshold %d, bias %d\n", params->threshold,
+           params->bias);
+    print_percentage("passed to full model", passed, batch.clips_length);
+    print_percentage("recall of full model decisions", decided_passed,
+                     decided);
+    print_percentage("recall of command clips", commands_passed, commands);
+    printf("time per window: %.2f us detector, %.0f us full model\n",
+           detector_ns / 1e3 / batch.clips_length,
+           pipeline_ns / 1e3 / batch.clips_length);
+}
+
+int main(int argc, char **argv) {
+    const char *prog_path = BATCH_DEFAULT_PROG;
+    const char *consts_path = BATCH_DEFAULT_CONSTS;
+    const char *labels_path = BATCH_DEFAULT_LABELS;
+    const char *detector_path = NULL;
+    bool train = false;
+    double recall = BATCH_DEFAULT_RECALL;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    bool sweep = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:sp:c:l:d:t:r:")) != -1) {
+        switch (opt) {
+        case 'j':
+            threads = atol(optarg);
+            break;
+        case 's':
+            sweep = true;
+            break;
+        case 'p':
+            prog_path = optarg;
+            break;
+        case 'c':
+            consts_path = optarg;
+            break;
+        case 'l':
+            labels_path = optarg;
+            break;
+        case 'd':
+            detector_path = optarg;
+            train = false;
+            break;
+        case 't':
+            detector_path = optarg;
+            train = true;
+            break;
+        case 'r':
+            recall = atof(optarg);
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-j threads] [-s] [-p model.tprog] "
+                    "[-c model.tdata] [-l model.labels] [-d detector.bin | "
+                    "-t detector.bin] [-r recall] path...\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (threads < 1)
+        threads = 1;
+
+    if (recall <= 0 || recall > 1) {
+        fprintf(stderr, "recall must be above 0 and at most 1\n");
+        return EXIT_FAILURE;
+    }
+
+    if (labels_read(labels_path, &labels) != XST_SUCCESS ||
+        labels.length != PIPELINE_OUTPUT_LENGTH) {
+        fprintf(stderr, "failed to read %zu labels from %s\n",
+                (size_t)PIPELINE_OUTPUT_LENGTH, labels_path);
+        return EXIT_FAILURE;
+    }
+
+    unknown_command = labels_find(&labels, "_unknown_", strlen("_unknown_"));
+
+    if (unknown_command == labels.length) {
+        fprintf(stderr, "no _unknown_ label in %s\n", labels_path);
+        return EXIT_FAILURE;
+    }
+
+    struct detector_params detector_params;
+
+    if (detector_path && !train &&
+        detector_file_read(detector_path, &detector_params) != XST_SUCCESS) {
+        fprintf(stderr, "failed to read %s\n", detector_path);
+        return EXIT_FAILURE;
+    }
+
+    struct program program;
+
+    if (program_read(&program, prog_path, consts_path) != XST_SUCCESS) {
+        fprintf(stderr, "failed to read %s or %s\n", prog_path, consts_path);
+        return EXIT_FAILURE;
+    }
+
+    batch.program = &program;
+
+    for (int i = optind; i < argc; i++)
+        if (nftw(argv[i], add_clip_entry, BATCH_MAX_DESCRIPTORS, 0)) {
+            fprintf(stderr, "failed to read %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+
+    if (!batch.clips_length) {
+        fprintf(stderr, "no clips found\n");
+        return EXIT_FAILURE;
+    }
+
+    qsort(batch.clips, batch.clips_length, sizeof(struct clip),
+          compare_clips);
+
+    struct pipeline *pipelines[threads];
+
+    for (long i = 0; i < threads; i++) {
+        pipelines[i] = pipeline_init(&program);
+
+        if (!pipelines[i]) {
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("clips: %zu\n\n%8s %10s %12s %10s %11s\n", batch.clips_length,
+           "threads", "clips/s", "clips/s/thr", "speedup", "efficiency");
+
+    double base_clips_per_second = 0;
+
+    for (long n = sweep ? 1 : threads; n <= threads;
+         n = n < threads && 2 * n > threads ? threads : 2 * n) {
+        u64 elapsed_ns = score(pipelines, n);
+
+        if (!elapsed_ns) {
+            fprintf(stderr, "inference failed\n");
+            return EXIT_FAILURE;
+        }
+
+        double clips_per_second = batch.clips_length * 1e9 / elapsed_ns;
+
+        printf("%8ld %10.1f %12.1f", n, clips_per_second,
+               clips_per_second / n);
+
+        if (n == 1)
+            base_clips_per_second = clips_per_second;
+
+        if (base_clips_per_second) {
+            double speedup = clips_per_second / base_clips_per_second;
+
+            printf(" %9.2fx %10.1f%%\n", speedup, 100.0 * speedup / n);
+        } else
+            printf(" %10s %11s\n", "-", "-");
+    }
+
+    printf("\n");
+    print_report();
+
+    if (train) {
+        if (train_detector(&detector_params, recall) != XST_SUCCESS ||
+            detector_file_write(detector_path, &detector_params) !=
+                XST_SUCCESS) {
+            fprintf(stderr, "failed to train %s\n", detector_path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (detector_path)
+        print_detector_report(&detector_params);
+
+    for (long i = 0; i < threads; i++)
+        pipeline_free(pipelines[i]);
+
+    for (size_t i = 0; i < batch.clips_length; i++) {
+        free((void *)batch.clips[i].path);
+        wav_free(&batch.clips[i].wav);
+    }
+
+    free(batch.clips);
+    program_free(&program);
+
+    return EXIT_SUCCESS;
+}
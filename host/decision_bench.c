@@ -0,0 +1,529 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "decision.h"
+#include "labels.h"
+#include "pipeline.h"
+#include "program.h"
+#include "resize.h"
+#include "softmax.h"
+#include "stft.h"
+#include "stream.h"
+#include "vad.h"
+#include "wav.h"
+#include "xstatus.h"
+
+/*
+ * Replays a recording of command clips through the windows of the
+ * firmware and compares the latency from the onset of each command to
+ * its actuation for the decision on single windows that speech_robot.c
+ * used before and for the streaming decision in vitis/decision.c.
+ *
+ * Usage: decision_bench [-w windows] [-g gap_ms] [-r lines]
+ *                       [-p model.tprog] [-c model.tdata]
+ *                       [-l model.labels] file.wav...
+ *
+ * Clips are concatenated with `gap_ms` of silence before each of them.
+ * The expected command is the name of the directory containing the
+ * clip as in the speech commands dataset, looked up in the labels file
+ * that also gives the probability thresholds of the commands. The onset
+ * of a clip is the line its voice activity gate opens on, or the first
+ * line of the clip if the gate does not open. A window is inferred every
+ * RESIZE_HEIGHT / windows rows with the streaming engine and decided on
+ * the STFT line that completes it, so the latency does not include the
+ * inference.
+ * `lines` is the refractory period of the streaming decision during
+ * which no other command can fire, while the decision on single windows
+ * always locks out all commands for a frame.
+ *
+ * An actuation is attributed to the last clip with its onset before it.
+ * The first actuation of the expected command is a hit, any other is a
+ * false trigger, and clips of known commands without a hit are misses.
+ * Actuations of the command that the robot already runs are counted as
+ * well, since speech_robot.c filters them after the decision.
+ */
+
+#define BENCH_DEFAULT_PROG "model/speech_commands_onnx_speech_robot.tprog"
+#define BENCH_DEFAULT_CONSTS "model/speech_commands_onnx_speech_robot.tdata"
+#define BENCH_DEFAULT_LABELS "model/speech_commands.labels"
+#define BENCH_DEFAULT_GAP_MS 2000
+
+#define BENCH_LENGTH PIPELINE_OUTPUT_LENGTH
+#define BENCH_LINE_MS (STFT_HOP * 1000.0 / 16000)
+
+/*
+ * Same as the refractory periods in speech_robot.c.
+ */
+
+#define BENCH_MIN_REFRACTORY_LINES 32
+#define BENCH_MAX_REFRACTORY_LINES PIPELINE_INPUT_HEIGHT
+
+struct clip {
+    size_t expected;
+    size_t start_line;
+    size_t onset_line;
+    size_t latency_lines;
+    bool hit;
+};
+
+struct window {
+    size_t line;
+    struct softmax_result result;
+};
+
+struct bench {
+    struct labels labels;
+    size_t unknown_command;
+    struct program program;
+    struct stft stft;
+    struct resize resize;
+    struct stream stream;
+    struct vad vad;
+
+    float *samples;
+    size_t samples_length;
+    STFT_DT (*lines)[STFT_LENGTH];
+    size_t lines_length;
+    TCU_DT (*rows)[RESIZE_WIDTH];
+    size_t rows_length;
+
+    struct clip *clips;
+    size_t clips_length;
+
+    struct window *windows;
+    size_t windows_length;
+
+    size_t min_refractory_lines;
+};
+
+static struct bench bench;
+
+static size_t get_expected_command(const char *path) {
+    const char *end = strrchr(path, '/');
+
+    if (!end)
+        return bench.unknown_command;
+
+    const char *start = end;
+
+    while (start > path && start[-1] != '/')
+        start--;
+
+    size_t i = labels_find(&bench.labels, start, end - start);
+
+    return i < bench.labels.length ? i : bench.unknown_command;
+}
+
+static int append_samples(const int16_t *samples, size_t length) {
+    float *buffer = realloc(bench.samples,
+                            (bench.samples_length + length) * sizeof(float));
+
+    if (!buffer)
+        return XST_FAILURE;
+
+    for (size_t i = 0; i < length; i++)
+        buffer[bench.samples_length + i] = samples ? samples[i] / 32768.0f : 0;
+
+    bench.samples = buffer;
+    bench.samples_length += length;
+
+    return XST_SUCCESS;
+}
+
+static int read_recording(int argc, char **argv, size_t gap_length) {
+    bench.clips = calloc(argc, sizeof(struct clip));
+
+    if (!bench.clips)
+        return XST_FAILURE;
+
+    for (int i = 0; i < argc; i++) {
+        struct wav wav;
+
+        if (wav_read(argv[i], &wav) != XST_SUCCESS) {
+            fprintf(stderr, "failed to read %s\n", argv[i]);
+            return XST_FAILURE;
+        }
+
+        if (append_samples(NULL, gap_length) != XST_SUCCESS)
+            return XST_FAILURE;
+
+        struct clip *clip = &bench.clips[bench.clips_length++];
+
+        clip->expected = get_expected_command(argv[i]);
+
+        /*
+         * The first line with samples of the clip.
+         */
+
+        clip->start_line = bench.samples_length > STFT_HOP
+                               ? (bench.samples_length - STFT_HOP) / STFT_HOP
+                               : 0;
+        clip->onset_line = clip->start_line;
+
+        if (append_samples(wav.samples, wav.length) != XST_SUCCESS)
+            return XST_FAILURE;
+
+        wav_free(&wav);
+    }
+
+    if (append_samples(NULL, gap_length + PIPELINE_CLIP_LENGTH) !=
+        XST_SUCCESS)
+        return XST_FAILURE;
+
+    /*
+     * Whole seconds of STFT lines, so that every row is resized from
+     * lines of its own second as in the firmware.
+     */
+
+    size_t seconds =
+        (bench.samples_length - STFT_LENGTH) / STFT_HOP / PIPELINE_INPUT_HEIGHT;
+
+    bench.lines_length = seconds * PIPELINE_INPUT_HEIGHT;
+    bench.lines = malloc(bench.lines_length * sizeof(*bench.lines));
+    bench.rows_length = seconds * RESIZE_HEIGHT;
+    bench.rows = malloc(bench.rows_length * sizeof(*bench.rows));
+
+    if (!bench.lines || !bench.rows)
+        return XST_FAILURE;
+
+    stft_compute(&bench.stft, bench.samples, bench.lines_length,
+                 &bench.lines[0][0]);
+
+    for (size_t i = 0; i < bench.rows_length; i++) {
+        const struct resize_tap *tap = &bench.resize.rows[i % RESIZE_HEIGHT];
+        size_t first_line = (i / RESIZE_HEIGHT) * PIPELINE_INPUT_HEIGHT;
+
+        resize_row(&bench.resize, i % RESIZE_HEIGHT,
+                   &bench.lines[first_line + tap->first][STFT_LENGTH - 1],
+                   &bench.lines[first_line + tap->second][STFT_LENGTH - 1],
+                   -1, bench.rows[i], 1);
+    }
+
+    return XST_SUCCESS;
+}
+
+/*
+ * Finds the onset of every clip with the voice activity gate of the
+ * firmware.
+ */
+
+static void find_onsets() {
+    size_t clip = 0;
+    bool found = false;
+
+    vad_init(&bench.vad, PIPELINE_INPUT_HEIGHT);
+
+    for (size_t i = 0; i < bench.lines_length; i++) {
+        while (clip + 1 < bench.clips_length &&
+               i >= bench.clips[clip + 1].start_line) {
+            clip++;
+            found = false;
+        }
+
+        bool was_open = bench.vad.open;
+
+        vad_update(&bench.vad, &bench.lines[i][STFT_LENGTH - 1], -1);
+
+        if (!found && i >= bench.clips[clip].start_line && !was_open &&
+            bench.vad.open) {
+            bench.clips[clip].onset_line = i;
+            found = true;
+        }
+    }
+}
+
+static int infer_windows(size_t step) {
+    bench.windows_length = (bench.rows_length - RESIZE_HEIGHT) / step + 1;
+    bench.windows = malloc(bench.windows_length * sizeof(struct window));
+
+    if (!bench.windows)
+        return XST_FAILURE;
+
+    stream_reset(&bench.stream);
+
+    for (size_t i = 0; i < bench.windows_length; i++) {
+        struct window *window = &bench.windows[i];
+        size_t last_row = i * step + RESIZE_HEIGHT - 1;
+        TCU_DT logits[BENCH_LENGTH];
+
+        while (bench.stream.rows <= last_row)
+            stream_push(&bench.stream, bench.rows[bench.stream.rows]);
+
+        if (stream_infer(&bench.stream, logits) != XST_SUCCESS)
+            return XST_FAILURE;
+
+        window->line = (last_row / RESIZE_HEIGHT) * PIPELINE_INPUT_HEIGHT +
+                       bench.resize.rows[last_row % RESIZE_HEIGHT].second;
+
+        softmax_top2(logits, BENCH_LENGTH, &window->result);
+    }
+
+    return XST_SUCCESS;
+}
+
+/*
+ * Decision on single windows with a lockout of one frame after each
+ * actuation, as in speech_robot.c before vitis/decision.c.
+ */
+
+struct window_decision {
+    size_t lockout_lines;
+};
+
+static void window_init(void *context) {
+    struct window_decision *decision = context;
+
+    decision->lockout_lines = BENCH_MAX_REFRACTORY_LINES;
+}
+
+static bool window_update(void *context,
+                          const struct softmax_result *result) {
+    struct window_decision *decision = context;
+
+    if (decision->lockout_lines || !bench.labels.thresholds[result->first] ||
+        result->probability <= bench.labels.thresholds[result->first])
+        return false;
+
+    decision->lockout_lines = BENCH_MAX_REFRACTORY_LINES;
+
+    return true;
+}
+
+static void window_tick(void *context) {
+    struct window_decision *decision = context;
+
+    if (decision->lockout_lines)
+        decision->lockout_lines--;
+}
+
+static void streaming_init(void *context) {
+    decision_init(context, bench.labels.thresholds, BENCH_LENGTH,
+                  bench.min_refractory_lines, BENCH_MAX_REFRACTORY_LINES);
+}
+
+static bool streaming_update(void *context,
+                             const struct softmax_result *result) {
+    return decision_update(context, result);
+}
+
+static void streaming_tick(void *context) { decision_tick(context); }
+
+struct policy {
+    const char *name;
+    void (*init)(void *context);
+    bool (*update)(void *context, const struct softmax_result *result);
+    void (*tick)(void *context);
+};
+
+static const struct policy policies[] = {
+    {"window", window_init, window_update, window_tick},
+    {"streaming", streaming_init, streaming_update, streaming_tick},
+};
+
+#define BENCH_POLICIES (sizeof(policies) / sizeof(policies[0]))
+
+static int compare_sizes(const void *a, const void *b) {
+    size_t x = *(const size_t *)a;
+    size_t y = *(const size_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void replay(const struct policy *policy) {
+    union {
+        struct window_decision window;
+        struct decision streaming;
+    } context;
+
+    size_t window = 0;
+    size_t clip = 0;
+    size_t false_triggers = 0;
+
+    policy->init(&context);
+
+    for (size_t i = 0; i < bench.clips_length; i++)
+        bench.clips[i].hit = false;
+
+    for (size_t i = 0; i < bench.lines_length; i++) {
+        for (; window < bench.windows_length &&
+               bench.windows[window].line == i;
+             window++) {
+            const struct softmax_result *result =
+                &bench.windows[window].result;
+
+            if (!policy->update(&context, result))
+                continue;
+
+            while (clip + 1 < bench.clips_length &&
+                   i >= bench.clips[clip + 1].onset_line)
+                clip++;
+
+            struct clip *current = &bench.clips[clip];
+
+            if (i >= current->onset_line && !current->hit &&
+                result->first == current->expected) {
+                current->hit = true;
+                current->latency_lines = i - current->onset_line;
+            } else
+                false_triggers++;
+        }
+
+        policy->tick(&context);
+    }
+
+    size_t latencies[bench.clips_length];
+    size_t hits = 0;
+    size_t misses = 0;
+
+    for (size_t i = 0; i < bench.clips_length; i++) {
+        const struct clip *current = &bench.clips[i];
+
+        if (current->hit)
+            latencies[hits++] = current->latency_lines;
+        else if (bench.labels.thresholds[current->expected])
+            misses++;
+    }
+
+    qsort(latencies, hits, sizeof(size_t), compare_sizes);
+
+    double total = 0;
+
+    for (size_t i = 0; i < hits; i++)
+        total += latencies[i];
+
+    printf("%10s %6zu %6zu %6zu", policy->name, hits, misses, false_triggers);
+
+    if (hits)
+        printf(" %8.0f %8.0f %8.0f %8.0f\n", total / hits * BENCH_LINE_MS,
+               latencies[hits / 2] * BENCH_LINE_MS,
+               latencies[hits * 9 / 10] * BENCH_LINE_MS,
+               latencies[hits - 1] * BENCH_LINE_MS);
+    else
+        printf("\n");
+
+    for (size_t i = 0; i < BENCH_LENGTH; i++) {
+        size_t command_hits = 0;
+        double command_total = 0;
+
+        for (size_t j = 0; j < bench.clips_length; j++)
+            if (bench.clips[j].expected == i && bench.clips[j].hit) {
+                command_hits++;
+                command_total += bench.clips[j].latency_lines;
+            }
+
+        if (command_hits)
+            printf("%10s %6zu %22.0f\n", bench.labels.names[i], command_hits,
+                   command_total / command_hits * BENCH_LINE_MS);
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *prog_path = BENCH_DEFAULT_PROG;
+    const char *consts_path = BENCH_DEFAULT_CONSTS;
+    const char *labels_path = BENCH_DEFAULT_LABELS;
+    size_t windows = 4;
+    size_t gap_ms = BENCH_DEFAULT_GAP_MS;
+    int opt;
+
+    bench.min_refractory_lines = BENCH_MIN_REFRACTORY_LINES;
+
+    while ((opt = getopt(argc, argv, "w:g:r:p:c:l:")) != -1) {
+        switch (opt) {
+        case 'w':
+            windows = atol(optarg);
+            break;
+        case 'g':
+            gap_ms = atol(optarg);
+            break;
+        case 'r':
+            bench.min_refractory_lines = atol(optarg);
+            break;
+        case 'p':
+            prog_path = optarg;
+            break;
+        case 'c':
+            consts_path = optarg;
+            break;
+        case 'l':
+            labels_path = optarg;
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-w windows] [-g gap_ms] [-r lines] "
+                    "[-p model.tprog] [-c model.tdata] [-l model.labels] "
+                    "file.wav...\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!windows || RESIZE_HEIGHT % windows) {
+        fprintf(stderr, "windows must divide %d\n", RESIZE_HEIGHT);
+        return EXIT_FAILURE;
+    }
+
+    if (optind == argc) {
+        fprintf(stderr, "no clips\n");
+        return EXIT_FAILURE;
+    }
+
+    if (labels_read(labels_path, &bench.labels) != XST_SUCCESS ||
+        bench.labels.length != BENCH_LENGTH) {
+        fprintf(stderr, "failed to read %zu labels from %s\n",
+                (size_t)BENCH_LENGTH, labels_path);
+        return EXIT_FAILURE;
+    }
+
+    bench.unknown_command =
+        labels_find(&bench.labels, "_unknown_", strlen("_unknown_"));
+
+    if (bench.unknown_command == bench.labels.length) {
+        fprintf(stderr, "no _unknown_ label in %s\n", labels_path);
+        return EXIT_FAILURE;
+    }
+
+    if (program_read(&bench.program, prog_path, consts_path) != XST_SUCCESS) {
+        fprintf(stderr, "failed to read %s or %s\n", prog_path, consts_path);
+        return EXIT_FAILURE;
+    }
+
+    if (stream_init(&bench.stream, &bench.program) != XST_SUCCESS) {
+        fprintf(stderr, "unexpected program\n");
+        return EXIT_FAILURE;
+    }
+
+    stft_init(&bench.stft);
+    resize_init(&bench.resize, PIPELINE_INPUT_HEIGHT, PIPELINE_INPUT_WIDTH);
+
+    if (read_recording(argc - optind, argv + optind, gap_ms * 16) !=
+            XST_SUCCESS ||
+        infer_windows(RESIZE_HEIGHT / windows) != XST_SUCCESS) {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    find_onsets();
+
+    printf("%zu clips, %zu windows every %d rows\n\n", bench.clips_length,
+           bench.windows_length, RESIZE_HEIGHT / (int)windows);
+    printf("%10s %6s %6s %6s %8s %8s %8s %8s\n", "decision", "hits",
+           "misses", "false", "mean ms", "p50 ms", "p90 ms", "max ms");
+
+    for (size_t i = 0; i < BENCH_POLICIES; i++)
+        replay(&policies[i]);
+
+    free(bench.windows);
+    free(bench.rows);
+    free(bench.lines);
+    free(bench.samples);
+    free(bench.clips);
+    program_free(&bench.program);
+
+    return EXIT_SUCCESS;
+}
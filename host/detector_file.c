@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "detector_file.h"
+#include "xstatus.h"
+
+int detector_file_read(const char *path, struct detector_params *params) {
+    FILE *file = fopen(path, "rb");
+
+    if (!file)
+        return XST_FAILURE;
+
+    size_t size = fread(params, 1, sizeof(struct detector_params), file);
+    bool is_end = fgetc(file) == EOF;
+
+    fclose(file);
+
+    return size == sizeof(struct detector_params) && is_end ? XST_SUCCESS
+                                                            : XST_FAILURE;
+}
+
+int detector_file_write(const char *path,
+                        const struct detector_params *params) {
+    FILE *file = fopen(path, "wb");
+
+    if (!file)
+        return XST_FAILURE;
+
+    size_t size = fwrite(params, 1, sizeof(struct detector_params), file);
+
+    return fclose(file) == 0 && size == sizeof(struct detector_params)
+               ? XST_SUCCESS
+               : XST_FAILURE;
+}
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include "detector.h"
+
+/*
+ * Detector file with the parameters of the keyword detector in
+ * vitis/detector.h, as written by `batch -t` and packed into the model
+ * image by `image_pack -d`. The file is the struct detector_params as
+ * is.
+ */
+
+/*
+ * Reads the detector file. Returns XST_FAILURE when it cannot be read or
+ * is not the size of the parameters.
+ */
+
+int detector_file_read(const char *path, struct detector_params *params);
+
+int detector_file_write(const char *path,
+                        const struct detector_params *params);
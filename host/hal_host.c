@@ -0,0 +1,759 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "architecture_params.h"
+#include "hal.h"
+#include "latency.h"
+#include "stft.h"
+#include "tcu.h"
+#include "wav.h"
+#include "xstatus.h"
+
+/*
+ * Linux backend of the hardware abstraction layer. It emulates the
+ * speech robot devices in software so that the firmware main loop in
+ * speech_robot.c can run unmodified on a workstation:
+ *
+ * - DDR is an anonymous mapping the size of Arty A7-100 DDR3;
+ * - flash is loaded from the image file in SPEECH_ROBOT_FLASH laid
+ *   out as the board flash (model image at 0x400000) and is read at
+ *   SPEECH_ROBOT_FLASH_RATE bytes per second when it is set;
+ * - acquisition DMA reads 16-bit PCM WAV file in SPEECH_ROBOT_AUDIO,
+ *   or produces SPEECH_ROBOT_SECONDS of silence when it is not set;
+ * - STFT DMA runs the software STFT engine in stft.c over the sliding
+ *   window of each submitted hop, with the window applied in floating
+ *   or fixed point as HAL_ACQ_FORMAT says;
+ * - TCU runs the program in the reference interpreter in tcu.c.
+ *
+ * Setting SPEECH_ROBOT_REALTIME paces acquisition at the sample rate
+ * multiplied by its value, 1 when it is not a positive number, and
+ * runs TCU instruction blocks on a worker thread, so that the TCU
+ * proceeds concurrently with the main loop as on the board. Otherwise
+ * the loop runs as fast as it can: an acquisition packet completes once
+ * the loop has no more events to dispatch, and a TCU block runs to
+ * completion when it is started but reports busy until the next
+ * acquisition packet, so that an inference takes a deterministic number
+ * of packets. The profiling timer counts nanoseconds and the UART
+ * receives from standard input.
+ *
+ * The time spent between starting the acquisition DMA and the main loop
+ * going idle is the work the main loop does for each acquisition
+ * packet. It must fit into the packet period, which is 8ms for 128
+ * samples at 16kHz. The backend records this time for every iteration
+ * and prints a summary to standard error at exit.
+ *
+ * SPEECH_ROBOT_CLIPS names a list of clips to replay instead of the
+ * audio, one per line with an optional onset in milliseconds from the
+ * start of the clip. Clips are separated by SPEECH_ROBOT_GAP_MS of
+ * silence. The expected command is the name of the directory containing
+ * the clip as in the speech commands dataset. Without an onset, it is
+ * the first 10ms whose energy is above a hundredth of the loudest 10ms
+ * of the clip. Motor settings are decoded into the commands that make
+ * them and their onset to actuation latency is printed at exit. The
+ * time of an actuation is the time of the acquisition packet in the
+ * recording plus, in real time, the time since the packet started.
+ */
+
+#define HOST_FLASH_SIZE 0x1000000
+
+#define HOST_DEFAULT_SECONDS 10
+#define HOST_DEFAULT_GAP_MS 2000
+#define HOST_ONSET_FRAME_LENGTH (HAL_ACQ_SAMPLE_RATE / 100)
+#define HOST_ONSET_ENERGY_RATIO 100
+#define HOST_MAX_PATH 4096
+
+#define HOST_HISTOGRAM_BUCKETS 16
+
+#define HOST_TCU_DATA_WIDTH_BYTES 16
+#define HOST_TCU_BLOCK_SIZE 0x10000
+
+struct host_timing {
+    u64 start_ns;
+    bool pending;
+
+    size_t iterations;
+    size_t overruns;
+
+    u64 total_ns;
+    u64 min_ns;
+    u64 max_ns;
+
+    size_t histogram[HOST_HISTOGRAM_BUCKETS + 1];
+};
+
+struct host_tcu_worker {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    const u8 *ptr;
+    size_t size;
+    bool busy;
+    int status;
+};
+
+struct host_stft_hop {
+    const u8 *tx_ptrs[2];
+    u8 *rx_ptr;
+    size_t rx_size;
+};
+
+/*
+ * Commands of the motor settings. Same as get_command_motor_speed and
+ * get_command_motor_direction in speech_robot.c.
+ */
+
+#define HOST_MOTOR_DIRECTION_ROTATE_RIGHT 0x3
+#define HOST_MOTOR_DIRECTION_ROTATE_LEFT 0x0
+
+static const char *motor_commands[] = {"go", "left", "right", "stop"};
+
+#define HOST_MOTOR_COMMANDS (sizeof(motor_commands) / sizeof(motor_commands[0]))
+
+struct host {
+    u8 *ddr_ptr;
+    u8 *flash_ptr;
+    double flash_rate;
+
+    struct wav wav;
+    size_t acq_position;
+    size_t acq_packet_position;
+    size_t acq_length;
+    u64 acq_period_ns;
+    bool acq_busy;
+    bool realtime;
+    double speed;
+    bool running;
+
+    bool clips;
+    struct latency latency;
+    u32 motor_high_period;
+
+    struct host_timing timing;
+    struct tcu tcu;
+    bool tcu_busy;
+    struct host_tcu_worker tcu_worker;
+    struct stft stft;
+    struct host_stft_hop *stft_hops;
+    size_t stft_depth;
+    size_t stft_next_hop;
+    size_t stft_completed;
+};
+
+static struct host host;
+
+static u64 get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void print_timing() {
+    struct host_timing *timing = &host.timing;
+
+    if (!timing->iterations)
+        return;
+
+    fprintf(stderr,
+            "iterations: %zu, overruns: %zu, work per packet (us): "
+            "min %.1f, avg %.1f, max %.1f, budget %.1f\n",
+            timing->iterations, timing->overruns, timing->min_ns / 1e3,
+            timing->total_ns / 1e3 / timing->iterations,
+            timing->max_ns / 1e3, host.acq_period_ns / 1e3);
+
+    for (size_t i = 0; i <= HOST_HISTOGRAM_BUCKETS; i++) {
+        if (i < HOST_HISTOGRAM_BUCKETS)
+            fprintf(stderr, "  < %6.1f us: %zu\n",
+                    (i + 1) * host.acq_period_ns / 1e3 /
+                        HOST_HISTOGRAM_BUCKETS,
+                    timing->histogram[i]);
+        else
+            fprintf(stderr, "  overrun    : %zu\n", timing->histogram[i]);
+    }
+}
+
+static void record_timing(u64 work_ns) {
+    struct host_timing *timing = &host.timing;
+
+    if (!timing->iterations || work_ns < timing->min_ns)
+        timing->min_ns = work_ns;
+
+    if (work_ns > timing->max_ns)
+        timing->max_ns = work_ns;
+
+    timing->iterations++;
+    timing->total_ns += work_ns;
+
+    size_t bucket = work_ns * HOST_HISTOGRAM_BUCKETS / host.acq_period_ns;
+
+    if (bucket >= HOST_HISTOGRAM_BUCKETS) {
+        bucket = HOST_HISTOGRAM_BUCKETS;
+        timing->overruns++;
+    }
+
+    timing->histogram[bucket]++;
+}
+
+static void print_latency() { latency_print(&host.latency, stderr); }
+
+static const char *get_clip_command(const char *path) {
+    const char *end = strrchr(path, '/');
+
+    if (!end)
+        return NULL;
+
+    const char *start = end;
+
+    while (start > path && start[-1] != '/')
+        start--;
+
+    for (size_t i = 0; i < HOST_MOTOR_COMMANDS; i++)
+        if (strlen(motor_commands[i]) == (size_t)(end - start) &&
+            !strncmp(motor_commands[i], start, end - start))
+            return motor_commands[i];
+
+    return NULL;
+}
+
+static u64 get_frame_energy(const struct wav *wav, size_t frame) {
+    const int16_t *samples = wav->samples + frame * HOST_ONSET_FRAME_LENGTH;
+    u64 energy = 0;
+
+    for (size_t i = 0; i < HOST_ONSET_FRAME_LENGTH; i++)
+        energy += samples[i] * samples[i];
+
+    return energy;
+}
+
+static size_t find_onset(const struct wav *wav) {
+    size_t frames = wav->length / HOST_ONSET_FRAME_LENGTH;
+    u64 max_energy = 0;
+
+    for (size_t i = 0; i < frames; i++) {
+        u64 energy = get_frame_energy(wav, i);
+
+        if (energy > max_energy)
+            max_energy = energy;
+    }
+
+    for (size_t i = 0; i < frames; i++)
+        if (get_frame_energy(wav, i) * HOST_ONSET_ENERGY_RATIO > max_energy)
+            return i * HOST_ONSET_FRAME_LENGTH;
+
+    return 0;
+}
+
+static int append_samples(const int16_t *samples, size_t length) {
+    int16_t *buffer = realloc(host.wav.samples,
+                              (host.wav.length + length) * sizeof(int16_t));
+
+    if (!buffer)
+        return XST_FAILURE;
+
+    if (samples)
+        memcpy(buffer + host.wav.length, samples, length * sizeof(int16_t));
+    else
+        memset(buffer + host.wav.length, 0, length * sizeof(int16_t));
+
+    host.wav.samples = buffer;
+    host.wav.length += length;
+
+    return XST_SUCCESS;
+}
+
+static int read_clips(const char *list_path, size_t gap_ms) {
+    FILE *file = fopen(list_path, "r");
+
+    if (!file) {
+        fprintf(stderr, "cannot open clips %s\n", list_path);
+        return XST_FAILURE;
+    }
+
+    size_t gap_length = gap_ms * HAL_ACQ_SAMPLE_RATE / 1000;
+    char line[HOST_MAX_PATH];
+    int status = XST_SUCCESS;
+
+    host.wav.sample_rate = HAL_ACQ_SAMPLE_RATE;
+    host.clips = true;
+    latency_init(&host.latency, "stop");
+
+    while (status == XST_SUCCESS && fgets(line, sizeof(line), file)) {
+        char path[HOST_MAX_PATH];
+        double onset_ms;
+        struct wav wav;
+
+        int fields = sscanf(line, "%4095s %lf", path, &onset_ms);
+
+        if (fields < 1 || path[0] == '#')
+            continue;
+
+        if (wav_read(path, &wav) != XST_SUCCESS) {
+            fprintf(stderr, "cannot read clip %s\n", path);
+            status = XST_FAILURE;
+            break;
+        }
+
+        size_t onset = fields == 2 ? onset_ms * HAL_ACQ_SAMPLE_RATE / 1000
+                                   : find_onset(&wav);
+
+        status = append_samples(NULL, gap_length);
+
+        if (status == XST_SUCCESS)
+            status = latency_add_clip(
+                &host.latency, get_clip_command(path),
+                (u64)(host.wav.length + onset) * 1000000000 /
+                    HAL_ACQ_SAMPLE_RATE);
+
+        if (status == XST_SUCCESS)
+            status = append_samples(wav.samples, wav.length);
+
+        wav_free(&wav);
+    }
+
+    fclose(file);
+
+    if (status == XST_SUCCESS)
+        status = append_samples(NULL, gap_length);
+
+    return status;
+}
+
+int hal_init() {
+    host.ddr_ptr = mmap(NULL, HAL_DDR_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (host.ddr_ptr == MAP_FAILED)
+        return XST_FAILURE;
+
+    host.flash_ptr = malloc(HOST_FLASH_SIZE);
+
+    if (!host.flash_ptr)
+        return XST_FAILURE;
+
+    /*
+     * Erased flash reads as all ones.
+     */
+
+    memset(host.flash_ptr, 0xff, HOST_FLASH_SIZE);
+
+    const char *flash_path = getenv("SPEECH_ROBOT_FLASH");
+
+    if (flash_path) {
+        FILE *file = fopen(flash_path, "rb");
+
+        if (!file) {
+            fprintf(stderr, "cannot open flash image %s\n", flash_path);
+            return XST_FAILURE;
+        }
+
+        /*
+         * Images are usually shorter than the flash, and the rest of it
+         * stays erased.
+         */
+
+        size_t size = fread(host.flash_ptr, 1, HOST_FLASH_SIZE, file);
+        bool failed = ferror(file);
+
+        fclose(file);
+
+        if (failed) {
+            fprintf(stderr, "cannot read flash image %s\n", flash_path);
+            return XST_FAILURE;
+        }
+
+        fprintf(stderr, "flash image %s: %zu bytes\n", flash_path, size);
+    }
+
+    const char *flash_rate = getenv("SPEECH_ROBOT_FLASH_RATE");
+
+    host.flash_rate = flash_rate ? atof(flash_rate) : 0;
+
+    const char *clips_path = getenv("SPEECH_ROBOT_CLIPS");
+    const char *audio_path = getenv("SPEECH_ROBOT_AUDIO");
+
+    if (clips_path) {
+        const char *gap_ms = getenv("SPEECH_ROBOT_GAP_MS");
+
+        size_t gap = gap_ms ? atoi(gap_ms) : HOST_DEFAULT_GAP_MS;
+
+        if (read_clips(clips_path, gap) != XST_SUCCESS)
+            return XST_FAILURE;
+
+        host.acq_length = host.wav.length;
+    } else if (audio_path) {
+        if (wav_read(audio_path, &host.wav) != XST_SUCCESS) {
+            fprintf(stderr, "cannot read audio %s\n", audio_path);
+            return XST_FAILURE;
+        }
+
+        if (host.wav.sample_rate != HAL_ACQ_SAMPLE_RATE)
+            fprintf(stderr, "warning: %s is sampled at %u Hz, not %u Hz\n",
+                    audio_path, host.wav.sample_rate, HAL_ACQ_SAMPLE_RATE);
+
+        host.acq_length = host.wav.length;
+    } else {
+        const char *seconds = getenv("SPEECH_ROBOT_SECONDS");
+
+        host.acq_length =
+            (seconds ? atoi(seconds) : HOST_DEFAULT_SECONDS) *
+            HAL_ACQ_SAMPLE_RATE;
+    }
+
+    const char *realtime = getenv("SPEECH_ROBOT_REALTIME");
+
+    host.realtime = realtime != NULL;
+    host.speed = realtime && atof(realtime) > 0 ? atof(realtime) : 1;
+    host.running = true;
+
+    atexit(print_timing);
+
+    if (host.clips)
+        atexit(print_latency);
+
+    return XST_SUCCESS;
+}
+
+bool hal_is_running() { return host.running; }
+
+void hal_idle() {
+    if (host.timing.pending) {
+        record_timing(get_time_ns() - host.timing.start_ns);
+        host.timing.pending = false;
+    }
+
+    host.acq_busy = false;
+}
+
+u8 *hal_get_ddr_base() { return host.ddr_ptr; }
+
+int hal_flash_read(size_t offset, u8 *ptr, size_t size) {
+    u64 start_ns = get_time_ns();
+
+    if (offset > HOST_FLASH_SIZE || size > HOST_FLASH_SIZE - offset)
+        return XST_FAILURE;
+
+    memcpy(ptr, host.flash_ptr + offset, size);
+
+    /*
+     * Spin rather than sleep, so that short reads take as long as they
+     * would on the board.
+     */
+
+    if (host.flash_rate > 0) {
+        u64 end_ns = start_ns + size * 1e9 / host.flash_rate;
+
+        while (get_time_ns() < end_ns)
+            ;
+    }
+
+    return XST_SUCCESS;
+}
+
+size_t hal_get_dram_offset(const u8 *ptr) {
+    return (ptr - host.ddr_ptr) >> TCU_DRAM_OFFSET_SHIFT;
+}
+
+u32 hal_get_ticks() { return get_time_ns(); }
+
+u32 hal_get_ticks_per_second() { return 1000000000; }
+
+int hal_uart_get_char() {
+    struct pollfd fd = {.fd = STDIN_FILENO, .events = POLLIN};
+    u8 c;
+
+    if (poll(&fd, 1, 0) != 1 || read(STDIN_FILENO, &c, 1) != 1)
+        return -1;
+
+    return c;
+}
+
+bool hal_uart_put_char(u8 c) { return putchar(c) != EOF; }
+
+void hal_set_leds(int leds) { (void)leds; }
+
+/*
+ * The firmware sets the speed before the direction, so the command is
+ * decoded when the direction is set. Settings made before the first
+ * acquisition packet are the initial stop.
+ */
+
+void hal_set_motor_direction(int direction) {
+    if (!host.clips || !host.acq_position)
+        return;
+
+    const char *command;
+
+    if (!host.motor_high_period)
+        command = "stop";
+    else if (direction == HOST_MOTOR_DIRECTION_ROTATE_LEFT)
+        command = "left";
+    else if (direction == HOST_MOTOR_DIRECTION_ROTATE_RIGHT)
+        command = "right";
+    else
+        command = "go";
+
+    u64 time_ns =
+        (u64)host.acq_packet_position * 1000000000 / HAL_ACQ_SAMPLE_RATE;
+
+    if (host.realtime)
+        time_ns += (get_time_ns() - host.timing.start_ns) * host.speed;
+
+    latency_actuate(&host.latency, command, time_ns);
+}
+
+int hal_motor_init() { return XST_SUCCESS; }
+
+void hal_set_motor_pwm(u32 period, u32 high_period) {
+    (void)period;
+
+    host.motor_high_period = high_period;
+}
+
+int hal_acq_init() { return XST_SUCCESS; }
+
+void hal_acq_release_reset() {}
+
+int hal_acq_start(u8 *ptr, size_t size) {
+    size_t length = size / sizeof(HAL_ACQ_DT);
+    HAL_ACQ_DT *samples = (HAL_ACQ_DT *)ptr;
+
+    /*
+     * WAV samples are scaled to [-1, 1) range, and 16-bit samples are
+     * that rounded to their fraction bits. Past the end of the audio
+     * the acquisition produces silence and the main loop is stopped
+     * once the packet is processed.
+     */
+
+    host.acq_packet_position = host.acq_position;
+
+    for (size_t i = 0; i < length; i++, host.acq_position++) {
+        float sample = host.acq_position < host.wav.length
+                           ? host.wav.samples[host.acq_position] / 32768.0f
+                           : 0;
+
+#if HAL_ACQ_FORMAT == HAL_ACQ_FORMAT_INT16
+        samples[i] = stft_quantize_sample(sample);
+#else
+        samples[i] = sample;
+#endif
+    }
+
+    if (host.acq_position >= host.acq_length)
+        host.running = false;
+
+    host.acq_period_ns =
+        (u64)length * 1000000000 / HAL_ACQ_SAMPLE_RATE / host.speed;
+
+    /*
+     * When the loop fell behind and did not go idle during the previous
+     * packet, its work is recorded up to the start of this one.
+     */
+
+    u64 now_ns = get_time_ns();
+
+    if (host.timing.pending)
+        record_timing(now_ns - host.timing.start_ns);
+
+    host.timing.start_ns = now_ns;
+    host.timing.pending = true;
+    host.acq_busy = true;
+    host.tcu_busy = false;
+
+    return XST_SUCCESS;
+}
+
+bool hal_acq_is_busy() {
+    if (!host.realtime)
+        return host.acq_busy;
+
+    return get_time_ns() - host.timing.start_ns < host.acq_period_ns;
+}
+
+int hal_stft_init(u8 *rx_bd_space, u8 *tx_bd_space, size_t depth) {
+    (void)rx_bd_space;
+    (void)tx_bd_space;
+
+    stft_init(&host.stft);
+
+    host.stft_hops = calloc(depth, sizeof(struct host_stft_hop));
+
+    if (!host.stft_hops)
+        return XST_FAILURE;
+
+    host.stft_depth = depth;
+    host.stft_next_hop = 0;
+    host.stft_completed = 0;
+
+    return XST_SUCCESS;
+}
+
+int hal_stft_prepare(size_t hop, u8 *tx_first_ptr, u8 *tx_second_ptr,
+                     size_t tx_size, u8 *rx_ptr, size_t rx_size) {
+    if (hop >= host.stft_depth || tx_size != STFT_HOP * sizeof(HAL_ACQ_DT) ||
+        rx_size > STFT_LENGTH * sizeof(STFT_DT))
+        return XST_FAILURE;
+
+    struct host_stft_hop *stft_hop = &host.stft_hops[hop];
+
+    stft_hop->tx_ptrs[0] = tx_first_ptr;
+    stft_hop->tx_ptrs[1] = tx_second_ptr;
+    stft_hop->rx_ptr = rx_ptr;
+    stft_hop->rx_size = rx_size;
+
+    return XST_SUCCESS;
+}
+
+/*
+ * The hop is computed when it is submitted and reported by the next
+ * poll.
+ */
+
+int hal_stft_start() {
+    struct host_stft_hop *stft_hop = &host.stft_hops[host.stft_next_hop];
+
+    HAL_ACQ_DT window[STFT_LENGTH];
+    STFT_DT line[STFT_LENGTH];
+
+    memcpy(window, stft_hop->tx_ptrs[0], STFT_HOP * sizeof(HAL_ACQ_DT));
+    memcpy(window + STFT_HOP, stft_hop->tx_ptrs[1],
+           STFT_HOP * sizeof(HAL_ACQ_DT));
+
+#if HAL_ACQ_FORMAT == HAL_ACQ_FORMAT_INT16
+    stft_compute_fixed(&host.stft, window, 1, line);
+#else
+    stft_compute(&host.stft, window, 1, line);
+#endif
+    memcpy(stft_hop->rx_ptr, line, stft_hop->rx_size);
+
+    host.stft_next_hop = (host.stft_next_hop + 1) % host.stft_depth;
+    host.stft_completed++;
+
+    return XST_SUCCESS;
+}
+
+int hal_stft_poll(size_t *hops) {
+    *hops += host.stft_completed;
+    host.stft_completed = 0;
+
+    return XST_SUCCESS;
+}
+
+static void *run_tcu_worker(void *arg) {
+    (void)arg;
+
+    struct host_tcu_worker *worker = &host.tcu_worker;
+
+    pthread_mutex_lock(&worker->mutex);
+
+    while (true) {
+        while (!worker->ptr)
+            pthread_cond_wait(&worker->cond, &worker->mutex);
+
+        const u8 *ptr = worker->ptr;
+        size_t size = worker->size;
+
+        pthread_mutex_unlock(&worker->mutex);
+
+        int status = tcu_execute(&host.tcu, ptr, size);
+
+        pthread_mutex_lock(&worker->mutex);
+
+        if (status != XST_SUCCESS)
+            worker->status = status;
+
+        worker->ptr = NULL;
+        worker->busy = false;
+    }
+
+    return NULL;
+}
+
+tensil_error_t hal_tcu_init() {
+    TENSIL_XILINX_RESULT_FRAME
+
+    tcu_init(&host.tcu, host.ddr_ptr);
+
+    if (!host.realtime)
+        return TENSIL_ERROR_NONE;
+
+    struct host_tcu_worker *worker = &host.tcu_worker;
+
+    worker->status = XST_SUCCESS;
+
+    if (pthread_mutex_init(&worker->mutex, NULL) ||
+        pthread_cond_init(&worker->cond, NULL) ||
+        pthread_create(&worker->thread, NULL, run_tcu_worker, NULL))
+        return TENSIL_XILINX_RESULT(XST_FAILURE);
+
+    return TENSIL_ERROR_NONE;
+}
+
+size_t hal_tcu_get_instructions_data_width_bytes() {
+    return HOST_TCU_DATA_WIDTH_BYTES;
+}
+
+tensil_error_t
+hal_tcu_start_instructions(struct tensil_instruction_buffer *buffer,
+                           size_t *run_offset) {
+    TENSIL_XILINX_RESULT_FRAME
+
+    size_t start_offset = *run_offset;
+    size_t end_offset = start_offset + HOST_TCU_BLOCK_SIZE;
+
+    if (end_offset > buffer->offset)
+        end_offset = buffer->offset;
+
+    *run_offset = end_offset;
+
+    if (!host.realtime) {
+        host.tcu_busy = true;
+
+        return TENSIL_XILINX_RESULT(tcu_execute(&host.tcu,
+                                                buffer->ptr + start_offset,
+                                                end_offset - start_offset));
+    }
+
+    /*
+     * Errors of a block are returned when starting the next one.
+     */
+
+    struct host_tcu_worker *worker = &host.tcu_worker;
+
+    pthread_mutex_lock(&worker->mutex);
+
+    int status = worker->status;
+
+    worker->ptr = buffer->ptr + start_offset;
+    worker->size = end_offset - start_offset;
+    worker->busy = true;
+
+    pthread_cond_signal(&worker->cond);
+    pthread_mutex_unlock(&worker->mutex);
+
+    return TENSIL_XILINX_RESULT(status);
+}
+
+bool hal_tcu_is_instructions_busy() {
+    if (!host.realtime)
+        return host.tcu_busy;
+
+    struct host_tcu_worker *worker = &host.tcu_worker;
+
+    pthread_mutex_lock(&worker->mutex);
+
+    bool busy = worker->busy;
+
+    pthread_mutex_unlock(&worker->mutex);
+
+    return busy;
+}
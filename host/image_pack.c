@@ -0,0 +1,748 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "detector.h"
+#include "detector_file.h"
+#include "image.h"
+#include "labels.h"
+#include "program.h"
+#include "softmax.h"
+#include "tcu.h"
+#include "xstatus.h"
+
+/*
+ * Builds the packed flash image described in vitis/image.h from the
+ * compiled model, checks that it unpacks to the same bytes and prints
+ * the size of each section.
+ *
+ * Usage: image_pack [-s] [-m model.tmodel] [-l model.labels]
+ *                   -r resize_length [-i input_offset] [-b batch_size]
+ *                   [-d detector.bin] image.bin
+ *
+ * The program, the constants, their DRAM0 input and output and the TCU
+ * architecture are taken from the .tmodel file written by `tensil
+ * compile`. The labels file has a line per class with its label and
+ * probability threshold, and lines starting with # are ignored. The
+ * resize length is the number of instructions of the resize layer at
+ * the start of the program, which depends on the model and has no
+ * default. The input offset is the DRAM0 vector where the resize layer
+ * writes the model input, by default just past the input of the
+ * program, and must be what the first data move after the resize layer
+ * reads. The batch size is that of the model input the
+ * program was compiled for, of which the output must have the logits of
+ * each window. The detector file has the parameters of the
+ * keyword detector in vitis/detector.h as written by `batch -t`, and
+ * without it the model runs on every window.
+ *
+ * With -s the sections are stored uncompressed, so that the boot time
+ * of both can be compared.
+ */
+
+#define PACK_DEFAULT_MODEL "model/speech_commands_onnx_speech_robot.tmodel"
+#define PACK_DEFAULT_LABELS "model/speech_commands.labels"
+
+#define PACK_MODEL_INPUT_HEIGHT 32
+#define PACK_MODEL_INPUT_WIDTH 32
+
+#define PACK_MAX_PATH 4096
+
+#define PACK_SECTION_ALIGNMENT 16
+
+#define PACK_HASH_BITS 16
+#define PACK_MAX_CHAIN 256
+
+struct buffer {
+    u8 *ptr;
+    size_t size;
+    size_t capacity;
+
+    u32 bits;
+    u32 bits_length;
+};
+
+static int buffer_put(struct buffer *buffer, u8 value) {
+    if (buffer->size == buffer->capacity) {
+        size_t capacity = buffer->capacity ? 2 * buffer->capacity : 0x10000;
+        u8 *ptr = realloc(buffer->ptr, capacity);
+
+        if (!ptr)
+            return XST_FAILURE;
+
+        buffer->ptr = ptr;
+        buffer->capacity = capacity;
+    }
+
+    buffer->ptr[buffer->size++] = value;
+
+    return XST_SUCCESS;
+}
+
+static int buffer_put_bytes(struct buffer *buffer, const u8 *ptr,
+                            size_t size) {
+    for (size_t i = 0; i < size; i++)
+        if (buffer_put(buffer, ptr[i]) != XST_SUCCESS)
+            return XST_FAILURE;
+
+    return XST_SUCCESS;
+}
+
+static int buffer_put_bits(struct buffer *buffer, u32 value, u32 length) {
+    buffer->bits |= value << buffer->bits_length;
+    buffer->bits_length += length;
+
+    while (buffer->bits_length >= 8) {
+        if (buffer_put(buffer, buffer->bits) != XST_SUCCESS)
+            return XST_FAILURE;
+
+        buffer->bits >>= 8;
+        buffer->bits_length -= 8;
+    }
+
+    return XST_SUCCESS;
+}
+
+static int buffer_flush_bits(struct buffer *buffer) {
+    int status = XST_SUCCESS;
+
+    if (buffer->bits_length)
+        status = buffer_put(buffer, buffer->bits);
+
+    buffer->bits = 0;
+    buffer->bits_length = 0;
+
+    return status;
+}
+
+static int put_length(struct buffer *buffer, size_t length) {
+    for (; length >= 255; length -= 255)
+        if (buffer_put(buffer, 255) != XST_SUCCESS)
+            return XST_FAILURE;
+
+    return buffer_put(buffer, length);
+}
+
+static int put_sequence(struct buffer *buffer, const u8 *literals,
+                        size_t literals_length, size_t offset,
+                        size_t match) {
+    size_t match_code = match ? match - IMAGE_LZ_MIN_MATCH : 0;
+    u8 token = (literals_length < 15 ? literals_length : 15) << 4 |
+               (match_code < 15 ? match_code : 15);
+
+    if (buffer_put(buffer, token) != XST_SUCCESS ||
+        (literals_length >= 15 &&
+         put_length(buffer, literals_length - 15) != XST_SUCCESS) ||
+        buffer_put_bytes(buffer, literals, literals_length) != XST_SUCCESS)
+        return XST_FAILURE;
+
+    if (!match)
+        return XST_SUCCESS;
+
+    if (buffer_put(buffer, offset & 0xff) != XST_SUCCESS ||
+        buffer_put(buffer, offset >> 8) != XST_SUCCESS ||
+        (match_code >= 15 &&
+         put_length(buffer, match_code - 15) != XST_SUCCESS))
+        return XST_FAILURE;
+
+    return XST_SUCCESS;
+}
+
+static u32 hash(const u8 *ptr) {
+    u32 value = ptr[0] | ptr[1] << 8 | ptr[2] << 16 | (u32)ptr[3] << 24;
+
+    return (value * 2654435761u) >> (32 - PACK_HASH_BITS);
+}
+
+/*
+ * Greedy LZ77 with hash chains over the residuals of the instructions.
+ */
+
+static int pack_instructions(const u8 *ptr, size_t size,
+                             size_t instruction_size, struct buffer *out) {
+    size_t period = IMAGE_INSTRUCTION_PERIOD * instruction_size;
+    u8 *residuals = malloc(size);
+    size_t *head = malloc(sizeof(size_t) << PACK_HASH_BITS);
+    size_t *chain = malloc(size * sizeof(size_t));
+    int status = XST_FAILURE;
+
+    if (!residuals || !head || !chain)
+        goto cleanup;
+
+    for (size_t i = 0; i < size; i++)
+        residuals[i] =
+            i < 2 * period
+                ? ptr[i]
+                : ptr[i] - 2 * ptr[i - period] + ptr[i - 2 * period];
+
+    for (size_t i = 0; i < (1 << PACK_HASH_BITS); i++)
+        head[i] = SIZE_MAX;
+
+    size_t literals = 0;
+    size_t position = 0;
+
+    while (position < size) {
+        size_t match = 0;
+        size_t offset = 0;
+
+        if (position + IMAGE_LZ_MIN_MATCH <= size) {
+            u32 key = hash(residuals + position);
+            size_t candidate = head[key];
+
+            for (size_t depth = 0;
+                 candidate != SIZE_MAX && depth < PACK_MAX_CHAIN &&
+                 position - candidate <= IMAGE_LZ_MAX_OFFSET;
+                 depth++, candidate = chain[candidate]) {
+                size_t length = 0;
+
+                while (position + length < size &&
+                       residuals[candidate + length] ==
+                           residuals[position + length])
+                    length++;
+
+                if (length > match) {
+                    match = length;
+                    offset = position - candidate;
+                }
+            }
+        }
+
+        if (match < IMAGE_LZ_MIN_MATCH)
+            match = 1;
+
+        for (size_t i = position;
+             i < position + match && i + IMAGE_LZ_MIN_MATCH <= size; i++) {
+            u32 key = hash(residuals + i);
+
+            chain[i] = head[key];
+            head[key] = i;
+        }
+
+        if (match < IMAGE_LZ_MIN_MATCH) {
+            literals++;
+            position++;
+            continue;
+        }
+
+        if (put_sequence(out, residuals + position - literals, literals,
+                         offset, match) != XST_SUCCESS)
+            goto cleanup;
+
+        literals = 0;
+        position += match;
+    }
+
+    status = XST_SUCCESS;
+
+    if (literals || !size)
+        status = put_sequence(out, residuals + size - literals, literals, 0, 0);
+
+cleanup:
+    free(chain);
+    free(head);
+    free(residuals);
+
+    return status;
+}
+
+static u32 get_rice_length(u32 value, u32 parameter) {
+    u32 quotient = value >> parameter;
+
+    return quotient < IMAGE_RICE_ESCAPE ? quotient + 1 + parameter
+                                        : IMAGE_RICE_ESCAPE + 16;
+}
+
+static int pack_weights(const u8 *ptr, size_t size, struct buffer *out) {
+    size_t length = size / sizeof(int16_t);
+    const int16_t *values = (const int16_t *)ptr;
+
+    for (size_t i = 0; i < length; i += IMAGE_RICE_BLOCK_LENGTH) {
+        size_t block_length = length - i;
+        u32 codes[IMAGE_RICE_BLOCK_LENGTH];
+
+        if (block_length > IMAGE_RICE_BLOCK_LENGTH)
+            block_length = IMAGE_RICE_BLOCK_LENGTH;
+
+        for (size_t j = 0; j < block_length; j++) {
+            int16_t value = values[i + j];
+
+            codes[j] = (u16)(value << 1 ^ value >> 15);
+        }
+
+        u32 best_parameter = 0;
+        size_t best_length = SIZE_MAX;
+
+        for (u32 parameter = 0; parameter < 1 << IMAGE_RICE_PARAMETER_BITS;
+             parameter++) {
+            size_t block_bits = 0;
+
+            for (size_t j = 0; j < block_length; j++)
+                block_bits += get_rice_length(codes[j], parameter);
+
+            if (block_bits < best_length) {
+                best_length = block_bits;
+                best_parameter = parameter;
+            }
+        }
+
+        if (buffer_put_bits(out, best_parameter, IMAGE_RICE_PARAMETER_BITS) !=
+            XST_SUCCESS)
+            return XST_FAILURE;
+
+        for (size_t j = 0; j < block_length; j++) {
+            u32 quotient = codes[j] >> best_parameter;
+            int status;
+
+            if (quotient < IMAGE_RICE_ESCAPE) {
+                status = buffer_put_bits(out, (1u << quotient) - 1,
+                                         quotient + 1);
+
+                if (status == XST_SUCCESS)
+                    status = buffer_put_bits(
+                        out, codes[j] & ((1u << best_parameter) - 1),
+                        best_parameter);
+            } else {
+                status = buffer_put_bits(out, (1u << IMAGE_RICE_ESCAPE) - 1,
+                                         IMAGE_RICE_ESCAPE);
+
+                if (status == XST_SUCCESS)
+                    status = buffer_put_bits(out, codes[j], 16);
+            }
+
+            if (status != XST_SUCCESS)
+                return XST_FAILURE;
+        }
+    }
+
+    return buffer_flush_bits(out);
+}
+
+static int pack_section(struct buffer *image, struct image_section *section,
+                        enum image_codec codec, const u8 *ptr, size_t size) {
+    while (image->size % PACK_SECTION_ALIGNMENT)
+        if (buffer_put(image, 0) != XST_SUCCESS)
+            return XST_FAILURE;
+
+    section->codec = codec;
+    section->parameter = codec == IMAGE_CODEC_INSTRUCTIONS
+                             ? TCU_INSTRUCTION_SIZE
+                             : 0;
+    section->offset = image->size;
+    section->size = size;
+
+    int status;
+
+    switch (codec) {
+    case IMAGE_CODEC_INSTRUCTIONS:
+        status = pack_instructions(ptr, size, TCU_INSTRUCTION_SIZE, image);
+        break;
+    case IMAGE_CODEC_WEIGHTS:
+        status = pack_weights(ptr, size, image);
+        break;
+    default:
+        status = buffer_put_bytes(image, ptr, size);
+        break;
+    }
+
+    section->stored_size = image->size - section->offset;
+
+    return status;
+}
+
+static int read_image(void *context, size_t offset, u8 *ptr, size_t size) {
+    const struct buffer *image = context;
+
+    if (offset + size > image->size)
+        return XST_FAILURE;
+
+    memcpy(ptr, image->ptr + offset, size);
+
+    return XST_SUCCESS;
+}
+
+static int check_section(struct buffer *image,
+                         const struct image_section *section, const u8 *ptr,
+                         size_t size) {
+    u8 *unpacked = malloc(size);
+    int status = XST_FAILURE;
+
+    if (unpacked &&
+        image_unpack(read_image, image, section, unpacked, size) ==
+            XST_SUCCESS &&
+        !memcmp(unpacked, ptr, size))
+        status = XST_SUCCESS;
+
+    free(unpacked);
+
+    return status;
+}
+
+static char *read_text(const char *path) {
+    FILE *file = fopen(path, "rb");
+    char *text = NULL;
+    long size;
+
+    if (!file)
+        return NULL;
+
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 &&
+        fseek(file, 0, SEEK_SET) == 0 && (text = malloc(size + 1))) {
+        if (fread(text, 1, size, file) == (size_t)size)
+            text[size] = 0;
+        else {
+            free(text);
+            text = NULL;
+        }
+    }
+
+    fclose(file);
+
+    return text;
+}
+
+/*
+ * Finds the value of `key` in the first `object` of the .tmodel JSON, or
+ * anywhere when `object` is NULL. The .tmodel keys are unique within
+ * their objects, so this is enough to read it without a JSON parser.
+ */
+
+static const char *find_value(const char *json, const char *object,
+                              const char *key) {
+    char pattern[64];
+
+    if (object) {
+        snprintf(pattern, sizeof(pattern), "\"%s\"", object);
+        json = strstr(json, pattern);
+
+        if (!json)
+            return NULL;
+    }
+
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    json = strstr(json, pattern);
+
+    if (!json)
+        return NULL;
+
+    json += strlen(pattern);
+
+    while (isspace((unsigned char)*json) || *json == ':')
+        json++;
+
+    return json;
+}
+
+static int get_number(const char *json, const char *object, const char *key,
+                      u32 *value) {
+    const char *ptr = find_value(json, object, key);
+    char *end;
+
+    if (!ptr)
+        return XST_FAILURE;
+
+    *value = strtoul(ptr, &end, 10);
+
+    return end == ptr ? XST_FAILURE : XST_SUCCESS;
+}
+
+static int get_string(const char *json, const char *object, const char *key,
+                      char *value, size_t size) {
+    const char *ptr = find_value(json, object, key);
+    const char *end;
+
+    if (!ptr || *ptr != '"' || !(end = strchr(ptr + 1, '"')) ||
+        (size_t)(end - ptr - 1) >= size)
+        return XST_FAILURE;
+
+    memcpy(value, ptr + 1, end - ptr - 1);
+    value[end - ptr - 1] = 0;
+
+    return XST_SUCCESS;
+}
+
+static int read_architecture(const char *json,
+                             struct image_architecture *architecture) {
+    char data_type[16];
+
+    if (get_string(json, "arch", "data_type", data_type, sizeof(data_type)) !=
+            XST_SUCCESS ||
+        strcmp(data_type, "FP16BP8"))
+        return XST_FAILURE;
+
+    architecture->data_type = IMAGE_DATA_TYPE_FP16BP8;
+
+    if (get_number(json, "arch", "array_size", &architecture->array_size) !=
+            XST_SUCCESS ||
+        get_number(json, "arch", "dram0_depth", &architecture->dram0_depth) !=
+            XST_SUCCESS ||
+        get_number(json, "arch", "dram1_depth", &architecture->dram1_depth) !=
+            XST_SUCCESS ||
+        get_number(json, "arch", "local_depth", &architecture->local_depth) !=
+            XST_SUCCESS ||
+        get_number(json, "arch", "accumulator_depth",
+                   &architecture->accumulator_depth) != XST_SUCCESS ||
+        get_number(json, "arch", "simd_registers_depth",
+                   &architecture->simd_registers_depth) != XST_SUCCESS ||
+        get_number(json, "arch", "stride0_depth",
+                   &architecture->stride0_depth) != XST_SUCCESS ||
+        get_number(json, "arch", "stride1_depth",
+                   &architecture->stride1_depth) != XST_SUCCESS)
+        return XST_FAILURE;
+
+    return XST_SUCCESS;
+}
+
+static int set_labels(struct image_manifest *manifest,
+                      const struct labels *labels) {
+    if (labels->length > IMAGE_MAX_CLASSES)
+        return XST_FAILURE;
+
+    for (size_t i = 0; i < labels->length; i++) {
+        if (strlen(labels->names[i]) >= IMAGE_LABEL_SIZE)
+            return XST_FAILURE;
+
+        strcpy(manifest->labels[i], labels->names[i]);
+        manifest->thresholds[i] = labels->thresholds[i];
+    }
+
+    manifest->output_length = labels->length;
+
+    return XST_SUCCESS;
+}
+
+static void get_model_path(char *path, const char *model_path,
+                           const char *file_name) {
+    const char *slash = strrchr(model_path, '/');
+    int length = slash ? slash - model_path + 1 : 0;
+
+    snprintf(path, PACK_MAX_PATH, "%.*s%s", length, model_path, file_name);
+}
+
+static void print_manifest(const struct image_manifest *manifest) {
+    printf("model  %s, input at %u, output at %u, resize %u instructions, "
+           "batch %u\n",
+           manifest->name, manifest->input_offset, manifest->output_offset,
+           manifest->resize_length, manifest->batch_size);
+
+    for (size_t i = 0; i < manifest->output_length; i++)
+        if (manifest->thresholds[i])
+            printf("class  %-10s %.2f\n", manifest->labels[i],
+                   (double)manifest->thresholds[i] / SOFTMAX_PROBABILITY_ONE);
+}
+
+int main(int argc, char **argv) {
+    const char *model_path = PACK_DEFAULT_MODEL;
+    const char *labels_path = PACK_DEFAULT_LABELS;
+    const char *detector_path = NULL;
+    u32 resize_length = 0;
+    bool has_resize_length = false;
+    u32 input_offset = 0;
+    bool has_input_offset = false;
+    u32 batch_size = 1;
+    bool stored = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "sm:l:r:i:b:d:")) != -1) {
+        switch (opt) {
+        case 's':
+            stored = true;
+            break;
+        case 'm':
+            model_path = optarg;
+            break;
+        case 'l':
+            labels_path = optarg;
+            break;
+        case 'r':
+            resize_length = atoi(optarg);
+            has_resize_length = true;
+            break;
+        case 'i':
+            input_offset = atoi(optarg);
+            has_input_offset = true;
+            break;
+        case 'b':
+            batch_size = atoi(optarg);
+            break;
+        case 'd':
+            detector_path = optarg;
+            break;
+        default:
+            goto usage;
+        }
+    }
+
+    if (optind + 1 != argc || !has_resize_length || !batch_size)
+        goto usage;
+
+    struct image_header header = {.magic = IMAGE_MAGIC,
+                                  .version = IMAGE_VERSION};
+    struct image_manifest *manifest = &header.manifest;
+    struct image_architecture architecture;
+    char prog_file_name[PACK_MAX_PATH];
+    char consts_file_name[PACK_MAX_PATH];
+    u32 input_base, input_size, output_size;
+    char *json = read_text(model_path);
+
+    if (!json || read_architecture(json, &architecture) != XST_SUCCESS ||
+        get_string(json, NULL, "name", manifest->name, IMAGE_NAME_SIZE) !=
+            XST_SUCCESS ||
+        get_string(json, "prog", "file_name", prog_file_name,
+                   PACK_MAX_PATH) != XST_SUCCESS ||
+        get_string(json, "consts", "file_name", consts_file_name,
+                   PACK_MAX_PATH) != XST_SUCCESS ||
+        get_number(json, "inputs", "base", &input_base) != XST_SUCCESS ||
+        get_number(json, "inputs", "size", &input_size) != XST_SUCCESS ||
+        get_number(json, "outputs", "base", &manifest->output_offset) !=
+            XST_SUCCESS ||
+        get_number(json, "outputs", "size", &output_size) != XST_SUCCESS) {
+        fprintf(stderr, "failed to read %s\n", model_path);
+        return EXIT_FAILURE;
+    }
+
+    free(json);
+
+    struct labels labels;
+
+    if (labels_read(labels_path, &labels) != XST_SUCCESS ||
+        set_labels(manifest, &labels) != XST_SUCCESS ||
+        output_size != batch_size * ((manifest->output_length +
+                                      architecture.array_size - 1) /
+                                     architecture.array_size)) {
+        fprintf(stderr, "failed to read %s\n", labels_path);
+        return EXIT_FAILURE;
+    }
+
+    struct detector_params detector_params;
+
+    if (detector_path &&
+        detector_file_read(detector_path, &detector_params) != XST_SUCCESS) {
+        fprintf(stderr, "failed to read %s\n", detector_path);
+        return EXIT_FAILURE;
+    }
+
+    manifest->architecture_checksum =
+        image_get_architecture_checksum(&architecture);
+    manifest->input_offset =
+        has_input_offset ? input_offset : input_base + input_size;
+    manifest->input_height = PACK_MODEL_INPUT_HEIGHT;
+    manifest->input_width = PACK_MODEL_INPUT_WIDTH;
+    manifest->resize_length = resize_length;
+    manifest->batch_size = batch_size;
+
+    char prog_path[PACK_MAX_PATH];
+    char consts_path[PACK_MAX_PATH];
+    struct program program;
+
+    get_model_path(prog_path, model_path, prog_file_name);
+    get_model_path(consts_path, model_path, consts_file_name);
+
+    if (program_read(&program, prog_path, consts_path) != XST_SUCCESS) {
+        fprintf(stderr, "failed to read %s or %s\n", prog_path, consts_path);
+        return EXIT_FAILURE;
+    }
+
+    if (program.prog_size % TCU_INSTRUCTION_SIZE ||
+        program.prog_size < resize_length * TCU_INSTRUCTION_SIZE ||
+        program.consts_size % sizeof(int16_t)) {
+        fprintf(stderr, "unexpected program\n");
+        return EXIT_FAILURE;
+    }
+
+    /*
+     * The firmware writes the model input in place of the resize layer,
+     * so the program past it must read DRAM0 at the input offset before
+     * it writes DRAM0 anywhere.
+     */
+
+    size_t first_read;
+
+    if (tcu_get_first_dram0_read(
+            program.prog_ptr + resize_length * TCU_INSTRUCTION_SIZE,
+            program.prog_size - resize_length * TCU_INSTRUCTION_SIZE,
+            &first_read) != XST_SUCCESS ||
+        first_read != manifest->input_offset) {
+        fprintf(stderr,
+                "program past %u instructions does not read the input "
+                "at %u first\n",
+                resize_length, manifest->input_offset);
+        return EXIT_FAILURE;
+    }
+
+    struct buffer image = {0};
+
+    const u8 *ptrs[IMAGE_SECTIONS] = {program.prog_ptr, program.consts_ptr,
+                                      (const u8 *)&detector_params};
+    size_t sizes[IMAGE_SECTIONS] = {
+        program.prog_size, program.consts_size,
+        detector_path ? sizeof(struct detector_params) : 0};
+    enum image_codec codecs[IMAGE_SECTIONS] = {
+        IMAGE_CODEC_INSTRUCTIONS, IMAGE_CODEC_WEIGHTS, IMAGE_CODEC_STORED};
+    const char *names[IMAGE_SECTIONS] = {"prog", "consts", "detect"};
+    size_t size = 0;
+
+    for (size_t i = 0; i < sizeof(header); i++)
+        buffer_put(&image, 0);
+
+    for (size_t i = 0; i < IMAGE_SECTIONS; i++) {
+        struct image_section *section = &header.sections[i];
+
+        if (pack_section(&image, section,
+                         stored ? IMAGE_CODEC_STORED : codecs[i], ptrs[i],
+                         sizes[i]) != XST_SUCCESS) {
+            fprintf(stderr, "out of memory\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    memcpy(image.ptr, &header, sizeof(header));
+
+    for (size_t i = 0; i < IMAGE_SECTIONS; i++) {
+        const struct image_section *section = &header.sections[i];
+
+        if (!section->size)
+            continue;
+
+        if (check_section(&image, section, ptrs[i], sizes[i]) !=
+            XST_SUCCESS) {
+            fprintf(stderr, "%s does not unpack to the original\n",
+                    names[i]);
+            return EXIT_FAILURE;
+        }
+
+        printf("%-6s %8u -> %8u bytes (%.1f%%)\n", names[i], section->size,
+               section->stored_size,
+               100.0 * section->stored_size / section->size);
+
+        size += section->size;
+    }
+
+    print_manifest(manifest);
+    printf("image  %8zu -> %8zu bytes (%.1f%%)\n", size, image.size,
+           100.0 * image.size / size);
+
+    FILE *file = fopen(argv[optind], "wb");
+
+    if (!file || fwrite(image.ptr, 1, image.size, file) != image.size) {
+        fprintf(stderr, "failed to write %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    fclose(file);
+    free(image.ptr);
+    program_free(&program);
+
+    return EXIT_SUCCESS;
+
+usage:
+    fprintf(stderr,
+            "usage: %s [-s] [-m model.tmodel] [-l model.labels] "
+            "-r resize_length [-i input_offset] [-b batch_size] "
+            "[-d detector.bin] image.bin\n",
+            argv[0]);
+    return EXIT_FAILURE;
+}
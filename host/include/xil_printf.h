@@ -0,0 +1,16 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+/*
+ * Host build maps UART output of the firmware to standard output.
+ */
+
+#include <stdio.h>
+
+#include "xil_types.h"
+
+#define xil_printf printf
+
+static inline void print(const char *ptr) { fputs(ptr, stdout); }
@@ -0,0 +1,11 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+/*
+ * Minimal subset of Xilinx standalone BSP status codes for the host build.
+ */
+
+#define XST_SUCCESS 0L
+#define XST_FAILURE 1L
@@ -0,0 +1,200 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "architecture_params.h"
+#include "resize.h"
+#include "xil_types.h"
+
+/*
+ * Measures the CPU work per STFT line of preparing the model input in
+ * DRAM0 with the three layouts the firmware went through:
+ *
+ * - spectrogram: every STFT line is copied into each of the windows it
+ *   belongs to, one value in the first lane of a zeroed vector;
+ *
+ * - resized: STFT lines are resized to 32 by 32 as they arrive and at
+ *   each window the values are stored in the first lane of vectors;
+ *
+ * - packed: same as resized, but at each window the rows are copied
+ *   with MODEL_VECTOR_LENGTH values per vector, which the TCU unpacks;
+ *
+ * - ring: resized rows are written packed to a ring in DRAM0 once and
+ *   each window is read by the TCU from the ring without a copy.
+ *
+ * Usage: input_bench
+ *
+ * DRAM0 bytes are the size of the memory written per line, counting a
+ * vector as written when any of its lanes is, since DRAM is written in
+ * whole bursts.
+ */
+
+#define BENCH_MIN_NS 1000000000
+
+#define MODEL_DT int16_t
+#define MODEL_VECTOR_LENGTH TENSIL_ARCHITECTURE_ARRAY_SIZE
+#define MODEL_VECTOR_SIZE (MODEL_VECTOR_LENGTH * sizeof(MODEL_DT))
+
+#define MODEL_INPUT_WINDOW_NUMBER 4
+
+#define STFT_WIDTH 256
+#define STFT_HEIGHT 124
+#define SPECTROGRAM_WIDTH (STFT_WIDTH / 2 + 1)
+#define SPECTROGRAM_STEP (STFT_HEIGHT / MODEL_INPUT_WINDOW_NUMBER)
+#define RESIZE_ROW_STEP (RESIZE_HEIGHT / MODEL_INPUT_WINDOW_NUMBER)
+
+#define DRAM0_SIZE (STFT_HEIGHT * SPECTROGRAM_WIDTH * MODEL_VECTOR_SIZE)
+
+struct bench {
+    MODEL_DT stft[STFT_HEIGHT][STFT_WIDTH];
+    MODEL_DT rows[RESIZE_HEIGHT][RESIZE_WIDTH];
+    struct resize resize;
+    size_t ring_row;
+
+    u8 *dram0_ptrs[2];
+};
+
+static struct bench bench;
+
+static u64 get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void prepare_spectrogram(size_t line) {
+    u8 *dram0_ptr = bench.dram0_ptrs[(line / SPECTROGRAM_STEP) % 2];
+
+    for (size_t i = 0; i < MODEL_INPUT_WINDOW_NUMBER; i++) {
+        int shifted_line = line - i * SPECTROGRAM_STEP;
+        size_t source_line =
+            shifted_line < 0 ? STFT_HEIGHT + shifted_line : shifted_line;
+        size_t dest_line = (line % SPECTROGRAM_STEP) +
+                           (MODEL_INPUT_WINDOW_NUMBER - 1 - i) *
+                               SPECTROGRAM_STEP;
+
+        MODEL_DT *dest_ptr =
+            (MODEL_DT *)(dram0_ptr +
+                         dest_line * SPECTROGRAM_WIDTH * MODEL_VECTOR_SIZE);
+
+        memset(dest_ptr, 0, SPECTROGRAM_WIDTH * MODEL_VECTOR_SIZE);
+
+        for (size_t j = 0; j < SPECTROGRAM_WIDTH; j++)
+            dest_ptr[j * MODEL_VECTOR_LENGTH] =
+                bench.stft[source_line][STFT_WIDTH - (j + 1)];
+    }
+}
+
+static void resize_line(size_t line, MODEL_DT (*rows)[RESIZE_WIDTH],
+                        size_t rows_height) {
+    for (size_t i = 0; i < RESIZE_HEIGHT; i++) {
+        const struct resize_tap *tap = &bench.resize.rows[i];
+
+        if (tap->second != line)
+            continue;
+
+        resize_row(&bench.resize, i, &bench.stft[tap->first][STFT_WIDTH - 1],
+                   &bench.stft[tap->second][STFT_WIDTH - 1], -1,
+                   rows[bench.ring_row], 1);
+
+        bench.ring_row = (bench.ring_row + 1) % rows_height;
+    }
+}
+
+static void prepare_resized(size_t line) {
+    if (line % SPECTROGRAM_STEP == 0) {
+        size_t first_row = (line / SPECTROGRAM_STEP) * RESIZE_ROW_STEP;
+        MODEL_DT *dest_ptr = (MODEL_DT *)bench.dram0_ptrs[0];
+
+        for (size_t i = 0; i < RESIZE_HEIGHT; i++) {
+            const MODEL_DT *row = bench.rows[(first_row + i) % RESIZE_HEIGHT];
+
+            for (size_t j = 0; j < RESIZE_WIDTH; j++)
+                dest_ptr[(i * RESIZE_WIDTH + j) * MODEL_VECTOR_LENGTH] =
+                    row[j];
+        }
+    }
+
+    resize_line(line, bench.rows, RESIZE_HEIGHT);
+}
+
+static void prepare_packed(size_t line) {
+    if (line % SPECTROGRAM_STEP == 0) {
+        size_t first_row = (line / SPECTROGRAM_STEP) * RESIZE_ROW_STEP;
+        size_t first_rows = RESIZE_HEIGHT - first_row;
+        u8 *dest_ptr = bench.dram0_ptrs[0];
+
+        memcpy(dest_ptr, bench.rows[first_row], first_rows * RESIZE_WIDTH *
+                                                    sizeof(MODEL_DT));
+        memcpy(dest_ptr + first_rows * RESIZE_WIDTH * sizeof(MODEL_DT),
+               bench.rows[0], first_row * RESIZE_WIDTH * sizeof(MODEL_DT));
+    }
+
+    resize_line(line, bench.rows, RESIZE_HEIGHT);
+}
+
+static void prepare_ring(size_t line) {
+    resize_line(line, (MODEL_DT(*)[RESIZE_WIDTH])bench.dram0_ptrs[0],
+                RESIZE_HEIGHT + RESIZE_ROW_STEP);
+}
+
+static void run(const char *name, void (*prepare)(size_t line),
+                double dram0_bytes) {
+    size_t lines = 0;
+
+    bench.ring_row = 0;
+    u64 start_ns = get_time_ns();
+    u64 elapsed_ns;
+
+    do {
+        for (size_t i = 0; i < STFT_HEIGHT; i++)
+            prepare(i);
+
+        lines += STFT_HEIGHT;
+        elapsed_ns = get_time_ns() - start_ns;
+    } while (elapsed_ns < BENCH_MIN_NS);
+
+    printf("%12s %10.1f %17.0f\n", name, (double)elapsed_ns / lines,
+           dram0_bytes);
+}
+
+int main() {
+    u32 seed = 1;
+
+    for (size_t i = 0; i < STFT_HEIGHT; i++)
+        for (size_t j = 0; j < STFT_WIDTH; j++) {
+            seed = seed * 1664525 + 1013904223;
+            bench.stft[i][j] = seed >> 20;
+        }
+
+    resize_init(&bench.resize, STFT_HEIGHT, SPECTROGRAM_WIDTH);
+
+    for (size_t i = 0; i < 2; i++) {
+        bench.dram0_ptrs[i] = aligned_alloc(MODEL_VECTOR_SIZE, DRAM0_SIZE);
+        memset(bench.dram0_ptrs[i], 0, DRAM0_SIZE);
+    }
+
+    printf("%12s %10s %17s\n", "layout", "ns/line", "DRAM0 bytes/line");
+
+    run("spectrogram", prepare_spectrogram,
+        MODEL_INPUT_WINDOW_NUMBER * SPECTROGRAM_WIDTH * MODEL_VECTOR_SIZE);
+    run("resized", prepare_resized,
+        (double)RESIZE_HEIGHT * RESIZE_WIDTH * MODEL_VECTOR_SIZE /
+            SPECTROGRAM_STEP);
+    run("packed", prepare_packed,
+        (double)RESIZE_HEIGHT * RESIZE_WIDTH * sizeof(MODEL_DT) /
+            SPECTROGRAM_STEP);
+    run("ring", prepare_ring,
+        (double)RESIZE_HEIGHT * RESIZE_WIDTH * sizeof(MODEL_DT) /
+            STFT_HEIGHT);
+
+    for (size_t i = 0; i < 2; i++)
+        free(bench.dram0_ptrs[i]);
+
+    return EXIT_SUCCESS;
+}
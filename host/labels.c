@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "labels.h"
+#include "softmax.h"
+#include "xstatus.h"
+
+#define LABELS_MAX_LINE 256
+
+int labels_read(const char *path, struct labels *labels) {
+    FILE *file = fopen(path, "r");
+    char line[LABELS_MAX_LINE];
+    int status = XST_SUCCESS;
+
+    if (!file)
+        return XST_FAILURE;
+
+    labels->length = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        char name[LABELS_MAX_LINE];
+        double threshold = 0;
+
+        if (sscanf(line, "%255s %lf", name, &threshold) < 1 ||
+            name[0] == '#')
+            continue;
+
+        if (labels->length == LABELS_MAX_LENGTH ||
+            strlen(name) >= LABELS_NAME_SIZE || threshold < 0 ||
+            threshold > 1) {
+            status = XST_FAILURE;
+            break;
+        }
+
+        strcpy(labels->names[labels->length], name);
+        labels->thresholds[labels->length] = SOFTMAX_PROBABILITY(threshold);
+        labels->length++;
+    }
+
+    fclose(file);
+
+    return status;
+}
+
+size_t labels_find(const struct labels *labels, const char *name,
+                   size_t name_length) {
+    for (size_t i = 0; i < labels->length; i++)
+        if (strlen(labels->names[i]) == name_length &&
+            !strncmp(labels->names[i], name, name_length))
+            return i;
+
+    return labels->length;
+}
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xil_types.h"
+
+/*
+ * Labels file of a model as in model/speech_commands.labels: a line per
+ * class in the order of the model output with its label and optional
+ * probability threshold. Lines starting with # are ignored.
+ */
+
+#define LABELS_MAX_LENGTH 16
+#define LABELS_NAME_SIZE 32
+
+struct labels {
+    char names[LABELS_MAX_LENGTH][LABELS_NAME_SIZE];
+
+    /*
+     * Thresholds in units of SOFTMAX_PROBABILITY_ONE, zero for classes
+     * that are never decided on.
+     */
+
+    u32 thresholds[LABELS_MAX_LENGTH];
+    size_t length;
+};
+
+/*
+ * Reads the labels file. Returns XST_FAILURE when it cannot be read or
+ * has more than LABELS_MAX_LENGTH classes, a label that does not fit
+ * LABELS_NAME_SIZE or a threshold outside of 0 to 1.
+ */
+
+int labels_read(const char *path, struct labels *labels);
+
+/*
+ * Returns the index of the label or `labels->length` when there is none.
+ */
+
+size_t labels_find(const struct labels *labels, const char *name,
+                   size_t name_length);
@@ -0,0 +1,175 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "latency.h"
+#include "xstatus.h"
+
+void latency_init(struct latency *latency, const char *current) {
+    memset(latency, 0, sizeof(struct latency));
+    latency->current = current;
+}
+
+void latency_free(struct latency *latency) {
+    free(latency->clips);
+    latency->clips = NULL;
+}
+
+static bool is_same_command(const char *a, const char *b) {
+    return a && b && !strcmp(a, b);
+}
+
+int latency_add_clip(struct latency *latency, const char *command,
+                     u64 onset_ns) {
+    if (latency->clips_length == latency->clips_capacity) {
+        size_t capacity =
+            latency->clips_capacity ? 2 * latency->clips_capacity : 64;
+        struct latency_clip *clips =
+            realloc(latency->clips, capacity * sizeof(struct latency_clip));
+
+        if (!clips)
+            return XST_FAILURE;
+
+        latency->clips = clips;
+        latency->clips_capacity = capacity;
+    }
+
+    struct latency_clip *clip = &latency->clips[latency->clips_length++];
+
+    memset(clip, 0, sizeof(struct latency_clip));
+    clip->command = command;
+    clip->onset_ns = onset_ns;
+
+    return XST_SUCCESS;
+}
+
+void latency_actuate(struct latency *latency, const char *command,
+                     u64 time_ns) {
+
+    /*
+     * Clips starting before the actuation start with the command that
+     * ran before it.
+     */
+
+    while (latency->clip < latency->clips_length &&
+           latency->clips[latency->clip].onset_ns <= time_ns) {
+        struct latency_clip *clip = &latency->clips[latency->clip++];
+
+        clip->current = is_same_command(clip->command, latency->current);
+    }
+
+    struct latency_clip *clip =
+        latency->clip ? &latency->clips[latency->clip - 1] : NULL;
+
+    if (clip && !clip->hit && !clip->current &&
+        is_same_command(clip->command, command)) {
+        clip->hit = true;
+        clip->latency_ns = time_ns - clip->onset_ns;
+    } else
+        latency->false_actuations++;
+
+    latency->current = command;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    u64 x = *(const u64 *)a;
+    u64 y = *(const u64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void print_row(FILE *file, const char *name, size_t clips,
+                      size_t current, u64 *latencies, size_t hits) {
+    fprintf(file, "%10s %6zu %6zu %6zu %7zu", name, clips, hits,
+            clips - current - hits, current);
+
+    if (hits) {
+        double total = 0;
+
+        qsort(latencies, hits, sizeof(u64), compare_u64);
+
+        for (size_t i = 0; i < hits; i++)
+            total += latencies[i];
+
+        fprintf(file, " %8.1f %8.1f %8.1f %8.1f", total / hits / 1e6,
+                latencies[hits / 2] / 1e6, latencies[hits * 9 / 10] / 1e6,
+                latencies[hits - 1] / 1e6);
+    }
+
+    fprintf(file, "\n");
+}
+
+void latency_print(const struct latency *latency, FILE *file) {
+    const char *commands[LATENCY_MAX_COMMANDS];
+    size_t commands_length = 0;
+    size_t others = 0;
+
+    u64 *latencies = malloc((latency->clips_length + 1) * sizeof(u64));
+
+    if (!latencies)
+        return;
+
+    /*
+     * Commands in the order they first appear.
+     */
+
+    for (size_t i = 0; i < latency->clips_length; i++) {
+        const char *command = latency->clips[i].command;
+        size_t j = 0;
+
+        if (!command) {
+            others++;
+            continue;
+        }
+
+        while (j < commands_length && strcmp(commands[j], command))
+            j++;
+
+        if (j == commands_length && commands_length < LATENCY_MAX_COMMANDS)
+            commands[commands_length++] = command;
+    }
+
+    fprintf(file, "%10s %6s %6s %6s %7s %8s %8s %8s %8s\n", "command",
+            "clips", "hits", "misses", "current", "mean ms", "p50 ms",
+            "p90 ms", "max ms");
+
+    for (size_t j = 0; j <= commands_length; j++) {
+        size_t clips = 0;
+        size_t current = 0;
+        size_t hits = 0;
+
+        for (size_t i = 0; i < latency->clips_length; i++) {
+            const struct latency_clip *clip = &latency->clips[i];
+
+            if (!clip->command ||
+                (j < commands_length && strcmp(commands[j], clip->command)))
+                continue;
+
+            /*
+             * Clips past the last actuation start with the command that
+             * runs at the end.
+             */
+
+            bool is_current =
+                i < latency->clip
+                    ? clip->current
+                    : is_same_command(clip->command, latency->current);
+
+            clips++;
+            current += is_current;
+
+            if (clip->hit)
+                latencies[hits++] = clip->latency_ns;
+        }
+
+        print_row(file, j < commands_length ? commands[j] : "all", clips,
+                  current, latencies, hits);
+    }
+
+    fprintf(file, "%zu clips of other words, %zu false actuations\n", others,
+            latency->false_actuations);
+
+    free(latencies);
+}
@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "xil_types.h"
+
+/*
+ * Onset to actuation latency of commands spoken in a recording. Clips
+ * are placed in the recording with the time of their onset and the
+ * command they are expected to actuate, and actuations are reported
+ * with the time they happen on the same clock.
+ *
+ * An actuation is attributed to the last clip with its onset before it.
+ * The first actuation of the expected command is a hit, and any other
+ * actuation is false. Clips of commands that are already running when
+ * they start cannot actuate anything and are counted apart from misses.
+ */
+
+#define LATENCY_MAX_COMMANDS 8
+
+struct latency_clip {
+    const char *command;
+    u64 onset_ns;
+
+    bool current;
+    bool hit;
+    u64 latency_ns;
+};
+
+struct latency {
+    struct latency_clip *clips;
+    size_t clips_length;
+    size_t clips_capacity;
+
+    /*
+     * Index of the last clip with its onset before the last actuation,
+     * and the command that is running.
+     */
+
+    size_t clip;
+    const char *current;
+
+    size_t false_actuations;
+};
+
+/*
+ * Initializes the latency with `current` command running, which is not
+ * copied.
+ */
+
+void latency_init(struct latency *latency, const char *current);
+
+void latency_free(struct latency *latency);
+
+/*
+ * Adds the clip of `command` with onset at `onset_ns`. Clips must be
+ * added in the order of their onsets. `command` is not copied and can
+ * be NULL for clips that should not actuate anything. Returns
+ * XST_FAILURE when out of memory.
+ */
+
+int latency_add_clip(struct latency *latency, const char *command,
+                     u64 onset_ns);
+
+/*
+ * Records the actuation of `command` at `time_ns`. Actuations must be
+ * recorded in the order of their times.
+ */
+
+void latency_actuate(struct latency *latency, const char *command,
+                     u64 time_ns);
+
+/*
+ * Prints hits, misses and latency percentiles per command and for all
+ * of them, and the number of false actuations.
+ */
+
+void latency_print(const struct latency *latency, FILE *file);
@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "log.h"
+
+/*
+ * Decodes the binary log of the firmware (see vitis/log.h) captured
+ * from the UART and prints one line per record with the time in
+ * seconds since the first record.
+ *
+ * Usage: log_decode [-t ticks_per_second] [capture]
+ *
+ * The capture is read from standard input when not given. Bytes that
+ * do not form a frame with a valid checksum, such as text printed on
+ * demand, are skipped. The default ticks per second is the 100MHz clock
+ * of the board.
+ */
+
+#define DECODE_DEFAULT_TICKS_PER_SECOND 100000000
+
+/*
+ * Same order as `commands` in speech_robot.c.
+ */
+
+static const char *commands[] = {
+    "down",  "go",   "left", "no",  "off",       "on",
+    "right", "stop", "up",   "yes", "_silence_", "_unknown_"};
+
+#define DECODE_COMMANDS_LENGTH (sizeof(commands) / sizeof(commands[0]))
+
+static void print_record(const u8 *frame, double seconds) {
+    u8 type = frame[1];
+    u8 index = frame[2];
+    u16 value = frame[3] | frame[4] << 8;
+
+    printf("%10.3f ", seconds);
+
+    switch (type) {
+    case LOG_TYPE_PREDICTION: {
+        u8 command = index & ~LOG_FLAG_ACTION;
+
+        printf("%.4f %s%s\n", (double)value / LOG_PROBABILITY_ONE,
+               command < DECODE_COMMANDS_LENGTH ? commands[command] : "?",
+               index & LOG_FLAG_ACTION ? " <<<" : "");
+        break;
+    }
+    case LOG_TYPE_GATE_OPEN:
+        printf("vad: open\n");
+        break;
+    case LOG_TYPE_GATE_CLOSE:
+        printf("vad: closed, %u skipped\n", value);
+        break;
+    case LOG_TYPE_DROP:
+        printf("drop: step %u rows\n", value);
+        break;
+    default:
+        printf("unknown record %u\n", type);
+        break;
+    }
+}
+
+int main(int argc, char **argv) {
+    double ticks_per_second = DECODE_DEFAULT_TICKS_PER_SECOND;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:")) != -1) {
+        switch (opt) {
+        case 't':
+            ticks_per_second = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t ticks_per_second] [capture]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE *file = optind < argc ? fopen(argv[optind], "rb") : stdin;
+
+    if (!file) {
+        fprintf(stderr, "cannot open %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    u8 frame[LOG_FRAME_SIZE];
+    size_t length = 0;
+    size_t records = 0;
+    size_t skipped = 0;
+    u64 ticks = 0;
+    u32 last_ticks = 0;
+    int c;
+
+    while ((c = fgetc(file)) != EOF) {
+        frame[length++] = c;
+
+        if (frame[0] != LOG_FRAME_SYNC) {
+            length = 0;
+            skipped++;
+            continue;
+        }
+
+        if (length < LOG_FRAME_SIZE)
+            continue;
+
+        u8 sum = 0;
+
+        for (size_t i = 0; i < LOG_FRAME_SIZE - 1; i++)
+            sum += frame[i];
+
+        if (sum != frame[LOG_FRAME_SIZE - 1]) {
+
+            /*
+             * Not a frame. Resynchronize on the next sync byte.
+             */
+
+            size_t i = 1;
+
+            while (i < LOG_FRAME_SIZE && frame[i] != LOG_FRAME_SYNC)
+                i++;
+
+            for (size_t j = i; j < LOG_FRAME_SIZE; j++)
+                frame[j - i] = frame[j];
+
+            length = LOG_FRAME_SIZE - i;
+            skipped += i;
+            continue;
+        }
+
+        u32 frame_ticks = frame[5] | frame[6] << 8 | frame[7] << 16 |
+                          (u32)frame[8] << 24;
+
+        /*
+         * Ticks wrap around at 32 bits.
+         */
+
+        if (records)
+            ticks += (u32)(frame_ticks - last_ticks);
+
+        last_ticks = frame_ticks;
+
+        print_record(frame, ticks / ticks_per_second);
+
+        records++;
+        length = 0;
+    }
+
+    fprintf(stderr, "%zu records, %zu bytes skipped\n", records, skipped);
+
+    if (file != stdin)
+        fclose(file);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipeline.h"
+#include "xstatus.h"
+
+#define PIPELINE_DRAM0_SIZE (TENSIL_ARCHITECTURE_DRAM0_DEPTH * TCU_VECTOR_SIZE)
+
+struct pipeline *pipeline_init(const struct program *program) {
+    struct pipeline *pipeline =
+        aligned_alloc(TCU_VECTOR_SIZE, sizeof(struct pipeline));
+
+    if (!pipeline || program->prog_size <= PIPELINE_PROG_START) {
+        free(pipeline);
+        return NULL;
+    }
+
+    pipeline->program = program;
+    pipeline->dram0_ptr = aligned_alloc(TCU_VECTOR_SIZE, PIPELINE_DRAM0_SIZE);
+
+    if (!pipeline->dram0_ptr) {
+        free(pipeline);
+        return NULL;
+    }
+
+    memset(pipeline->dram0_ptr, 0, PIPELINE_DRAM0_SIZE);
+
+    stft_init(&pipeline->stft);
+    resize_init(&pipeline->resize, PIPELINE_INPUT_HEIGHT,
+                PIPELINE_INPUT_WIDTH);
+    tcu_init(&pipeline->tcu, NULL);
+
+    return pipeline;
+}
+
+void pipeline_free(struct pipeline *pipeline) {
+    if (!pipeline)
+        return;
+
+    free(pipeline->dram0_ptr);
+    free(pipeline);
+}
+
+int pipeline_infer(struct pipeline *pipeline, const int16_t *samples,
+                   size_t length, TCU_DT *logits) {
+    if (length > PIPELINE_CLIP_LENGTH)
+        length = PIPELINE_CLIP_LENGTH;
+
+    for (size_t i = 0; i < length; i++)
+        pipeline->samples[i] = samples[i] / 32768.0f;
+
+    for (size_t i = length; i < PIPELINE_CLIP_LENGTH; i++)
+        pipeline->samples[i] = 0;
+
+    stft_compute(&pipeline->stft, pipeline->samples, PIPELINE_INPUT_HEIGHT,
+                 &pipeline->lines[0][0]);
+
+    /*
+     * Same resize as in speech_robot.c with values taken from the upper
+     * half of the STFT line. The firmware writes it packed and has the
+     * TCU unpack it to the first lane of vectors, which is what we write
+     * here directly.
+     */
+
+    TCU_DT(*input)[TCU_VECTOR_LENGTH] =
+        (TCU_DT(*)[TCU_VECTOR_LENGTH])pipeline->dram0_ptr +
+        PIPELINE_RESIZED_OFFSET_VECTORS;
+
+    for (size_t i = 0; i < RESIZE_HEIGHT; i++) {
+        const struct resize_tap *tap = &pipeline->resize.rows[i];
+
+        resize_row(&pipeline->resize, i,
+                   &pipeline->lines[tap->first][STFT_LENGTH - 1],
+                   &pipeline->lines[tap->second][STFT_LENGTH - 1], -1,
+                   &input[i * RESIZE_WIDTH][0], TCU_VECTOR_LENGTH);
+    }
+
+    const struct program *program = pipeline->program;
+
+    tcu_set_dram(&pipeline->tcu, pipeline->dram0_ptr, program->consts_ptr);
+
+    int status = tcu_execute(&pipeline->tcu,
+                             program->prog_ptr + PIPELINE_PROG_START,
+                             program->prog_size - PIPELINE_PROG_START);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    memcpy(logits, pipeline->dram0_ptr,
+           PIPELINE_OUTPUT_LENGTH * sizeof(TCU_DT));
+
+    return XST_SUCCESS;
+}
@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "program.h"
+#include "resize.h"
+#include "stft.h"
+#include "tcu.h"
+
+/*
+ * Offline version of the firmware pipeline in speech_robot.c for one
+ * second clips: STFT over the sliding window of acquisition packets,
+ * the resize of the lower half of every STFT line into the 32 by 32
+ * model input and the inference. All memory used by the pipeline is
+ * allocated in `pipeline_init`, so that each thread can own one.
+ */
+
+#define PIPELINE_INPUT_WIDTH (STFT_LENGTH / 2 + 1)
+#define PIPELINE_INPUT_HEIGHT 124
+#define PIPELINE_CLIP_LENGTH                                                   \
+    ((PIPELINE_INPUT_HEIGHT - 1) * STFT_HOP + STFT_LENGTH)
+
+#define PIPELINE_OUTPUT_LENGTH 12
+
+/*
+ * Same as MODEL_INPUT_OFFSET_VECTORS and MODEL_PROG_RESIZE_LENGTH in
+ * speech_robot.c. The program is run past its resize layer with the
+ * resized input placed where that layer would have written it.
+ */
+
+#define PIPELINE_RESIZED_OFFSET_VECTORS 15996
+#define PIPELINE_PROG_START (10255 * TCU_INSTRUCTION_SIZE)
+
+struct pipeline {
+    const struct program *program;
+
+    struct stft stft;
+    struct resize resize;
+    struct tcu tcu;
+
+    float samples[PIPELINE_CLIP_LENGTH];
+    STFT_DT lines[PIPELINE_INPUT_HEIGHT][STFT_LENGTH];
+
+    u8 *dram0_ptr;
+};
+
+/*
+ * Allocates the pipeline. Returns NULL when out of memory or when the
+ * program is too short to contain the resize layer.
+ */
+
+struct pipeline *pipeline_init(const struct program *program);
+
+void pipeline_free(struct pipeline *pipeline);
+
+/*
+ * Runs the clip of 16-bit PCM samples through the pipeline and writes
+ * PIPELINE_OUTPUT_LENGTH logits. Clips shorter than one second are
+ * padded with silence and longer ones are truncated.
+ */
+
+int pipeline_infer(struct pipeline *pipeline, const int16_t *samples,
+                   size_t length, TCU_DT *logits);
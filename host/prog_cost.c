@@ -0,0 +1,694 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xil_types.h"
+#include "xstatus.h"
+
+/*
+ * Statically analyzes a compiled program and estimates how long the TCU
+ * takes to run it, without running it.
+ *
+ * Usage: prog_cost [-a arch.tarch] [-r resize_length] [-w windows]
+ *                  [-v variant.tarch]... [model.tprog]
+ *
+ * Instructions are decoded with the instruction layout derived from the
+ * architecture the program was compiled for, as the Tensil compiler
+ * does: the local memory address, the DRAM or accumulator address and
+ * the size take as many bits as their depths need, addresses are
+ * followed by the stride, and each operand is rounded up to whole bytes
+ * under a header byte with the opcode and the flags.
+ *
+ * The program is split into layers. The compiler emits each layer as
+ * partitions that load their weights from DRAM1, compute and store
+ * their output to DRAM0, and a partition starts a new layer when it
+ * reads DRAM0 vectors written by the layer it would otherwise belong
+ * to. For every layer it prints the instructions, the vectors
+ * multiplied and loaded into the systolic array, the DRAM bytes moved
+ * and the estimated cycles and time at COST_CLOCK_MHZ, followed by the
+ * opcode histogram of the program and the predicted latency of an
+ * inference as the firmware runs it, past the first `resize_length`
+ * instructions, against the window budget of 1000 / `windows` ms
+ * (MODEL_INPUT_WINDOW_NUMBER).
+ *
+ * The cycle estimate runs the instructions one after another. Each
+ * takes COST_ISSUE_CYCLES, plus a cycle per vector through the array,
+ * the accumulators or the SIMD unit, and DRAM moves also wait
+ * COST_DRAM_LATENCY_CYCLES and then transfer COST_DRAM_BYTES_PER_CYCLE.
+ * The TCU overlaps some of this, so the estimate is an upper bound.
+ *
+ * Each -v architecture is compared with the one the program was
+ * compiled for by scaling the work of every layer, since the program
+ * itself would have to be recompiled. An array k times wider takes k
+ * times fewer vectors for the same bytes and, when the channels fill
+ * it, k^2 times fewer matrix multiplication vectors, so the matrix
+ * multiplications are a lower bound. Weights are reloaded into the
+ * array for every accumulator-sized block of the output, so a deeper
+ * accumulator loads them fewer times, but never fewer than once.
+ */
+
+#define COST_DEFAULT_ARCH "arch/speech_robot.tarch"
+#define COST_DEFAULT_PROG "model/speech_commands_onnx_speech_robot.tprog"
+#define COST_DEFAULT_RESIZE_LENGTH 10255
+#define COST_DEFAULT_WINDOWS 4
+
+#define COST_MAX_LAYERS 64
+#define COST_MAX_VARIANTS 8
+
+#define COST_CLOCK_MHZ 100
+#define COST_ISSUE_CYCLES 1
+#define COST_DRAM_LATENCY_CYCLES 32
+#define COST_DRAM_BYTES_PER_CYCLE 16
+
+#define COST_HEADER_SIZE_BITS 8
+#define COST_SIMD_OPERAND_SIZE_BITS 7
+
+#define COST_OPCODE_NOOP 0x0
+#define COST_OPCODE_MATMUL 0x1
+#define COST_OPCODE_DATA_MOVE 0x2
+#define COST_OPCODE_LOAD_WEIGHT 0x3
+#define COST_OPCODE_SIMD 0x4
+#define COST_OPCODE_CONFIG 0xf
+#define COST_OPCODES 16
+
+#define COST_DATA_MOVE_FLAG_DRAM0_TO_LOCAL 0x0
+#define COST_DATA_MOVE_FLAG_LOCAL_TO_DRAM0 0x1
+#define COST_DATA_MOVE_FLAG_DRAM1_TO_LOCAL 0x2
+#define COST_DATA_MOVE_FLAG_LOCAL_TO_DRAM1 0x3
+
+struct architecture {
+    const char *path;
+    u32 array_size;
+    u32 dram0_depth;
+    u32 dram1_depth;
+    u32 local_depth;
+    u32 accumulator_depth;
+    u32 stride0_depth;
+    u32 stride1_depth;
+};
+
+struct layout {
+    size_t local_address_size_bits;
+    size_t dram_address_size_bits;
+    size_t stride0_size_bits;
+    size_t stride1_size_bits;
+    size_t operand0_size_bits;
+    size_t operand1_size_bits;
+    size_t operand2_size_bits;
+    size_t size;
+};
+
+struct instruction {
+    u8 opcode;
+    u8 flags;
+    u64 operand0;
+    u64 operand1;
+    u64 operand2;
+};
+
+struct cost {
+    u64 instructions;
+    u64 opcodes[COST_OPCODES];
+    u64 matmul_vectors;
+    u64 load_weight_vectors;
+    u64 dram0_vectors;
+    u64 dram1_vectors;
+    u64 accumulator_vectors;
+    u64 dram_moves;
+};
+
+struct layer {
+    size_t start;
+    size_t end;
+    struct cost cost;
+};
+
+static const char *opcode_names[COST_OPCODES] = {
+    [COST_OPCODE_NOOP] = "noop",
+    [COST_OPCODE_MATMUL] = "matmul",
+    [COST_OPCODE_DATA_MOVE] = "data move",
+    [COST_OPCODE_LOAD_WEIGHT] = "load weight",
+    [COST_OPCODE_SIMD] = "simd",
+    [COST_OPCODE_CONFIG] = "config",
+};
+
+static char *read_text(const char *path) {
+    FILE *file = fopen(path, "rb");
+    char *text = NULL;
+    long size;
+
+    if (!file)
+        return NULL;
+
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 &&
+        fseek(file, 0, SEEK_SET) == 0 && (text = malloc(size + 1))) {
+        if (fread(text, 1, size, file) == (size_t)size)
+            text[size] = 0;
+        else {
+            free(text);
+            text = NULL;
+        }
+    }
+
+    fclose(file);
+
+    return text;
+}
+
+/*
+ * The .tarch keys are unique, so like image_pack this reads the JSON
+ * without a parser.
+ */
+
+static const char *find_value(const char *json, const char *key) {
+    char pattern[64];
+
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    json = strstr(json, pattern);
+
+    if (!json)
+        return NULL;
+
+    json += strlen(pattern);
+
+    while (isspace((unsigned char)*json) || *json == ':')
+        json++;
+
+    return json;
+}
+
+static int get_number(const char *json, const char *key, u32 *value) {
+    const char *ptr = find_value(json, key);
+    char *end;
+
+    if (!ptr)
+        return XST_FAILURE;
+
+    *value = strtoul(ptr, &end, 10);
+
+    return end == ptr || !*value ? XST_FAILURE : XST_SUCCESS;
+}
+
+static int read_architecture(const char *path,
+                             struct architecture *architecture) {
+    char *json = read_text(path);
+    const char *data_type = json ? find_value(json, "data_type") : NULL;
+    int status = XST_FAILURE;
+
+    architecture->path = path;
+
+    if (data_type && !strncmp(data_type, "\"FP16BP8\"", 9) &&
+        get_number(json, "array_size", &architecture->array_size) ==
+            XST_SUCCESS &&
+        get_number(json, "dram0_depth", &architecture->dram0_depth) ==
+            XST_SUCCESS &&
+        get_number(json, "dram1_depth", &architecture->dram1_depth) ==
+            XST_SUCCESS &&
+        get_number(json, "local_depth", &architecture->local_depth) ==
+            XST_SUCCESS &&
+        get_number(json, "accumulator_depth",
+                   &architecture->accumulator_depth) == XST_SUCCESS &&
+        get_number(json, "stride0_depth", &architecture->stride0_depth) ==
+            XST_SUCCESS &&
+        get_number(json, "stride1_depth", &architecture->stride1_depth) ==
+            XST_SUCCESS)
+        status = XST_SUCCESS;
+
+    free(json);
+
+    return status;
+}
+
+static size_t get_size_bits(u32 depth) {
+    size_t bits = 0;
+
+    while ((1ull << bits) < depth)
+        bits++;
+
+    return bits;
+}
+
+static size_t round_to_bytes(size_t bits) { return (bits + 7) / 8 * 8; }
+
+static size_t max_size(size_t a, size_t b) { return a > b ? a : b; }
+
+/*
+ * Operand 0 is a local memory address, operand 1 a DRAM or accumulator
+ * address and operand 2 the size in vectors less one, or the SIMD
+ * operation and its registers.
+ */
+
+static void get_layout(const struct architecture *architecture,
+                       struct layout *layout) {
+    layout->local_address_size_bits =
+        get_size_bits(architecture->local_depth);
+    layout->dram_address_size_bits =
+        get_size_bits(max_size(max_size(architecture->dram0_depth,
+                                        architecture->dram1_depth),
+                               architecture->accumulator_depth));
+    layout->stride0_size_bits = get_size_bits(architecture->stride0_depth);
+    layout->stride1_size_bits = get_size_bits(architecture->stride1_depth);
+
+    layout->operand0_size_bits = round_to_bytes(
+        layout->local_address_size_bits + layout->stride0_size_bits);
+    layout->operand1_size_bits = round_to_bytes(
+        layout->dram_address_size_bits + layout->stride1_size_bits);
+    layout->operand2_size_bits = round_to_bytes(max_size(
+        max_size(layout->local_address_size_bits,
+                 get_size_bits(architecture->accumulator_depth)),
+        COST_SIMD_OPERAND_SIZE_BITS));
+
+    layout->size = (layout->operand0_size_bits + layout->operand1_size_bits +
+                    layout->operand2_size_bits + COST_HEADER_SIZE_BITS) /
+                   8;
+}
+
+static u64 get_bits(u64 value, size_t offset, size_t size) {
+    return (value >> offset) & ((1ull << size) - 1);
+}
+
+static void decode(const struct layout *layout, const u8 *ptr,
+                   struct instruction *instruction) {
+    u64 value = 0;
+
+    for (size_t i = 0; i < layout->size; i++)
+        value |= (u64)ptr[i] << (8 * i);
+
+    size_t offset1 = layout->operand0_size_bits;
+    size_t offset2 = offset1 + layout->operand1_size_bits;
+    size_t offset_header = offset2 + layout->operand2_size_bits;
+
+    instruction->operand0 = get_bits(value, 0, layout->operand0_size_bits);
+    instruction->operand1 =
+        get_bits(value, offset1, layout->operand1_size_bits);
+    instruction->operand2 =
+        get_bits(value, offset2, layout->operand2_size_bits);
+    instruction->opcode = get_bits(value, offset_header + 4, 4);
+    instruction->flags = get_bits(value, offset_header, 4);
+}
+
+static void count(struct cost *cost, const struct instruction *instruction) {
+    u64 size = instruction->operand2 + 1;
+
+    cost->instructions++;
+    cost->opcodes[instruction->opcode]++;
+
+    switch (instruction->opcode) {
+    case COST_OPCODE_MATMUL:
+        cost->matmul_vectors += size;
+        break;
+
+    case COST_OPCODE_LOAD_WEIGHT:
+        cost->load_weight_vectors += instruction->operand1 + 1;
+        break;
+
+    case COST_OPCODE_DATA_MOVE:
+        switch (instruction->flags) {
+        case COST_DATA_MOVE_FLAG_DRAM0_TO_LOCAL:
+        case COST_DATA_MOVE_FLAG_LOCAL_TO_DRAM0:
+            cost->dram0_vectors += size;
+            cost->dram_moves++;
+            break;
+
+        case COST_DATA_MOVE_FLAG_DRAM1_TO_LOCAL:
+        case COST_DATA_MOVE_FLAG_LOCAL_TO_DRAM1:
+            cost->dram1_vectors += size;
+            cost->dram_moves++;
+            break;
+
+        default:
+            cost->accumulator_vectors += size;
+            break;
+        }
+        break;
+    }
+}
+
+static void add_cost(struct cost *total, const struct cost *cost) {
+    total->instructions += cost->instructions;
+
+    for (size_t i = 0; i < COST_OPCODES; i++)
+        total->opcodes[i] += cost->opcodes[i];
+
+    total->matmul_vectors += cost->matmul_vectors;
+    total->load_weight_vectors += cost->load_weight_vectors;
+    total->dram0_vectors += cost->dram0_vectors;
+    total->dram1_vectors += cost->dram1_vectors;
+    total->accumulator_vectors += cost->accumulator_vectors;
+    total->dram_moves += cost->dram_moves;
+}
+
+/*
+ * Finds the layers, keeping for every DRAM0 vector the number of the
+ * layer that last wrote it plus one. Returns the number of layers, or
+ * zero when an instruction is unknown or a DRAM0 address is outside of
+ * the memory.
+ */
+
+static size_t find_layers(const struct architecture *architecture,
+                          const struct layout *layout, const u8 *prog_ptr,
+                          size_t length, struct layer *layers) {
+    u32 *writers = calloc(architecture->dram0_depth, sizeof(u32));
+    size_t layers_length = 1;
+    size_t partition_start = 0;
+    bool is_stored = false;
+
+    if (!writers)
+        return 0;
+
+    layers[0].start = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        struct instruction instruction;
+
+        decode(layout, prog_ptr + i * layout->size, &instruction);
+
+        if (!opcode_names[instruction.opcode]) {
+            layers_length = 0;
+            break;
+        }
+
+        if (instruction.opcode != COST_OPCODE_DATA_MOVE)
+            continue;
+
+        if (instruction.flags == COST_DATA_MOVE_FLAG_DRAM1_TO_LOCAL &&
+            is_stored) {
+            partition_start = i;
+            is_stored = false;
+        }
+
+        if (instruction.flags != COST_DATA_MOVE_FLAG_DRAM0_TO_LOCAL &&
+            instruction.flags != COST_DATA_MOVE_FLAG_LOCAL_TO_DRAM0)
+            continue;
+
+        size_t address = get_bits(instruction.operand1, 0,
+                                  layout->dram_address_size_bits);
+        size_t stride = 1 << get_bits(instruction.operand1,
+                                      layout->dram_address_size_bits,
+                                      layout->stride1_size_bits);
+        size_t size = instruction.operand2 + 1;
+
+        if (address + (size - 1) * stride >= architecture->dram0_depth) {
+            layers_length = 0;
+            break;
+        }
+
+        for (size_t j = 0; j < size; j++) {
+            u32 *writer = &writers[address + j * stride];
+
+            if (instruction.flags == COST_DATA_MOVE_FLAG_LOCAL_TO_DRAM0)
+                *writer = layers_length;
+            else if (*writer == layers_length &&
+                     partition_start > layers[layers_length - 1].start) {
+                if (layers_length == COST_MAX_LAYERS)
+                    continue;
+
+                layers[layers_length - 1].end = partition_start;
+                layers[layers_length++].start = partition_start;
+            }
+        }
+
+        if (instruction.flags == COST_DATA_MOVE_FLAG_LOCAL_TO_DRAM0)
+            is_stored = true;
+    }
+
+    if (layers_length)
+        layers[layers_length - 1].end = length;
+
+    free(writers);
+
+    return layers_length;
+}
+
+/*
+ * Estimates the cycles of the work counted for `compiled` on `target`.
+ */
+
+static double get_cycles(const struct cost *cost,
+                         const struct architecture *compiled,
+                         const struct architecture *target) {
+    double width = (double)target->array_size / compiled->array_size;
+    double depth =
+        (double)target->accumulator_depth / compiled->accumulator_depth;
+    double vector_size = target->array_size * sizeof(int16_t);
+    double dram_cycles = vector_size / COST_DRAM_BYTES_PER_CYCLE;
+
+    if (dram_cycles < 1)
+        dram_cycles = 1;
+
+    double matmul = cost->matmul_vectors / (width * width);
+    double load_weight = cost->load_weight_vectors / width / depth;
+    double weights = (cost->load_weight_vectors < cost->dram1_vectors
+                          ? cost->load_weight_vectors
+                          : cost->dram1_vectors) /
+                     width;
+
+    if (load_weight < weights)
+        load_weight = weights;
+
+    double vectors =
+        (cost->accumulator_vectors + cost->opcodes[COST_OPCODE_SIMD]) /
+        width;
+    double dram_vectors = (cost->dram0_vectors + cost->dram1_vectors) / width;
+
+    return cost->instructions * COST_ISSUE_CYCLES + matmul + load_weight +
+           vectors + dram_vectors * dram_cycles +
+           cost->dram_moves * COST_DRAM_LATENCY_CYCLES;
+}
+
+static double get_ms(double cycles) {
+    return cycles / (COST_CLOCK_MHZ * 1000.0);
+}
+
+static void print_layers(const struct architecture *architecture,
+                         const struct layer *layers, size_t length,
+                         size_t vector_size) {
+    printf("%5s %7s %7s %7s %8s %8s %9s %9s %9s %7s\n", "layer", "first",
+           "instrs", "matmul", "vectors", "load w", "dram0 KB", "dram1 KB",
+           "cycles", "ms");
+
+    for (size_t i = 0; i < length; i++) {
+        const struct cost *cost = &layers[i].cost;
+        double cycles = get_cycles(cost, architecture, architecture);
+
+        printf("%5zu %7zu %7llu %7llu %8llu %8llu %9.1f %9.1f %9.0f %7.3f\n",
+               i, layers[i].start, (unsigned long long)cost->instructions,
+               (unsigned long long)cost->opcodes[COST_OPCODE_MATMUL],
+               (unsigned long long)cost->matmul_vectors,
+               (unsigned long long)cost->load_weight_vectors,
+               cost->dram0_vectors * vector_size / 1024.0,
+               cost->dram1_vectors * vector_size / 1024.0, cycles,
+               get_ms(cycles));
+    }
+}
+
+static void print_histogram(const struct cost *cost) {
+    printf("\n%-12s %8s %6s\n", "opcode", "count", "%");
+
+    for (size_t i = 0; i < COST_OPCODES; i++)
+        if (opcode_names[i])
+            printf("%-12s %8llu %5.1f%%\n", opcode_names[i],
+                   (unsigned long long)cost->opcodes[i],
+                   100.0 * cost->opcodes[i] / cost->instructions);
+}
+
+static void print_latency(const char *name, const struct cost *cost,
+                          const struct architecture *architecture,
+                          double budget_ms) {
+    double ms = get_ms(get_cycles(cost, architecture, architecture));
+
+    printf("%-9s %9.3f ms, %5.1f%% of the %.0f ms window budget\n", name,
+           ms, 100.0 * ms / budget_ms, budget_ms);
+}
+
+static void print_variants(const struct architecture *compiled,
+                           const struct architecture *variants,
+                           size_t variants_length, const struct cost *cost,
+                           double budget_ms) {
+    double cycles = get_cycles(cost, compiled, compiled);
+
+    printf("\n%-32s %5s %11s %9s %9s %8s\n", "architecture", "array",
+           "accumulator", "ms", "budget", "speedup");
+
+    for (size_t i = 0; i <= variants_length; i++) {
+        const struct architecture *target = i ? &variants[i - 1] : compiled;
+        double ms = get_ms(get_cycles(cost, compiled, target));
+
+        printf("%-32s %5u %11u %9.3f %8.1f%% %7.2fx\n", target->path,
+               target->array_size, target->accumulator_depth, ms,
+               100.0 * ms / budget_ms, get_ms(cycles) / ms);
+    }
+}
+
+static int read_prog(const char *path, u8 **ptr, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    long length;
+
+    if (!file)
+        return XST_FAILURE;
+
+    *ptr = NULL;
+
+    if (fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) >= 0 &&
+        fseek(file, 0, SEEK_SET) == 0 && (*ptr = malloc(length + 1))) {
+        *size = fread(*ptr, 1, length, file);
+
+        if (*size != (size_t)length) {
+            free(*ptr);
+            *ptr = NULL;
+        }
+    }
+
+    fclose(file);
+
+    return *ptr ? XST_SUCCESS : XST_FAILURE;
+}
+
+int main(int argc, char **argv) {
+    const char *arch_path = COST_DEFAULT_ARCH;
+    const char *prog_path = COST_DEFAULT_PROG;
+    const char *variant_paths[COST_MAX_VARIANTS];
+    size_t variants_length = 0;
+    size_t resize_length = COST_DEFAULT_RESIZE_LENGTH;
+    size_t windows = COST_DEFAULT_WINDOWS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:r:w:v:")) != -1) {
+        switch (opt) {
+        case 'a':
+            arch_path = optarg;
+            break;
+        case 'r':
+            resize_length = atoi(optarg);
+            break;
+        case 'w':
+            windows = atoi(optarg);
+            break;
+        case 'v':
+            if (variants_length == COST_MAX_VARIANTS)
+                goto usage;
+
+            variant_paths[variants_length++] = optarg;
+            break;
+        default:
+            goto usage;
+        }
+    }
+
+    if (optind + 1 < argc || !windows)
+        goto usage;
+
+    if (optind < argc)
+        prog_path = argv[optind];
+
+    struct architecture architecture;
+    struct architecture variants[COST_MAX_VARIANTS];
+
+    if (read_architecture(arch_path, &architecture) != XST_SUCCESS) {
+        fprintf(stderr, "failed to read %s\n", arch_path);
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < variants_length; i++)
+        if (read_architecture(variant_paths[i], &variants[i]) !=
+            XST_SUCCESS) {
+            fprintf(stderr, "failed to read %s\n", variant_paths[i]);
+            return EXIT_FAILURE;
+        }
+
+    struct layout layout;
+
+    get_layout(&architecture, &layout);
+
+    if (layout.size > sizeof(u64)) {
+        fprintf(stderr, "instructions of %zu bytes are not supported\n",
+                layout.size);
+        return EXIT_FAILURE;
+    }
+
+    u8 *prog_ptr;
+    size_t prog_size;
+
+    if (read_prog(prog_path, &prog_ptr, &prog_size) != XST_SUCCESS) {
+        fprintf(stderr, "failed to read %s\n", prog_path);
+        return EXIT_FAILURE;
+    }
+
+    size_t length = prog_size / layout.size;
+    struct layer layers[COST_MAX_LAYERS] = {0};
+    size_t layers_length;
+
+    if (prog_size % layout.size || resize_length > length ||
+        !(layers_length = find_layers(&architecture, &layout, prog_ptr,
+                                      length, layers))) {
+        fprintf(stderr, "unexpected program\n");
+        return EXIT_FAILURE;
+    }
+
+    struct cost total = {0};
+    struct cost body = {0};
+
+    for (size_t i = 0; i < length; i++) {
+        struct instruction instruction;
+        struct layer *layer = layers;
+
+        decode(&layout, prog_ptr + i * layout.size, &instruction);
+
+        while (i >= layer->end)
+            layer++;
+
+        count(&layer->cost, &instruction);
+
+        if (i >= resize_length)
+            count(&body, &instruction);
+    }
+
+    for (size_t i = 0; i < layers_length; i++)
+        add_cost(&total, &layers[i].cost);
+
+    size_t vector_size = architecture.array_size * sizeof(int16_t);
+    double budget_ms = 1000.0 / windows;
+
+    printf("program  %zu instructions of %zu bytes: operand0 %zu bits (%zu "
+           "address, %zu stride), operand1 %zu bits (%zu, %zu), operand2 "
+           "%zu bits\n\n",
+           length, layout.size, layout.operand0_size_bits,
+           layout.local_address_size_bits, layout.stride0_size_bits,
+           layout.operand1_size_bits, layout.dram_address_size_bits,
+           layout.stride1_size_bits, layout.operand2_size_bits);
+
+    print_layers(&architecture, layers, layers_length, vector_size);
+    print_histogram(&total);
+
+    printf("\nmatmul   %llu vectors, load weight %llu vectors\n",
+           (unsigned long long)total.matmul_vectors,
+           (unsigned long long)total.load_weight_vectors);
+    printf("dram0    %.1f KB, dram1 %.1f KB, accumulators %.1f KB\n\n",
+           total.dram0_vectors * vector_size / 1024.0,
+           total.dram1_vectors * vector_size / 1024.0,
+           total.accumulator_vectors * vector_size / 1024.0);
+
+    print_latency("program", &total, &architecture, budget_ms);
+    print_latency("inference", &body, &architecture, budget_ms);
+
+    if (variants_length)
+        print_variants(&architecture, variants, variants_length, &body,
+                       budget_ms);
+
+    free(prog_ptr);
+
+    return EXIT_SUCCESS;
+
+usage:
+    fprintf(stderr,
+            "usage: %s [-a arch.tarch] [-r resize_length] [-w windows] "
+            "[-v variant.tarch]... [model.tprog]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+}
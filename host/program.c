@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "program.h"
+#include "xstatus.h"
+
+static int read_file(const char *path, u8 **ptr, size_t *size) {
+    FILE *file = fopen(path, "rb");
+
+    if (!file)
+        return XST_FAILURE;
+
+    int status = XST_FAILURE;
+
+    if (fseek(file, 0, SEEK_END))
+        goto done;
+
+    long length = ftell(file);
+
+    if (length < 0 || fseek(file, 0, SEEK_SET))
+        goto done;
+
+    /*
+     * Round up to the whole number of vectors, so that the buffer can
+     * be used as DRAM.
+     */
+
+    size_t aligned_size =
+        (length + TCU_VECTOR_SIZE - 1) / TCU_VECTOR_SIZE * TCU_VECTOR_SIZE;
+
+    *ptr = aligned_alloc(TCU_VECTOR_SIZE, aligned_size ? aligned_size
+                                                       : TCU_VECTOR_SIZE);
+
+    if (!*ptr)
+        goto done;
+
+    memset(*ptr, 0, aligned_size);
+
+    if (fread(*ptr, 1, length, file) != (size_t)length) {
+        free(*ptr);
+        *ptr = NULL;
+        goto done;
+    }
+
+    *size = length;
+    status = XST_SUCCESS;
+
+done:
+    fclose(file);
+    return status;
+}
+
+int program_read(struct program *program, const char *prog_path,
+                 const char *consts_path) {
+    memset(program, 0, sizeof(struct program));
+
+    if (read_file(prog_path, &program->prog_ptr, &program->prog_size) !=
+            XST_SUCCESS ||
+        read_file(consts_path, &program->consts_ptr,
+                  &program->consts_size) != XST_SUCCESS) {
+        program_free(program);
+        return XST_FAILURE;
+    }
+
+    return XST_SUCCESS;
+}
+
+void program_free(struct program *program) {
+    free(program->prog_ptr);
+    free(program->consts_ptr);
+    memset(program, 0, sizeof(struct program));
+}
+
+int program_run(const struct program *program, struct tcu *tcu,
+                u8 *dram0_ptr) {
+    tcu_set_dram(tcu, dram0_ptr, program->consts_ptr);
+
+    return tcu_execute(tcu, program->prog_ptr, program->prog_size);
+}
@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "tcu.h"
+#include "xil_types.h"
+
+/*
+ * Compiled model as produced by the Tensil compiler: the instructions
+ * (.tprog) and the constants (.tdata) that are placed in DRAM1. The
+ * program never writes DRAM1, so the constants can be shared by any
+ * number of interpreters.
+ */
+
+struct program {
+    u8 *prog_ptr;
+    size_t prog_size;
+
+    u8 *consts_ptr;
+    size_t consts_size;
+};
+
+/*
+ * Reads the program and the constants files. Returns XST_SUCCESS on
+ * success.
+ */
+
+int program_read(struct program *program, const char *prog_path,
+                 const char *consts_path);
+
+void program_free(struct program *program);
+
+/*
+ * Runs the program with the input and output in DRAM0 vectors at
+ * `dram0_ptr`, which must hold TENSIL_ARCHITECTURE_DRAM0_DEPTH vectors.
+ */
+
+int program_run(const struct program *program, struct tcu *tcu,
+                u8 *dram0_ptr);
@@ -0,0 +1,285 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pipeline.h"
+#include "program.h"
+#include "softmax.h"
+#include "wav.h"
+#include "xstatus.h"
+
+/*
+ * Compares the fixed point softmax of vitis/softmax.c with the double
+ * precision softmax and argmax it replaced in speech_robot.c, which
+ * took exponents from the exponent DMA, and measures the time of both.
+ *
+ * Usage: softmax_bench [-n vectors] [-p model.tprog] [-c model.tdata]
+ *                      [file.wav...]
+ *
+ * Logits are inferred from the clips by the pipeline when WAV files are
+ * given. Otherwise there are `vectors` synthetic vectors of logits
+ * uniform in a range from +/-1 to +/-16, so that distributions from
+ * flat to peaked are covered. The errors of the top probability and of
+ * the margin to the second are in units of 1 / SOFTMAX_PROBABILITY_ONE.
+ * Decisions are compared against the thresholds of speech_robot.c.
+ *
+ * On the host the double precision version runs on the FPU, while the
+ * MicroBlaze emulates double precision in software, so the times only
+ * bound the cost of the fixed point version from above.
+ */
+
+#define BENCH_DEFAULT_PROG "model/speech_commands_onnx_speech_robot.tprog"
+#define BENCH_DEFAULT_CONSTS "model/speech_commands_onnx_speech_robot.tdata"
+#define BENCH_DEFAULT_VECTORS 100000
+#define BENCH_MIN_NS 200000000
+
+#define BENCH_LENGTH PIPELINE_OUTPUT_LENGTH
+
+static const double thresholds[] = {0.6, 0.7, 0.8};
+
+#define BENCH_THRESHOLDS_LENGTH (sizeof(thresholds) / sizeof(thresholds[0]))
+
+static u64 get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Same as the softmax and argmax computed from the exponent DMA output.
+ */
+
+static void softmax_double(const TCU_DT *logits, size_t length,
+                           struct softmax_result *result,
+                           double *probability, double *margin) {
+    double softmax[BENCH_LENGTH];
+    double sum = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        softmax[i] = exp(logits[i] / 256.0);
+        sum += softmax[i];
+    }
+
+    size_t first = softmax[1] > softmax[0];
+    size_t second = 1 - first;
+
+    for (size_t i = 2; i < length; i++) {
+        if (softmax[i] > softmax[first]) {
+            second = first;
+            first = i;
+        } else if (softmax[i] > softmax[second])
+            second = i;
+    }
+
+    result->first = first;
+    result->second = second;
+
+    *probability = softmax[first] / sum;
+    *margin = (softmax[first] - softmax[second]) / sum;
+}
+
+static void generate_logits(TCU_DT (*logits)[BENCH_LENGTH], size_t length) {
+    u32 seed = 1;
+
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1664525 + 1013904223;
+
+        int range = (1 + (seed >> 28)) * 256;
+
+        for (size_t j = 0; j < BENCH_LENGTH; j++) {
+            seed = seed * 1664525 + 1013904223;
+            logits[i][j] = (int)((u64)(seed >> 8) * 2 * range >> 24) - range;
+        }
+    }
+}
+
+static TCU_DT (*infer_logits(const char *prog_path, const char *consts_path,
+                             int argc, char **argv))[BENCH_LENGTH] {
+    struct program program;
+
+    if (program_read(&program, prog_path, consts_path) != XST_SUCCESS) {
+        fprintf(stderr, "failed to read %s or %s\n", prog_path, consts_path);
+        return NULL;
+    }
+
+    struct pipeline *pipeline = pipeline_init(&program);
+    TCU_DT(*logits)[BENCH_LENGTH] = malloc(argc * sizeof(*logits));
+
+    if (!pipeline || !logits) {
+        fprintf(stderr, "out of memory\n");
+        return NULL;
+    }
+
+    for (int i = 0; i < argc; i++) {
+        struct wav wav;
+
+        if (wav_read(argv[i], &wav) != XST_SUCCESS) {
+            fprintf(stderr, "failed to read %s\n", argv[i]);
+            return NULL;
+        }
+
+        if (pipeline_infer(pipeline, wav.samples, wav.length, logits[i]) !=
+            XST_SUCCESS) {
+            fprintf(stderr, "failed to infer %s\n", argv[i]);
+            return NULL;
+        }
+
+        wav_free(&wav);
+    }
+
+    pipeline_free(pipeline);
+    program_free(&program);
+
+    return logits;
+}
+
+int main(int argc, char **argv) {
+    const char *prog_path = BENCH_DEFAULT_PROG;
+    const char *consts_path = BENCH_DEFAULT_CONSTS;
+    size_t length = BENCH_DEFAULT_VECTORS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:p:c:")) != -1) {
+        switch (opt) {
+        case 'n':
+            length = atol(optarg);
+            break;
+        case 'p':
+            prog_path = optarg;
+            break;
+        case 'c':
+            consts_path = optarg;
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-n vectors] [-p model.tprog] "
+                    "[-c model.tdata] [file.wav...]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    TCU_DT(*logits)[BENCH_LENGTH];
+
+    if (optind < argc) {
+        length = argc - optind;
+        logits =
+            infer_logits(prog_path, consts_path, length, argv + optind);
+
+        if (!logits)
+            return EXIT_FAILURE;
+    } else {
+        logits = malloc(length * sizeof(*logits));
+
+        if (!logits || !length) {
+            fprintf(stderr, "no vectors\n");
+            return EXIT_FAILURE;
+        }
+
+        generate_logits(logits, length);
+    }
+
+    size_t first_mismatches = 0;
+    size_t second_mismatches = 0;
+    size_t decision_mismatches[BENCH_THRESHOLDS_LENGTH] = {0};
+    double max_error = 0;
+    double total_error = 0;
+    double max_margin_error = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        struct softmax_result fixed;
+        struct softmax_result reference;
+        double probability;
+        double margin;
+
+        softmax_top2(logits[i], BENCH_LENGTH, &fixed);
+        softmax_double(logits[i], BENCH_LENGTH, &reference, &probability,
+                       &margin);
+
+        first_mismatches += fixed.first != reference.first;
+        second_mismatches += fixed.second != reference.second;
+
+        double error = fabs((double)fixed.probability -
+                            probability * SOFTMAX_PROBABILITY_ONE);
+        double margin_error =
+            fabs((double)fixed.margin - margin * SOFTMAX_PROBABILITY_ONE);
+
+        if (error > max_error)
+            max_error = error;
+
+        if (margin_error > max_margin_error)
+            max_margin_error = margin_error;
+
+        total_error += error;
+
+        for (size_t j = 0; j < BENCH_THRESHOLDS_LENGTH; j++)
+            decision_mismatches[j] +=
+                (fixed.probability > SOFTMAX_PROBABILITY(thresholds[j])) !=
+                (probability > thresholds[j]);
+    }
+
+    printf("vectors: %zu, first mismatches: %zu, second mismatches: %zu\n",
+           length, first_mismatches, second_mismatches);
+    printf("probability error: max %.1f, mean %.3f, margin error: max "
+           "%.1f\n",
+           max_error, total_error / length, max_margin_error);
+
+    for (size_t j = 0; j < BENCH_THRESHOLDS_LENGTH; j++)
+        printf("threshold %.1f: %zu decision mismatches\n", thresholds[j],
+               decision_mismatches[j]);
+
+    /*
+     * The sums keep the compiler from dropping the computations.
+     */
+
+    u64 fixed_sum = 0;
+    size_t fixed_runs = 0;
+    u64 start_ns = get_time_ns();
+    u64 fixed_ns;
+
+    do {
+        for (size_t i = 0; i < length; i++) {
+            struct softmax_result result;
+
+            softmax_top2(logits[i], BENCH_LENGTH, &result);
+            fixed_sum += result.first + result.probability;
+        }
+
+        fixed_runs++;
+        fixed_ns = get_time_ns() - start_ns;
+    } while (fixed_ns < BENCH_MIN_NS);
+
+    double double_sum = 0;
+    size_t double_runs = 0;
+    u64 double_ns;
+
+    start_ns = get_time_ns();
+
+    do {
+        for (size_t i = 0; i < length; i++) {
+            struct softmax_result result;
+            double probability;
+            double margin;
+
+            softmax_double(logits[i], BENCH_LENGTH, &result, &probability,
+                           &margin);
+            double_sum += result.first + probability;
+        }
+
+        double_runs++;
+        double_ns = get_time_ns() - start_ns;
+    } while (double_ns < BENCH_MIN_NS);
+
+    printf("ns/vector: fixed %.1f, double %.1f (checksums %llu, %.0f)\n",
+           (double)fixed_ns / fixed_runs / length,
+           (double)double_ns / double_runs / length,
+           (unsigned long long)fixed_sum, double_sum);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,313 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "stft.h"
+
+#define STFT_BINS (STFT_LENGTH / 2 + 1)
+
+/*
+ * Single precision Hann window bits as generated by ./vivado/hann_window.mem.
+ * The values are not exactly reproducible by evaluating the window formula
+ * in single precision, so they are embedded verbatim.
+ */
+
+static const uint32_t hann_window_bits[STFT_LENGTH] = {
+    0x00000000, 0x391de800, 0x3a1de200, 0x3ab19300, 0x3b1dc980, 0x3b766e00,
+    0x3bb15500, 0x3bf13600, 0x3c1d6840, 0x3c470c60, 0x3c758100, 0x3c945f90,
+    0x3cb05f50, 0x3ccebb90, 0x3cef6f80, 0x3d093b10, 0x3d1be508, 0x3d2fb2c8,
+    0x3d44a140, 0x3d5aad38, 0x3d71d340, 0x3d8507ec, 0x3d91af98, 0x3d9edeb4,
+    0x3dac9338, 0x3dbacb0c, 0x3dc983f8, 0x3dd8bbb8, 0x3de86ff4, 0x3df89e3c,
+    0x3e04a20e, 0x3e0d2f7c, 0x3e15f61a, 0x3e1ef48c, 0x3e28296e, 0x3e319356,
+    0x3e3b30ce, 0x3e45005e, 0x3e4f0080, 0x3e592fac, 0x3e638c4e, 0x3e6e14ca,
+    0x3e78c788, 0x3e81d16d, 0x3e87528c, 0x3e8ce646, 0x3e928bc0, 0x3e98421c,
+    0x3e9e0875, 0x3ea3ddec, 0x3ea9c196, 0x3eafb28f, 0x3eb5afe8, 0x3ebbb8b6,
+    0x3ec1cc0e, 0x3ec7e8fc, 0x3ece0e91, 0x3ed43bd8, 0x3eda6fdf, 0x3ee0a9b3,
+    0x3ee6e859, 0x3eed2ae1, 0x3ef3704d, 0x3ef9b7ac, 0x3f000000, 0x3f03242b,
+    0x3f0647da, 0x3f096a90, 0x3f0c8bd4, 0x3f0fab27, 0x3f12c811, 0x3f15e215,
+    0x3f18f8b8, 0x3f1c0b83, 0x3f1f19fa, 0x3f2223a6, 0x3f25280c, 0x3f2826b9,
+    0x3f2b1f35, 0x3f2e110a, 0x3f30fbc6, 0x3f33def3, 0x3f36ba20, 0x3f398cde,
+    0x3f3c56bb, 0x3f3f174a, 0x3f41ce1e, 0x3f447ace, 0x3f471cee, 0x3f49b416,
+    0x3f4c3fe0, 0x3f4ebfea, 0x3f5133cc, 0x3f539b2c, 0x3f55f5a6, 0x3f5842de,
+    0x3f5a827a, 0x3f5cb422, 0x3f5ed77d, 0x3f60ec38, 0x3f62f202, 0x3f64e88a,
+    0x3f66cf82, 0x3f68a69e, 0x3f6a6d99, 0x3f6c242a, 0x3f6dca0d, 0x3f6f5f03,
+    0x3f70e2cc, 0x3f72552c, 0x3f73b5ec, 0x3f7504d4, 0x3f7641b0, 0x3f776c4f,
+    0x3f788484, 0x3f798a24, 0x3f7a7d06, 0x3f7b5d04, 0x3f7c29fc, 0x3f7ce3cf,
+    0x3f7d8a60, 0x3f7e1d94, 0x3f7e9d56, 0x3f7f0992, 0x3f7f6236, 0x3f7fa737,
+    0x3f7fd888, 0x3f7ff622, 0x3f800000, 0x3f7ff622, 0x3f7fd888, 0x3f7fa736,
+    0x3f7f6236, 0x3f7f0992, 0x3f7e9d56, 0x3f7e1d94, 0x3f7d8a5f, 0x3f7ce3ce,
+    0x3f7c29fc, 0x3f7b5d04, 0x3f7a7d05, 0x3f798a24, 0x3f788484, 0x3f776c4e,
+    0x3f7641b0, 0x3f7504d3, 0x3f73b5ec, 0x3f72552c, 0x3f70e2cc, 0x3f6f5f02,
+    0x3f6dca0c, 0x3f6c242a, 0x3f6a6d98, 0x3f68a69e, 0x3f66cf82, 0x3f64e889,
+    0x3f62f202, 0x3f60ec38, 0x3f5ed77c, 0x3f5cb420, 0x3f5a8279, 0x3f5842de,
+    0x3f55f5a4, 0x3f539b2c, 0x3f5133cd, 0x3f4ebfe8, 0x3f4c3fe0, 0x3f49b414,
+    0x3f471cec, 0x3f447acb, 0x3f41ce1f, 0x3f3f174a, 0x3f3c56ba, 0x3f398cdc,
+    0x3f36ba1f, 0x3f33def1, 0x3f30fbc3, 0x3f2e110b, 0x3f2b1f35, 0x3f2826b9,
+    0x3f25280c, 0x3f2223a3, 0x3f1f19f7, 0x3f1c0b80, 0x3f18f8b9, 0x3f15e214,
+    0x3f12c810, 0x3f0fab26, 0x3f0c8bd2, 0x3f096a8e, 0x3f0647d7, 0x3f03242b,
+    0x3f000000, 0x3ef9b7a9, 0x3ef3704a, 0x3eed2adc, 0x3ee6e854, 0x3ee0a9ac,
+    0x3eda6fe0, 0x3ed43bd7, 0x3ece0e8e, 0x3ec7e8f8, 0x3ec1cc09, 0x3ebbb8b2,
+    0x3eb5afe2, 0x3eafb28e, 0x3ea9c196, 0x3ea3ddea, 0x3e9e0873, 0x3e984218,
+    0x3e928bbc, 0x3e8ce640, 0x3e87528c, 0x3e81d16c, 0x3e78c784, 0x3e6e14c6,
+    0x3e638c46, 0x3e592fa2, 0x3e4f0082, 0x3e45005e, 0x3e3b30cc, 0x3e319350,
+    0x3e282968, 0x3e1ef484, 0x3e15f612, 0x3e0d2f7e, 0x3e04a20e, 0x3df89e3c,
+    0x3de86fec, 0x3dd8bbac, 0x3dc983ec, 0x3dbacafc, 0x3dac933c, 0x3d9edeb4,
+    0x3d91af94, 0x3d8507e4, 0x3d71d338, 0x3d5aad28, 0x3d44a130, 0x3d2fb2d0,
+    0x3d1be508, 0x3d093b10, 0x3cef6f70, 0x3ccebb70, 0x3cb05f40, 0x3c945f70,
+    0x3c758100, 0x3c470c40, 0x3c1d6820, 0x3bf13600, 0x3bb154c0, 0x3b766e00,
+    0x3b1dc900, 0x3ab19300, 0x3a1de200, 0x391de800,
+};
+
+static float bits_to_float(uint32_t bits) {
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+
+    return f;
+}
+
+static STFT_DT float_to_fixed(float f) {
+    float scaled = rintf(f * 256.0f);
+
+    if (scaled > INT16_MAX)
+        return INT16_MAX;
+
+    if (scaled < INT16_MIN)
+        return INT16_MIN;
+
+    return (STFT_DT)scaled;
+}
+
+static void store_line(const float *magnitude, STFT_DT *line) {
+    /*
+     * Real input produces conjugate symmetric spectrum, so the upper
+     * half of the line mirrors the lower half.
+     */
+
+    for (size_t k = 0; k < STFT_BINS; k++)
+        line[k] = float_to_fixed(magnitude[k]);
+
+    for (size_t k = STFT_BINS; k < STFT_LENGTH; k++)
+        line[k] = line[STFT_LENGTH - k];
+}
+
+void stft_init(struct stft *stft) {
+    memset(stft, 0, sizeof(struct stft));
+
+    for (size_t i = 0; i < STFT_LENGTH; i++) {
+        stft->window[i] = bits_to_float(hann_window_bits[i]);
+        stft->window_fixed[i] =
+            lrintf(stft->window[i] * (1 << STFT_WINDOW_FRACTION_BITS));
+    }
+
+    for (size_t k = 0; k < STFT_LENGTH / 2; k++) {
+        double phase = -2.0 * M_PI * k / STFT_LENGTH;
+
+        stft->twiddle_re[k] = (float)cos(phase);
+        stft->twiddle_im[k] = (float)sin(phase);
+    }
+}
+
+/*
+ * Stockham autosort radix-2 FFT of STFT_LENGTH / 2 complex points in
+ * every lane. Returns the buffer index holding the result in natural
+ * order.
+ */
+
+static size_t fft(struct stft *stft) {
+    size_t src = 0;
+
+    for (size_t n = STFT_LENGTH / 2, s = 1; n > 1; n /= 2, s *= 2) {
+        size_t m = n / 2;
+        size_t dst = src ^ 1;
+
+        for (size_t p = 0; p < m; p++) {
+            float wr = stft->twiddle_re[p * (STFT_LENGTH / n)];
+            float wi = stft->twiddle_im[p * (STFT_LENGTH / n)];
+
+            for (size_t q = 0; q < s; q++) {
+                const float *restrict a_re = stft->re[src][q + s * p];
+                const float *restrict a_im = stft->im[src][q + s * p];
+                const float *restrict b_re = stft->re[src][q + s * (p + m)];
+                const float *restrict b_im = stft->im[src][q + s * (p + m)];
+                float *restrict y0_re = stft->re[dst][q + s * 2 * p];
+                float *restrict y0_im = stft->im[dst][q + s * 2 * p];
+                float *restrict y1_re = stft->re[dst][q + s * (2 * p + 1)];
+                float *restrict y1_im = stft->im[dst][q + s * (2 * p + 1)];
+
+                for (size_t l = 0; l < STFT_BATCH; l++) {
+                    float d_re = a_re[l] - b_re[l];
+                    float d_im = a_im[l] - b_im[l];
+
+                    y0_re[l] = a_re[l] + b_re[l];
+                    y0_im[l] = a_im[l] + b_im[l];
+                    y1_re[l] = d_re * wr - d_im * wi;
+                    y1_im[l] = d_re * wi + d_im * wr;
+                }
+            }
+        }
+
+        src = dst;
+    }
+
+    return src;
+}
+
+/*
+ * Transforms the windows packed into the first FFT buffer and stores
+ * the first `lanes` lines.
+ */
+
+static void transform(struct stft *stft, size_t lanes, STFT_DT *lines) {
+    size_t result = fft(stft);
+
+    /*
+     * Split the half-length spectrum Z into the spectrum X of the real
+     * sequence: X[k] = E[k] + W^k * O[k], where E[k] = (Z[k] +
+     * conj(Z[N/2 - k])) / 2 and O[k] = (Z[k] - conj(Z[N/2 - k])) / 2i.
+     */
+
+    float magnitude[STFT_BATCH][STFT_BINS];
+
+    for (size_t k = 0; k < STFT_BINS; k++) {
+        size_t k0 = k % (STFT_LENGTH / 2);
+        size_t k1 = (STFT_LENGTH / 2 - k) % (STFT_LENGTH / 2);
+        float wr = k < STFT_LENGTH / 2 ? stft->twiddle_re[k] : -1.0f;
+        float wi = k < STFT_LENGTH / 2 ? stft->twiddle_im[k] : 0.0f;
+        const float *z0_re = stft->re[result][k0];
+        const float *z0_im = stft->im[result][k0];
+        const float *z1_re = stft->re[result][k1];
+        const float *z1_im = stft->im[result][k1];
+
+        for (size_t l = 0; l < STFT_BATCH; l++) {
+            float e_re = (z0_re[l] + z1_re[l]) * 0.5f;
+            float e_im = (z0_im[l] - z1_im[l]) * 0.5f;
+            float o_re = (z0_im[l] + z1_im[l]) * 0.5f;
+            float o_im = (z1_re[l] - z0_re[l]) * 0.5f;
+            float x_re = e_re + (o_re * wr - o_im * wi);
+            float x_im = e_im + (o_re * wi + o_im * wr);
+
+            /*
+             * Same order of operations as mul_1, mul_2, add_0 and
+             * sqrt in the STFT hierarchy.
+             */
+
+            float re_squared = x_re * x_re;
+            float im_squared = x_im * x_im;
+
+            magnitude[l][k] = sqrtf(re_squared + im_squared);
+        }
+    }
+
+    for (size_t l = 0; l < lanes; l++)
+        store_line(magnitude[l], lines + l * STFT_LENGTH);
+}
+
+void stft_compute(struct stft *stft, const float *samples, size_t count,
+                  STFT_DT *lines) {
+    for (size_t base = 0; base < count; base += STFT_BATCH) {
+        size_t lanes = count - base < STFT_BATCH ? count - base : STFT_BATCH;
+
+        /*
+         * Pack windowed even and odd samples as real and imaginary parts
+         * of the half-length complex sequence. Unused lanes are zeroed
+         * so that all loops run over the whole batch.
+         */
+
+        for (size_t n = 0; n < STFT_LENGTH / 2; n++) {
+            float w_even = stft->window[2 * n];
+            float w_odd = stft->window[2 * n + 1];
+
+            for (size_t l = 0; l < STFT_BATCH; l++) {
+                if (l < lanes) {
+                    const float *window = samples + (base + l) * STFT_HOP;
+
+                    stft->re[0][n][l] = window[2 * n] * w_even;
+                    stft->im[0][n][l] = window[2 * n + 1] * w_odd;
+                } else {
+                    stft->re[0][n][l] = 0;
+                    stft->im[0][n][l] = 0;
+                }
+            }
+        }
+
+        transform(stft, lanes, lines + base * STFT_LENGTH);
+    }
+}
+
+STFT_SAMPLE_DT stft_quantize_sample(float sample) {
+    float scaled = rintf(sample * (1 << STFT_SAMPLE_FRACTION_BITS));
+
+    if (scaled > INT16_MAX)
+        return INT16_MAX;
+
+    if (scaled < INT16_MIN)
+        return INT16_MIN;
+
+    return (STFT_SAMPLE_DT)scaled;
+}
+
+/*
+ * Rounds the product of a sample and the window to
+ * STFT_PRODUCT_FRACTION_BITS. The product takes at most 31 bits and the
+ * result at most 24, which single precision holds exactly.
+ */
+
+static float apply_window(STFT_SAMPLE_DT sample, int32_t window) {
+    const int shift = STFT_SAMPLE_FRACTION_BITS + STFT_WINDOW_FRACTION_BITS -
+                      STFT_PRODUCT_FRACTION_BITS;
+    int32_t product = (sample * window + (1 << (shift - 1))) >> shift;
+
+    return (float)product * (1.0f / (1 << STFT_PRODUCT_FRACTION_BITS));
+}
+
+void stft_compute_fixed(struct stft *stft, const STFT_SAMPLE_DT *samples,
+                        size_t count, STFT_DT *lines) {
+    for (size_t base = 0; base < count; base += STFT_BATCH) {
+        size_t lanes = count - base < STFT_BATCH ? count - base : STFT_BATCH;
+
+        for (size_t n = 0; n < STFT_LENGTH / 2; n++) {
+            int32_t w_even = stft->window_fixed[2 * n];
+            int32_t w_odd = stft->window_fixed[2 * n + 1];
+
+            for (size_t l = 0; l < STFT_BATCH; l++) {
+                if (l < lanes) {
+                    const STFT_SAMPLE_DT *window =
+                        samples + (base + l) * STFT_HOP;
+
+                    stft->re[0][n][l] = apply_window(window[2 * n], w_even);
+                    stft->im[0][n][l] = apply_window(window[2 * n + 1], w_odd);
+                } else {
+                    stft->re[0][n][l] = 0;
+                    stft->im[0][n][l] = 0;
+                }
+            }
+        }
+
+        transform(stft, lanes, lines + base * STFT_LENGTH);
+    }
+}
+
+void stft_compute_reference(const struct stft *stft, const float *samples,
+                            STFT_DT *line) {
+    float magnitude[STFT_BINS];
+
+    for (size_t k = 0; k < STFT_BINS; k++) {
+        double re = 0;
+        double im = 0;
+
+        for (size_t i = 0; i < STFT_LENGTH; i++) {
+            double phase = -2.0 * M_PI * ((k * i) % STFT_LENGTH) / STFT_LENGTH;
+            float windowed = samples[i] * stft->window[i];
+
+            re += windowed * cos(phase);
+            im += windowed * sin(phase);
+        }
+
+        magnitude[k] = (float)sqrt(re * re + im * im);
+    }
+
+    store_line(magnitude, line);
+}
@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Software STFT engine that reproduces the STFT pipeline of the
+ * Vivado design (see `create_hier_cell_stft` in ./vivado/speech_robot.tcl):
+ *
+ * - sliding window of two acquisition packets (256 samples) multiplied
+ *   by the Hann window from ./vivado/hann_window.mem in single precision;
+ * - 256-point floating point FFT in natural order;
+ * - magnitude computed as sqrt(re * re + im * im) in single precision;
+ * - conversion to FP16BP8 fixed point with rounding to nearest even
+ *   and saturation.
+ *
+ * Window, magnitude and conversion are bit-exact with the floating point
+ * IP as long as this file is compiled without contraction of floating
+ * point multiply and add (-ffp-contract=off, default for ISO C modes).
+ * The FFT itself is single precision radix-2 and may differ from the
+ * xfft core in the last bit of the float result, which is below the
+ * FP16BP8 resolution for all but the values close to rounding ties.
+ *
+ * With 16-bit acquisition samples (HAL_ACQ_FORMAT_INT16) the window is
+ * applied in fixed point instead. Samples have STFT_SAMPLE_FRACTION_BITS
+ * fraction bits, which holds the +/-2.25 range of the floating point
+ * acquisition with 8 steps per ADC step. The window is rounded to
+ * STFT_WINDOW_FRACTION_BITS, and the products are rounded to nearest
+ * with ties up to STFT_PRODUCT_FRACTION_BITS, so that they convert to
+ * single precision exactly. The FFT, magnitude and conversion to FP16BP8
+ * are the same as for floating point samples.
+ *
+ * The engine computes STFT_BATCH lines at once. The FFT data is stored
+ * lane-interleaved, so that every butterfly operates on STFT_BATCH
+ * windows in contiguous memory, which compilers turn into SIMD code.
+ */
+
+#define STFT_DT int16_t
+
+#define STFT_HOP 128
+#define STFT_LENGTH (2 * STFT_HOP)
+#define STFT_BATCH 16
+
+#define STFT_SAMPLE_DT int16_t
+#define STFT_SAMPLE_FRACTION_BITS 13
+#define STFT_WINDOW_FRACTION_BITS 15
+#define STFT_PRODUCT_FRACTION_BITS 21
+
+struct stft {
+    float window[STFT_LENGTH];
+    int32_t window_fixed[STFT_LENGTH];
+
+    float twiddle_re[STFT_LENGTH / 2];
+    float twiddle_im[STFT_LENGTH / 2];
+
+    float re[2][STFT_LENGTH / 2][STFT_BATCH];
+    float im[2][STFT_LENGTH / 2][STFT_BATCH];
+};
+
+void stft_init(struct stft *stft);
+
+/*
+ * Computes `count` STFT lines of STFT_LENGTH values each into `lines`.
+ * Line i is computed over samples[i * STFT_HOP, i * STFT_HOP + STFT_LENGTH).
+ */
+
+void stft_compute(struct stft *stft, const float *samples, size_t count,
+                  STFT_DT *lines);
+
+/*
+ * Rounds the sample to STFT_SAMPLE_FRACTION_BITS and saturates it.
+ */
+
+STFT_SAMPLE_DT stft_quantize_sample(float sample);
+
+/*
+ * Same as `stft_compute` for fixed point samples.
+ */
+
+void stft_compute_fixed(struct stft *stft, const STFT_SAMPLE_DT *samples,
+                        size_t count, STFT_DT *lines);
+
+/*
+ * Double precision DFT of the same pipeline for validation.
+ */
+
+void stft_compute_reference(const struct stft *stft, const float *samples,
+                            STFT_DT *line);
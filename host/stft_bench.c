@@ -0,0 +1,217 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hal.h"
+#include "stft.h"
+#include "wav.h"
+#include "xstatus.h"
+
+/*
+ * Measures throughput of the software STFT engine in lines per second
+ * and compares its output with the double precision reference.
+ *
+ * Usage: stft_bench [file.wav]
+ *
+ * Without the WAV file the input is a minute of synthetic audio made of
+ * a few tones and noise in the acquisition range of roughly +/-2.25.
+ *
+ * It also reports the bit accuracy of 16-bit acquisition samples
+ * (HAL_ACQ_FORMAT_INT16) against floating point ones. `window` compares
+ * the fixed and floating point windows on the same samples, those
+ * representable in 16 bits, and `int16` compares the whole fixed point
+ * path with the floating point one on the original samples, including
+ * the rounding of the samples to 16 bits.
+ */
+
+#define BENCH_DEFAULT_SECONDS 60
+#define BENCH_MIN_NS 1000000000
+
+static u64 get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+struct deviation {
+    size_t values;
+    size_t mismatches;
+    size_t total;
+    int max;
+};
+
+static void add_deviation(struct deviation *deviation, const STFT_DT *line,
+                          const STFT_DT *expected_line, size_t length) {
+    for (size_t k = 0; k < length; k++) {
+        int value = abs(line[k] - expected_line[k]);
+
+        if (value) {
+            deviation->mismatches++;
+            deviation->total += value;
+
+            if (value > deviation->max)
+                deviation->max = value;
+        }
+
+        deviation->values++;
+    }
+}
+
+static void print_deviation(const char *name,
+                            const struct deviation *deviation) {
+    printf("%s: values: %zu, mismatches: %zu (%.4f%%), "
+           "max deviation: %d LSB, mean deviation: %.6f LSB\n",
+           name, deviation->values, deviation->mismatches,
+           100.0 * deviation->mismatches / deviation->values, deviation->max,
+           (double)deviation->total / deviation->values);
+}
+
+static void generate_samples(float *samples, size_t length) {
+    u32 seed = 1;
+
+    for (size_t i = 0; i < length; i++) {
+        float t = (float)i / HAL_ACQ_SAMPLE_RATE;
+
+        seed = seed * 1664525 + 1013904223;
+
+        samples[i] = 0.8f * sinf(2.0f * (float)M_PI * 440.0f * t) +
+                     0.4f * sinf(2.0f * (float)M_PI * 1250.0f * t) +
+                     0.2f * sinf(2.0f * (float)M_PI * 3100.0f * t) +
+                     0.5f * ((float)(seed >> 8) / (1 << 24) - 0.5f);
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t length = BENCH_DEFAULT_SECONDS * HAL_ACQ_SAMPLE_RATE;
+    float *samples;
+
+    if (argc > 1) {
+        struct wav wav;
+
+        if (wav_read(argv[1], &wav) != XST_SUCCESS) {
+            fprintf(stderr, "failed to read %s\n", argv[1]);
+            return EXIT_FAILURE;
+        }
+
+        length = wav.length;
+        samples = malloc(length * sizeof(float));
+
+        for (size_t i = 0; i < length; i++)
+            samples[i] = wav.samples[i] / 32768.0f;
+
+        wav_free(&wav);
+    } else {
+        samples = malloc(length * sizeof(float));
+        generate_samples(samples, length);
+    }
+
+    if (length < STFT_LENGTH) {
+        fprintf(stderr, "audio is shorter than STFT window\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t count = (length - STFT_LENGTH) / STFT_HOP + 1;
+    STFT_DT *lines = malloc(count * STFT_LENGTH * sizeof(STFT_DT));
+    struct stft *stft = malloc(sizeof(struct stft));
+
+    stft_init(stft);
+
+    size_t runs = 0;
+    u64 start_ns = get_time_ns();
+    u64 elapsed_ns;
+
+    do {
+        stft_compute(stft, samples, count, lines);
+        runs++;
+        elapsed_ns = get_time_ns() - start_ns;
+    } while (elapsed_ns < BENCH_MIN_NS);
+
+    double lines_per_second = (double)runs * count * 1e9 / elapsed_ns;
+
+    printf("lines: %zu, runs: %zu, lines/s: %.0f, us/line: %.3f, "
+           "real-time factor: %.0f\n",
+           count, runs, lines_per_second, 1e6 / lines_per_second,
+           lines_per_second * STFT_HOP / HAL_ACQ_SAMPLE_RATE);
+
+    /*
+     * Single line calls are what the host emulation does for every
+     * acquisition packet.
+     */
+
+    STFT_DT line[STFT_LENGTH];
+    size_t single_count = count < 1000 ? count : 1000;
+
+    start_ns = get_time_ns();
+
+    for (size_t i = 0; i < single_count; i++)
+        stft_compute(stft, samples + i * STFT_HOP, 1, line);
+
+    elapsed_ns = get_time_ns() - start_ns;
+
+    printf("single line: us/line: %.3f\n", elapsed_ns / 1e3 / single_count);
+
+    struct deviation reference = {0};
+
+    for (size_t i = 0; i < count; i++) {
+        stft_compute_reference(stft, samples + i * STFT_HOP, line);
+        add_deviation(&reference, &lines[i * STFT_LENGTH], line,
+                      STFT_LENGTH);
+    }
+
+    print_deviation("reference", &reference);
+
+    STFT_SAMPLE_DT *fixed_samples = malloc(length * sizeof(STFT_SAMPLE_DT));
+    float *rounded_samples = malloc(length * sizeof(float));
+    STFT_DT *fixed_lines = malloc(count * STFT_LENGTH * sizeof(STFT_DT));
+    STFT_DT *rounded_lines = malloc(count * STFT_LENGTH * sizeof(STFT_DT));
+
+    for (size_t i = 0; i < length; i++) {
+        fixed_samples[i] = stft_quantize_sample(samples[i]);
+        rounded_samples[i] =
+            (float)fixed_samples[i] / (1 << STFT_SAMPLE_FRACTION_BITS);
+    }
+
+    runs = 0;
+    start_ns = get_time_ns();
+
+    do {
+        stft_compute_fixed(stft, fixed_samples, count, fixed_lines);
+        runs++;
+        elapsed_ns = get_time_ns() - start_ns;
+    } while (elapsed_ns < BENCH_MIN_NS);
+
+    lines_per_second = (double)runs * count * 1e9 / elapsed_ns;
+
+    printf("fixed point window: lines/s: %.0f, us/line: %.3f\n",
+           lines_per_second, 1e6 / lines_per_second);
+
+    stft_compute(stft, rounded_samples, count, rounded_lines);
+
+    struct deviation window = {0};
+    struct deviation transport = {0};
+
+    add_deviation(&window, fixed_lines, rounded_lines, count * STFT_LENGTH);
+    add_deviation(&transport, fixed_lines, lines, count * STFT_LENGTH);
+
+    print_deviation("window", &window);
+    print_deviation("int16", &transport);
+
+    printf("bytes/hop: acquisition %zu -> %zu, stft tx %zu -> %zu\n",
+           STFT_HOP * sizeof(float), STFT_HOP * sizeof(STFT_SAMPLE_DT),
+           STFT_LENGTH * sizeof(float), STFT_LENGTH * sizeof(STFT_SAMPLE_DT));
+
+    free(rounded_lines);
+    free(fixed_lines);
+    free(rounded_samples);
+    free(fixed_samples);
+    free(stft);
+    free(lines);
+    free(samples);
+
+    return EXIT_SUCCESS;
+}
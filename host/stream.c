@@ -0,0 +1,226 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdbool.h>
+
+#include "stream.h"
+#include "xstatus.h"
+
+/*
+ * Offsets of layer constants in the compiled constants in vectors.
+ *
+ * The normalization has the mean of every pixel followed by the scale
+ * of every pixel in the first lane. Convolution weights are preceded by
+ * the bias and stored as [kernel row][kernel column][input channel]
+ * [output channel] with input channels padded to the vector length.
+ * Dense weights are stored as [input][output] followed by the bias
+ * with outputs padded to the vector length. Dense inputs are pooled
+ * values in [row][column][channel] order.
+ */
+
+#define STREAM_NORMALIZATION_OFFSET 175
+#define STREAM_CONV1_OFFSET 2223
+#define STREAM_CONV2_OFFSET 2515
+#define STREAM_CONV3_OFFSET 4827
+#define STREAM_DENSE1_OFFSET 7135
+#define STREAM_DENSE2_OFFSET 93679
+#define STREAM_CONSTS_SIZE_VECTORS 93937
+
+#define STREAM_FRACTION_BITS 8
+
+#define PADDED(n)                                                              \
+    (((n) + TCU_VECTOR_LENGTH - 1) / TCU_VECTOR_LENGTH * TCU_VECTOR_LENGTH)
+
+static s32 saturate(s32 value) {
+    return value > INT16_MAX ? INT16_MAX
+                             : (value < INT16_MIN ? INT16_MIN : value);
+}
+
+static s32 multiply(s32 a, s32 b) {
+    return (a * b + (1 << (STREAM_FRACTION_BITS - 1))) >> STREAM_FRACTION_BITS;
+}
+
+static const TCU_DT *get_consts(const struct stream *stream, size_t offset) {
+    return stream->consts + offset * TCU_VECTOR_LENGTH;
+}
+
+/*
+ * Computes one output row of a 3x3 convolution with ReLU from the
+ * three input rows. Rows are [column][channel].
+ */
+
+static void conv_row(const struct stream *stream, size_t offset,
+                     const TCU_DT *const *rows, size_t width,
+                     size_t in_channels, size_t out_channels, TCU_DT *out) {
+    const TCU_DT *bias = get_consts(stream, offset);
+    const TCU_DT *weights =
+        get_consts(stream, offset + out_channels / TCU_VECTOR_LENGTH);
+    size_t padded_in_channels = PADDED(in_channels);
+
+    for (size_t x = 0; x < width - STREAM_KERNEL_SIZE + 1; x++) {
+        s32 sums[out_channels];
+
+        for (size_t o = 0; o < out_channels; o++)
+            sums[o] = bias[o];
+
+        for (size_t ky = 0; ky < STREAM_KERNEL_SIZE; ky++)
+            for (size_t kx = 0; kx < STREAM_KERNEL_SIZE; kx++) {
+                const TCU_DT *in = rows[ky] + (x + kx) * in_channels;
+                const TCU_DT *w =
+                    weights + (ky * STREAM_KERNEL_SIZE + kx) *
+                                  padded_in_channels * out_channels;
+
+                for (size_t i = 0; i < in_channels; i++, w += out_channels)
+                    for (size_t o = 0; o < out_channels; o++)
+                        sums[o] = saturate(sums[o] + multiply(in[i], w[o]));
+            }
+
+        for (size_t o = 0; o < out_channels; o++)
+            out[x * out_channels + o] = sums[o] > 0 ? sums[o] : 0;
+    }
+}
+
+static void dense(const struct stream *stream, size_t offset,
+                  const TCU_DT *in, size_t in_length, size_t out_length,
+                  bool relu, TCU_DT *out) {
+    size_t padded_out_length = PADDED(out_length);
+    const TCU_DT *w = get_consts(stream, offset);
+    const TCU_DT *bias = w + in_length * padded_out_length;
+    s32 sums[padded_out_length];
+
+    for (size_t o = 0; o < padded_out_length; o++)
+        sums[o] = bias[o];
+
+    for (size_t i = 0; i < in_length; i++, w += padded_out_length)
+        for (size_t o = 0; o < padded_out_length; o++)
+            sums[o] = saturate(sums[o] + multiply(in[i], w[o]));
+
+    for (size_t o = 0; o < out_length; o++)
+        out[o] = relu && sums[o] < 0 ? 0 : sums[o];
+}
+
+int stream_init(struct stream *stream, const struct program *program) {
+    if (program->consts_size < STREAM_CONSTS_SIZE_VECTORS * TCU_VECTOR_SIZE)
+        return XST_FAILURE;
+
+    stream->consts = (const TCU_DT *)program->consts_ptr;
+
+    /*
+     * Normalization statistics are computed over the whole spectrogram,
+     * so they are the same for every pixel. This is what allows to
+     * normalize rows regardless of their position in the window.
+     */
+
+    const TCU_DT *normalization =
+        get_consts(stream, STREAM_NORMALIZATION_OFFSET);
+    size_t pixels = STREAM_INPUT_HEIGHT * STREAM_INPUT_WIDTH;
+
+    stream->mean = normalization[0];
+    stream->scale = normalization[pixels * TCU_VECTOR_LENGTH];
+
+    for (size_t i = 0; i < pixels; i++)
+        if (normalization[i * TCU_VECTOR_LENGTH] != stream->mean ||
+            normalization[(pixels + i) * TCU_VECTOR_LENGTH] != stream->scale)
+            return XST_FAILURE;
+
+    stream_reset(stream);
+
+    return XST_SUCCESS;
+}
+
+void stream_reset(struct stream *stream) { stream->rows = 0; }
+
+void stream_push(struct stream *stream, const TCU_DT *row) {
+    size_t i = stream->rows++;
+    TCU_DT *input = stream->input[i % STREAM_KERNEL_SIZE];
+
+    for (size_t x = 0; x < STREAM_INPUT_WIDTH; x++)
+        input[x] =
+            saturate(multiply(saturate(row[x] - stream->mean), stream->scale));
+
+    /*
+     * Each convolution row can be computed once the last of its three
+     * input rows is available, which is two rows behind its input.
+     */
+
+    const TCU_DT *rows[STREAM_KERNEL_SIZE];
+
+    if (i < STREAM_KERNEL_SIZE - 1)
+        return;
+
+    i -= STREAM_KERNEL_SIZE - 1;
+
+    for (size_t k = 0; k < STREAM_KERNEL_SIZE; k++)
+        rows[k] = stream->input[(i + k) % STREAM_KERNEL_SIZE];
+
+    conv_row(stream, STREAM_CONV1_OFFSET, rows, STREAM_INPUT_WIDTH, 1,
+             STREAM_CONV1_CHANNELS,
+             &stream->conv1[i % STREAM_KERNEL_SIZE][0][0]);
+
+    if (i < STREAM_KERNEL_SIZE - 1)
+        return;
+
+    i -= STREAM_KERNEL_SIZE - 1;
+
+    for (size_t k = 0; k < STREAM_KERNEL_SIZE; k++)
+        rows[k] = &stream->conv1[(i + k) % STREAM_KERNEL_SIZE][0][0];
+
+    conv_row(stream, STREAM_CONV2_OFFSET, rows, STREAM_CONV1_WIDTH,
+             STREAM_CONV1_CHANNELS, STREAM_CONV2_CHANNELS,
+             &stream->conv2[i % STREAM_KERNEL_SIZE][0][0]);
+
+    if (i < STREAM_KERNEL_SIZE - 1)
+        return;
+
+    i -= STREAM_KERNEL_SIZE - 1;
+
+    for (size_t k = 0; k < STREAM_KERNEL_SIZE; k++)
+        rows[k] = &stream->conv2[(i + k) % STREAM_KERNEL_SIZE][0][0];
+
+    conv_row(stream, STREAM_CONV3_OFFSET, rows, STREAM_CONV2_WIDTH,
+             STREAM_CONV2_CHANNELS, STREAM_CONV3_CHANNELS,
+             &stream->conv3[i % STREAM_CONV3_HEIGHT][0][0]);
+}
+
+int stream_infer(struct stream *stream, TCU_DT *logits) {
+    if (stream->rows < STREAM_INPUT_HEIGHT)
+        return XST_FAILURE;
+
+    /*
+     * Pooling pairs depend on where the window starts, so the pooling
+     * is done for every window.
+     */
+
+    size_t first = stream->rows - STREAM_INPUT_HEIGHT;
+
+    for (size_t y = 0; y < STREAM_POOL_HEIGHT; y++) {
+        const TCU_DT(*top)[STREAM_CONV3_CHANNELS] =
+            stream->conv3[(first + 2 * y) % STREAM_CONV3_HEIGHT];
+        const TCU_DT(*bottom)[STREAM_CONV3_CHANNELS] =
+            stream->conv3[(first + 2 * y + 1) % STREAM_CONV3_HEIGHT];
+
+        for (size_t x = 0; x < STREAM_POOL_WIDTH; x++)
+            for (size_t c = 0; c < STREAM_CONV3_CHANNELS; c++) {
+                TCU_DT max = top[2 * x][c];
+
+                if (top[2 * x + 1][c] > max)
+                    max = top[2 * x + 1][c];
+
+                if (bottom[2 * x][c] > max)
+                    max = bottom[2 * x][c];
+
+                if (bottom[2 * x + 1][c] > max)
+                    max = bottom[2 * x + 1][c];
+
+                stream->pool[y][x][c] = max;
+            }
+    }
+
+    dense(stream, STREAM_DENSE1_OFFSET, &stream->pool[0][0][0],
+          sizeof(stream->pool) / sizeof(TCU_DT), STREAM_DENSE_LENGTH, true,
+          stream->dense);
+    dense(stream, STREAM_DENSE2_OFFSET, stream->dense, STREAM_DENSE_LENGTH,
+          STREAM_OUTPUT_LENGTH, false, logits);
+
+    return XST_SUCCESS;
+}
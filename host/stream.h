@@ -0,0 +1,98 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "program.h"
+#include "tcu.h"
+
+/*
+ * Streaming inference of the speech commands model for windows that
+ * overlap by all but a few resized rows.
+ *
+ * The layers past the resize are normalization, three 3x3 convolutions
+ * with ReLU, 2x2 max pooling and two dense layers. The normalization
+ * and the convolutions are translation invariant along rows, so each
+ * of their output rows only depends on the last three rows of their
+ * input. We keep the rows of every layer in small rings and compute
+ * them once as resized rows are pushed. Only the pooling and the dense
+ * layers are computed for every window over the last
+ * STREAM_CONV3_HEIGHT rows of the third convolution.
+ *
+ * The weights are taken from the compiled constants (.tdata) and the
+ * arithmetic is FP16BP8 as in the TCU, so the logits are the same as
+ * produced by the compiled program.
+ */
+
+#define STREAM_INPUT_HEIGHT 32
+#define STREAM_INPUT_WIDTH 32
+#define STREAM_OUTPUT_LENGTH 12
+
+#define STREAM_KERNEL_SIZE 3
+
+#define STREAM_CONV1_CHANNELS 32
+#define STREAM_CONV2_CHANNELS 64
+#define STREAM_CONV3_CHANNELS 32
+
+#define STREAM_CONV1_WIDTH (STREAM_INPUT_WIDTH - STREAM_KERNEL_SIZE + 1)
+#define STREAM_CONV2_WIDTH (STREAM_CONV1_WIDTH - STREAM_KERNEL_SIZE + 1)
+#define STREAM_CONV3_WIDTH (STREAM_CONV2_WIDTH - STREAM_KERNEL_SIZE + 1)
+#define STREAM_CONV3_HEIGHT (STREAM_INPUT_HEIGHT - 3 * (STREAM_KERNEL_SIZE - 1))
+
+#define STREAM_POOL_HEIGHT (STREAM_CONV3_HEIGHT / 2)
+#define STREAM_POOL_WIDTH (STREAM_CONV3_WIDTH / 2)
+
+#define STREAM_DENSE_LENGTH 128
+
+struct stream {
+    const TCU_DT *consts;
+
+    TCU_DT mean;
+    TCU_DT scale;
+
+    /*
+     * Number of rows pushed since the reset. Row i of a layer is kept at
+     * i modulo the height of its ring.
+     */
+
+    size_t rows;
+
+    TCU_DT input[STREAM_KERNEL_SIZE][STREAM_INPUT_WIDTH];
+    TCU_DT conv1[STREAM_KERNEL_SIZE][STREAM_CONV1_WIDTH]
+                [STREAM_CONV1_CHANNELS];
+    TCU_DT conv2[STREAM_KERNEL_SIZE][STREAM_CONV2_WIDTH]
+                [STREAM_CONV2_CHANNELS];
+    TCU_DT conv3[STREAM_CONV3_HEIGHT][STREAM_CONV3_WIDTH]
+                [STREAM_CONV3_CHANNELS];
+
+    TCU_DT pool[STREAM_POOL_HEIGHT][STREAM_POOL_WIDTH][STREAM_CONV3_CHANNELS];
+    TCU_DT dense[STREAM_DENSE_LENGTH];
+};
+
+/*
+ * Initializes the stream with the constants of the program. Returns
+ * XST_FAILURE when the constants do not have the expected size or the
+ * normalization is not the same for all pixels.
+ */
+
+int stream_init(struct stream *stream, const struct program *program);
+
+void stream_reset(struct stream *stream);
+
+/*
+ * Pushes the next resized row of STREAM_INPUT_WIDTH values and computes
+ * the rows of the convolutions that depend on it.
+ */
+
+void stream_push(struct stream *stream, const TCU_DT *row);
+
+/*
+ * Writes STREAM_OUTPUT_LENGTH logits for the window of the last
+ * STREAM_INPUT_HEIGHT pushed rows. Returns XST_FAILURE when fewer rows
+ * have been pushed since the reset.
+ */
+
+int stream_infer(struct stream *stream, TCU_DT *logits);
@@ -0,0 +1,264 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pipeline.h"
+#include "program.h"
+#include "resize.h"
+#include "stft.h"
+#include "stream.h"
+#include "wav.h"
+#include "xstatus.h"
+
+/*
+ * Compares the inference of overlapping windows done by the compiled
+ * program in the TCU emulator and by the streaming engine in stream.c,
+ * both for complete windows and for windows that only push the rows
+ * added since the previous one.
+ *
+ * Usage: stream_bench [-w windows] [-p model.tprog] [-c model.tdata]
+ *                     file.wav...
+ *
+ * Files are concatenated into one recording, which is resized as the
+ * firmware does: every second of STFT lines gives RESIZE_HEIGHT rows.
+ * A window is inferred every RESIZE_HEIGHT / windows rows as with
+ * MODEL_INPUT_WINDOW_NUMBER in speech_robot.c. Logits of the streaming
+ * engine are checked to be the same as of the program.
+ */
+
+#define BENCH_DEFAULT_PROG "model/speech_commands_onnx_speech_robot.tprog"
+#define BENCH_DEFAULT_CONSTS "model/speech_commands_onnx_speech_robot.tdata"
+
+#define BENCH_DRAM0_SIZE (TENSIL_ARCHITECTURE_DRAM0_DEPTH * TCU_VECTOR_SIZE)
+
+struct bench {
+    struct program program;
+    struct stft stft;
+    struct resize resize;
+    struct tcu tcu;
+    struct stream stream;
+
+    float *samples;
+    STFT_DT (*lines)[STFT_LENGTH];
+    TCU_DT (*rows)[RESIZE_WIDTH];
+    size_t rows_length;
+
+    u8 *dram0_ptr;
+};
+
+static struct bench bench;
+
+static u64 get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int read_samples(int argc, char **argv) {
+    size_t length = 0;
+
+    for (int i = 0; i < argc; i++) {
+        struct wav wav;
+
+        if (wav_read(argv[i], &wav) != XST_SUCCESS) {
+            fprintf(stderr, "failed to read %s\n", argv[i]);
+            return XST_FAILURE;
+        }
+
+        bench.samples =
+            realloc(bench.samples, (length + wav.length) * sizeof(float));
+
+        for (size_t j = 0; j < wav.length; j++)
+            bench.samples[length + j] = wav.samples[j] / 32768.0f;
+
+        length += wav.length;
+        wav_free(&wav);
+    }
+
+    /*
+     * Whole seconds of STFT lines, so that the last lines have samples.
+     */
+
+    size_t seconds = length < PIPELINE_CLIP_LENGTH
+                         ? 0
+                         : (length - STFT_LENGTH) / STFT_HOP /
+                               PIPELINE_INPUT_HEIGHT;
+
+    if (!seconds) {
+        fprintf(stderr, "recording is shorter than one second\n");
+        return XST_FAILURE;
+    }
+
+    size_t lines_length = seconds * PIPELINE_INPUT_HEIGHT;
+
+    bench.lines = malloc(lines_length * sizeof(*bench.lines));
+    bench.rows_length = seconds * RESIZE_HEIGHT;
+    bench.rows = malloc(bench.rows_length * sizeof(*bench.rows));
+
+    stft_compute(&bench.stft, bench.samples, lines_length, &bench.lines[0][0]);
+
+    for (size_t i = 0; i < bench.rows_length; i++) {
+        const struct resize_tap *tap = &bench.resize.rows[i % RESIZE_HEIGHT];
+        size_t first_line = (i / RESIZE_HEIGHT) * PIPELINE_INPUT_HEIGHT;
+
+        resize_row(&bench.resize, i % RESIZE_HEIGHT,
+                   &bench.lines[first_line + tap->first][STFT_LENGTH - 1],
+                   &bench.lines[first_line + tap->second][STFT_LENGTH - 1],
+                   -1, bench.rows[i], 1);
+    }
+
+    return XST_SUCCESS;
+}
+
+static int infer_program(size_t first_row, TCU_DT *logits) {
+    TCU_DT(*input)[TCU_VECTOR_LENGTH] =
+        (TCU_DT(*)[TCU_VECTOR_LENGTH])bench.dram0_ptr +
+        PIPELINE_RESIZED_OFFSET_VECTORS;
+
+    for (size_t i = 0; i < RESIZE_HEIGHT; i++)
+        for (size_t j = 0; j < RESIZE_WIDTH; j++)
+            input[i * RESIZE_WIDTH + j][0] = bench.rows[first_row + i][j];
+
+    tcu_set_dram(&bench.tcu, bench.dram0_ptr, bench.program.consts_ptr);
+
+    int status = tcu_execute(&bench.tcu,
+                             bench.program.prog_ptr + PIPELINE_PROG_START,
+                             bench.program.prog_size - PIPELINE_PROG_START);
+
+    memcpy(logits, bench.dram0_ptr, STREAM_OUTPUT_LENGTH * sizeof(TCU_DT));
+
+    return status;
+}
+
+static int infer_full(size_t first_row, TCU_DT *logits) {
+    stream_reset(&bench.stream);
+
+    for (size_t i = 0; i < RESIZE_HEIGHT; i++)
+        stream_push(&bench.stream, bench.rows[first_row + i]);
+
+    return stream_infer(&bench.stream, logits);
+}
+
+static int infer_incremental(size_t first_row, TCU_DT *logits) {
+
+    /*
+     * Pushes the rows added since the previous window. The first window
+     * pushes all of its rows.
+     */
+
+    if (!first_row)
+        stream_reset(&bench.stream);
+
+    while (bench.stream.rows < first_row + RESIZE_HEIGHT)
+        stream_push(&bench.stream, bench.rows[bench.stream.rows]);
+
+    return stream_infer(&bench.stream, logits);
+}
+
+static const char *names[] = {"program", "full", "incremental"};
+static int (*infers[])(size_t first_row, TCU_DT *logits) = {
+    infer_program, infer_full, infer_incremental};
+
+#define BENCH_METHODS (sizeof(infers) / sizeof(infers[0]))
+
+int main(int argc, char **argv) {
+    const char *prog_path = BENCH_DEFAULT_PROG;
+    const char *consts_path = BENCH_DEFAULT_CONSTS;
+    size_t windows = 4;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:p:c:")) != -1) {
+        switch (opt) {
+        case 'w':
+            windows = atol(optarg);
+            break;
+        case 'p':
+            prog_path = optarg;
+            break;
+        case 'c':
+            consts_path = optarg;
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-w windows] [-p model.tprog] "
+                    "[-c model.tdata] file.wav...\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!windows || RESIZE_HEIGHT % windows) {
+        fprintf(stderr, "windows must divide %d\n", RESIZE_HEIGHT);
+        return EXIT_FAILURE;
+    }
+
+    if (program_read(&bench.program, prog_path, consts_path) != XST_SUCCESS) {
+        fprintf(stderr, "failed to read %s or %s\n", prog_path, consts_path);
+        return EXIT_FAILURE;
+    }
+
+    if (bench.program.prog_size <= PIPELINE_PROG_START ||
+        stream_init(&bench.stream, &bench.program) != XST_SUCCESS) {
+        fprintf(stderr, "unexpected program\n");
+        return EXIT_FAILURE;
+    }
+
+    stft_init(&bench.stft);
+    resize_init(&bench.resize, PIPELINE_INPUT_HEIGHT, PIPELINE_INPUT_WIDTH);
+    tcu_init(&bench.tcu, NULL);
+
+    if (read_samples(argc - optind, argv + optind) != XST_SUCCESS)
+        return EXIT_FAILURE;
+
+    bench.dram0_ptr = aligned_alloc(TCU_VECTOR_SIZE, BENCH_DRAM0_SIZE);
+    memset(bench.dram0_ptr, 0, BENCH_DRAM0_SIZE);
+
+    size_t step = RESIZE_HEIGHT / windows;
+    size_t windows_length = (bench.rows_length - RESIZE_HEIGHT) / step + 1;
+    TCU_DT(*logits)[BENCH_METHODS][STREAM_OUTPUT_LENGTH] =
+        malloc(windows_length * sizeof(*logits));
+    u64 elapsed_ns[BENCH_METHODS];
+
+    for (size_t i = 0; i < BENCH_METHODS; i++) {
+        u64 start_ns = get_time_ns();
+
+        for (size_t j = 0; j < windows_length; j++)
+            if (infers[i](j * step, logits[j][i]) != XST_SUCCESS) {
+                fprintf(stderr, "%s inference failed\n", names[i]);
+                return EXIT_FAILURE;
+            }
+
+        elapsed_ns[i] = get_time_ns() - start_ns;
+    }
+
+    printf("%zu windows every %zu rows\n\n", windows_length, step);
+    printf("%12s %10s %8s %10s\n", "method", "ms/window", "speedup",
+           "mismatches");
+
+    for (size_t i = 0; i < BENCH_METHODS; i++) {
+        size_t mismatches = 0;
+
+        for (size_t j = 0; j < windows_length; j++)
+            if (memcmp(logits[j][i], logits[j][0], sizeof(logits[j][i])))
+                mismatches++;
+
+        printf("%12s %10.3f %7.1fx %10zu\n", names[i],
+               elapsed_ns[i] / 1e6 / windows_length,
+               (double)elapsed_ns[0] / elapsed_ns[i], mismatches);
+    }
+
+    free(logits);
+    free(bench.dram0_ptr);
+    free(bench.rows);
+    free(bench.lines);
+    free(bench.samples);
+    program_free(&bench.program);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,527 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "tcu.h"
+#include "xstatus.h"
+
+/*
+ * Instruction layout derived from the architecture. Each operand is
+ * rounded up to the whole number of bytes and the stride occupies the
+ * bits above the address. The header in the top byte holds the opcode
+ * and the flags.
+ */
+
+#define TCU_OPERAND0_SIZE_BITS 16
+#define TCU_OPERAND1_SIZE_BITS 24
+#define TCU_OPERAND2_SIZE_BITS 16
+#define TCU_LOCAL_ADDRESS_SIZE_BITS 13
+#define TCU_DRAM_ADDRESS_SIZE_BITS 17
+#define TCU_STRIDE_SIZE_BITS 3
+
+#define TCU_OPCODE_NOOP 0x0
+#define TCU_OPCODE_MATMUL 0x1
+#define TCU_OPCODE_DATA_MOVE 0x2
+#define TCU_OPCODE_LOAD_WEIGHT 0x3
+#define TCU_OPCODE_SIMD 0x4
+#define TCU_OPCODE_CONFIG 0xf
+
+#define TCU_MATMUL_FLAG_ACCUMULATE 0x1
+#define TCU_MATMUL_FLAG_ZEROES 0x2
+
+#define TCU_LOAD_WEIGHT_FLAG_ZEROES 0x1
+
+#define TCU_DATA_MOVE_FLAG_DRAM0_TO_LOCAL 0x0
+#define TCU_DATA_MOVE_FLAG_LOCAL_TO_DRAM0 0x1
+#define TCU_DATA_MOVE_FLAG_DRAM1_TO_LOCAL 0x2
+#define TCU_DATA_MOVE_FLAG_LOCAL_TO_DRAM1 0x3
+#define TCU_DATA_MOVE_FLAG_ACC_TO_LOCAL 0xc
+#define TCU_DATA_MOVE_FLAG_LOCAL_TO_ACC 0xd
+#define TCU_DATA_MOVE_FLAG_LOCAL_TO_ACC_WITH_ACC 0xf
+
+#define TCU_SIMD_FLAG_READ 0x1
+#define TCU_SIMD_FLAG_WRITE 0x2
+#define TCU_SIMD_FLAG_ACCUMULATE 0x4
+
+#define TCU_SIMD_OP_NOOP 0x0
+#define TCU_SIMD_OP_ZERO 0x1
+#define TCU_SIMD_OP_MOVE 0x2
+#define TCU_SIMD_OP_NOT 0x3
+#define TCU_SIMD_OP_AND 0x4
+#define TCU_SIMD_OP_OR 0x5
+#define TCU_SIMD_OP_INCREMENT 0x6
+#define TCU_SIMD_OP_DECREMENT 0x7
+#define TCU_SIMD_OP_ADD 0x8
+#define TCU_SIMD_OP_SUBTRACT 0x9
+#define TCU_SIMD_OP_MULTIPLY 0xa
+#define TCU_SIMD_OP_ABS 0xb
+#define TCU_SIMD_OP_GREATER 0xc
+#define TCU_SIMD_OP_GREATER_EQUAL 0xd
+#define TCU_SIMD_OP_MIN 0xe
+#define TCU_SIMD_OP_MAX 0xf
+
+#define TCU_CONFIG_REGISTER_DRAM0_OFFSET 0x0
+#define TCU_CONFIG_REGISTER_DRAM1_OFFSET 0x4
+
+#define TCU_FRACTION_BITS 8
+#define TCU_ONE (1 << TCU_FRACTION_BITS)
+
+static u64 get_bits(u64 value, size_t offset, size_t size) {
+    return (value >> offset) & ((1ULL << size) - 1);
+}
+
+static int32_t saturate(int32_t value) {
+    return value > INT16_MAX ? INT16_MAX
+                             : (value < INT16_MIN ? INT16_MIN : value);
+}
+
+static int32_t multiply(int32_t left, int32_t right) {
+    return (left * right + (TCU_ONE / 2)) >> TCU_FRACTION_BITS;
+}
+
+/*
+ * Vector kernels. Loops over the vector lanes have constant trip count
+ * and no dependencies between lanes, so that compilers emit SIMD code.
+ */
+
+static void vector_add(TCU_DT *dst, const TCU_DT *src) {
+    for (size_t j = 0; j < TCU_VECTOR_LENGTH; j++)
+        dst[j] = saturate(dst[j] + src[j]);
+}
+
+static void vector_matmul(const TCU_DT (*weights)[TCU_VECTOR_LENGTH],
+                          const TCU_DT *input, TCU_DT *output,
+                          bool accumulate) {
+    int32_t sum[TCU_VECTOR_LENGTH];
+
+    for (size_t j = 0; j < TCU_VECTOR_LENGTH; j++)
+        sum[j] = weights[0][j];
+
+    for (size_t i = 0; i < TCU_VECTOR_LENGTH; i++) {
+        const TCU_DT *row = weights[i + 1];
+        int32_t x = input[i];
+
+        for (size_t j = 0; j < TCU_VECTOR_LENGTH; j++)
+            sum[j] = saturate(sum[j] + multiply(x, row[j]));
+    }
+
+    for (size_t j = 0; j < TCU_VECTOR_LENGTH; j++)
+        output[j] = accumulate ? saturate(output[j] + sum[j]) : sum[j];
+}
+
+static void vector_simd(u8 op, const TCU_DT *left, const TCU_DT *right,
+                        TCU_DT *output) {
+    for (size_t j = 0; j < TCU_VECTOR_LENGTH; j++) {
+        int32_t l = left[j];
+        int32_t r = right[j];
+        int32_t result;
+
+        switch (op) {
+        case TCU_SIMD_OP_ZERO:
+            result = 0;
+            break;
+
+        case TCU_SIMD_OP_MOVE:
+            result = l;
+            break;
+
+        case TCU_SIMD_OP_NOT:
+            result = !l;
+            break;
+
+        case TCU_SIMD_OP_AND:
+            result = l && r;
+            break;
+
+        case TCU_SIMD_OP_OR:
+            result = l || r;
+            break;
+
+        case TCU_SIMD_OP_INCREMENT:
+            result = saturate(l + TCU_ONE);
+            break;
+
+        case TCU_SIMD_OP_DECREMENT:
+            result = saturate(l - TCU_ONE);
+            break;
+
+        case TCU_SIMD_OP_ADD:
+            result = saturate(l + r);
+            break;
+
+        case TCU_SIMD_OP_SUBTRACT:
+            result = saturate(l - r);
+            break;
+
+        case TCU_SIMD_OP_MULTIPLY:
+            result = saturate(multiply(l, r));
+            break;
+
+        case TCU_SIMD_OP_ABS:
+            result = saturate(l < 0 ? -l : l);
+            break;
+
+        case TCU_SIMD_OP_GREATER:
+            result = l > r;
+            break;
+
+        case TCU_SIMD_OP_GREATER_EQUAL:
+            result = l >= r;
+            break;
+
+        case TCU_SIMD_OP_MIN:
+            result = l < r ? l : r;
+            break;
+
+        case TCU_SIMD_OP_MAX:
+            result = l > r ? l : r;
+            break;
+
+        default:
+            result = 0;
+            break;
+        }
+
+        output[j] = result;
+    }
+}
+
+/*
+ * Address operands are split into the address and the stride, which is
+ * the power of two distance between consecutive vectors.
+ */
+
+static bool get_range(u64 operand, size_t address_size_bits, size_t depth,
+                      size_t size, size_t *address, size_t *stride) {
+    *address = get_bits(operand, 0, address_size_bits);
+    *stride = 1 << get_bits(operand, address_size_bits, TCU_STRIDE_SIZE_BITS);
+
+    return *address + (size - 1) * *stride < depth;
+}
+
+static int matmul(struct tcu *tcu, u8 flags, u64 operand0, u64 operand1,
+                  u64 operand2) {
+    size_t size = operand2 + 1;
+    size_t local_address, local_stride, acc_address, acc_stride;
+
+    if (!get_range(operand0, TCU_LOCAL_ADDRESS_SIZE_BITS,
+                   TENSIL_ARCHITECTURE_LOCAL_DEPTH, size, &local_address,
+                   &local_stride) ||
+        !get_range(operand1, TCU_DRAM_ADDRESS_SIZE_BITS,
+                   TENSIL_ARCHITECTURE_ACCUMULATOR_DEPTH, size, &acc_address,
+                   &acc_stride))
+        return XST_FAILURE;
+
+    static const TCU_DT zeroes[TCU_VECTOR_LENGTH];
+
+    for (size_t i = 0; i < size; i++)
+        vector_matmul((const TCU_DT(*)[TCU_VECTOR_LENGTH])tcu->weights,
+                      flags & TCU_MATMUL_FLAG_ZEROES
+                          ? zeroes
+                          : tcu->local[local_address + i * local_stride],
+                      tcu->accumulators[acc_address + i * acc_stride],
+                      flags & TCU_MATMUL_FLAG_ACCUMULATE);
+
+    return XST_SUCCESS;
+}
+
+static int data_move(struct tcu *tcu, u8 flags, u64 operand0, u64 operand1,
+                     u64 operand2) {
+    size_t size = operand2 + 1;
+    size_t local_address, local_stride, address, stride;
+
+    if (!get_range(operand0, TCU_LOCAL_ADDRESS_SIZE_BITS,
+                   TENSIL_ARCHITECTURE_LOCAL_DEPTH, size, &local_address,
+                   &local_stride))
+        return XST_FAILURE;
+
+    TCU_DT(*vectors)[TCU_VECTOR_LENGTH];
+    size_t depth;
+
+    switch (flags) {
+    case TCU_DATA_MOVE_FLAG_DRAM0_TO_LOCAL:
+    case TCU_DATA_MOVE_FLAG_LOCAL_TO_DRAM0:
+        vectors = tcu->dram0_ptr;
+        depth = TENSIL_ARCHITECTURE_DRAM0_DEPTH;
+        break;
+
+    case TCU_DATA_MOVE_FLAG_DRAM1_TO_LOCAL:
+    case TCU_DATA_MOVE_FLAG_LOCAL_TO_DRAM1:
+        vectors = tcu->dram1_ptr;
+        depth = TENSIL_ARCHITECTURE_DRAM1_DEPTH;
+        break;
+
+    case TCU_DATA_MOVE_FLAG_ACC_TO_LOCAL:
+    case TCU_DATA_MOVE_FLAG_LOCAL_TO_ACC:
+    case TCU_DATA_MOVE_FLAG_LOCAL_TO_ACC_WITH_ACC:
+        vectors = tcu->accumulators;
+        depth = TENSIL_ARCHITECTURE_ACCUMULATOR_DEPTH;
+        break;
+
+    default:
+        return XST_FAILURE;
+    }
+
+    if (!vectors || !get_range(operand1, TCU_DRAM_ADDRESS_SIZE_BITS, depth,
+                               size, &address, &stride))
+        return XST_FAILURE;
+
+    for (size_t i = 0; i < size; i++) {
+        TCU_DT *local = tcu->local[local_address + i * local_stride];
+        TCU_DT *other = vectors[address + i * stride];
+
+        switch (flags) {
+        case TCU_DATA_MOVE_FLAG_DRAM0_TO_LOCAL:
+        case TCU_DATA_MOVE_FLAG_DRAM1_TO_LOCAL:
+        case TCU_DATA_MOVE_FLAG_ACC_TO_LOCAL:
+            memcpy(local, other, TCU_VECTOR_SIZE);
+            break;
+
+        case TCU_DATA_MOVE_FLAG_LOCAL_TO_ACC_WITH_ACC:
+            vector_add(other, local);
+            break;
+
+        default:
+            memcpy(other, local, TCU_VECTOR_SIZE);
+            break;
+        }
+    }
+
+    return XST_SUCCESS;
+}
+
+static int load_weight(struct tcu *tcu, u8 flags, u64 operand0,
+                       u64 operand1) {
+    size_t size = operand1 + 1;
+    size_t local_address, local_stride;
+
+    if (!get_range(operand0, TCU_LOCAL_ADDRESS_SIZE_BITS,
+                   TENSIL_ARCHITECTURE_LOCAL_DEPTH, size, &local_address,
+                   &local_stride))
+        return XST_FAILURE;
+
+    for (size_t i = 0; i < size; i++) {
+        memmove(tcu->weights[1], tcu->weights[0],
+                TCU_VECTOR_LENGTH * TCU_VECTOR_SIZE);
+
+        if (flags & TCU_LOAD_WEIGHT_FLAG_ZEROES)
+            memset(tcu->weights[0], 0, TCU_VECTOR_SIZE);
+        else
+            memcpy(tcu->weights[0],
+                   tcu->local[local_address + (size - 1 - i) * local_stride],
+                   TCU_VECTOR_SIZE);
+    }
+
+    return XST_SUCCESS;
+}
+
+static int simd(struct tcu *tcu, u8 flags, u64 operand0, u64 operand1,
+                u64 operand2) {
+    size_t write_address = get_bits(operand0, 0, TCU_LOCAL_ADDRESS_SIZE_BITS);
+    size_t read_address = get_bits(operand1, 0, TCU_DRAM_ADDRESS_SIZE_BITS);
+
+    if (write_address >= TENSIL_ARCHITECTURE_ACCUMULATOR_DEPTH ||
+        read_address >= TENSIL_ARCHITECTURE_ACCUMULATOR_DEPTH)
+        return XST_FAILURE;
+
+    /*
+     * SIMD instruction is the operation followed by left and right
+     * sources and the destination, one bit each for a single register.
+     * Zero selects the input read from the accumulators or the output
+     * written to the accumulators, otherwise it is the register number.
+     */
+
+    u8 op = get_bits(operand2, 3, 4);
+    u8 left = get_bits(operand2, 2, 1);
+    u8 right = get_bits(operand2, 1, 1);
+    u8 dest = get_bits(operand2, 0, 1);
+
+    static const TCU_DT zeroes[TCU_VECTOR_LENGTH];
+    const TCU_DT *input = flags & TCU_SIMD_FLAG_READ
+                              ? tcu->accumulators[read_address]
+                              : zeroes;
+    TCU_DT output[TCU_VECTOR_LENGTH];
+
+    vector_simd(op, left ? tcu->registers[left - 1] : input,
+                right ? tcu->registers[right - 1] : input, output);
+
+    if (dest)
+        memcpy(tcu->registers[dest - 1], output, TCU_VECTOR_SIZE);
+
+    if (flags & TCU_SIMD_FLAG_WRITE) {
+        if (flags & TCU_SIMD_FLAG_ACCUMULATE)
+            vector_add(tcu->accumulators[write_address], output);
+        else
+            memcpy(tcu->accumulators[write_address], output,
+                   TCU_VECTOR_SIZE);
+    }
+
+    return XST_SUCCESS;
+}
+
+static int config(struct tcu *tcu, u64 operand0, u64 operand1) {
+    TCU_DT(*vectors)[TCU_VECTOR_LENGTH] =
+        (TCU_DT(*)[TCU_VECTOR_LENGTH])(tcu->ddr_ptr +
+                                       (operand1 << TCU_DRAM_OFFSET_SHIFT));
+
+    switch (operand0) {
+    case TCU_CONFIG_REGISTER_DRAM0_OFFSET:
+        tcu->dram0_ptr = vectors;
+        break;
+
+    case TCU_CONFIG_REGISTER_DRAM1_OFFSET:
+        tcu->dram1_ptr = vectors;
+        break;
+
+    default:
+        /*
+         * Other registers control timeouts and tracing of the hardware
+         * and have no effect here.
+         */
+
+        break;
+    }
+
+    return XST_SUCCESS;
+}
+
+static void count(struct tcu_counters *counters, u8 opcode, u8 flags,
+                  u64 operand1, u64 operand2) {
+    counters->instructions++;
+
+    switch (opcode) {
+    case TCU_OPCODE_MATMUL:
+        counters->matmul_vectors += operand2 + 1;
+        break;
+
+    case TCU_OPCODE_LOAD_WEIGHT:
+        counters->load_weight_vectors += operand1 + 1;
+        break;
+
+    case TCU_OPCODE_SIMD:
+        counters->simd_instructions++;
+        break;
+
+    case TCU_OPCODE_DATA_MOVE:
+        switch (flags) {
+        case TCU_DATA_MOVE_FLAG_DRAM0_TO_LOCAL:
+        case TCU_DATA_MOVE_FLAG_LOCAL_TO_DRAM0:
+            counters->dram0_vectors += operand2 + 1;
+            break;
+
+        case TCU_DATA_MOVE_FLAG_DRAM1_TO_LOCAL:
+        case TCU_DATA_MOVE_FLAG_LOCAL_TO_DRAM1:
+            counters->dram1_vectors += operand2 + 1;
+            break;
+
+        default:
+            counters->accumulator_vectors += operand2 + 1;
+            break;
+        }
+
+        break;
+    }
+}
+
+void tcu_init(struct tcu *tcu, u8 *ddr_ptr) {
+    memset(tcu, 0, sizeof(struct tcu));
+
+    tcu->ddr_ptr = ddr_ptr;
+}
+
+void tcu_set_dram(struct tcu *tcu, u8 *dram0_ptr, u8 *dram1_ptr) {
+    tcu->dram0_ptr = (TCU_DT(*)[TCU_VECTOR_LENGTH])dram0_ptr;
+    tcu->dram1_ptr = (TCU_DT(*)[TCU_VECTOR_LENGTH])dram1_ptr;
+}
+
+int tcu_execute(struct tcu *tcu, const u8 *program, size_t size) {
+    for (size_t offset = 0; offset + TCU_INSTRUCTION_SIZE <= size;
+         offset += TCU_INSTRUCTION_SIZE) {
+        u64 instruction = 0;
+
+        for (size_t i = 0; i < TCU_INSTRUCTION_SIZE; i++)
+            instruction |= (u64)program[offset + i] << (i * 8);
+
+        u64 operand0 = get_bits(instruction, 0, TCU_OPERAND0_SIZE_BITS);
+        u64 operand1 = get_bits(instruction, TCU_OPERAND0_SIZE_BITS,
+                                TCU_OPERAND1_SIZE_BITS);
+        u64 operand2 =
+            get_bits(instruction,
+                     TCU_OPERAND0_SIZE_BITS + TCU_OPERAND1_SIZE_BITS,
+                     TCU_OPERAND2_SIZE_BITS);
+        u8 header = instruction >> (TCU_INSTRUCTION_SIZE * 8 - 8);
+        u8 opcode = header >> 4;
+        u8 flags = header & 0xf;
+        int status;
+
+        switch (opcode) {
+        case TCU_OPCODE_NOOP:
+            status = XST_SUCCESS;
+            break;
+
+        case TCU_OPCODE_MATMUL:
+            status = matmul(tcu, flags, operand0, operand1, operand2);
+            break;
+
+        case TCU_OPCODE_DATA_MOVE:
+            status = data_move(tcu, flags, operand0, operand1, operand2);
+            break;
+
+        case TCU_OPCODE_LOAD_WEIGHT:
+            status = load_weight(tcu, flags, operand0, operand1);
+            break;
+
+        case TCU_OPCODE_SIMD:
+            status = simd(tcu, flags, operand0, operand1, operand2);
+            break;
+
+        case TCU_OPCODE_CONFIG:
+            status = config(tcu, operand0, operand1);
+            break;
+
+        default:
+            status = XST_FAILURE;
+            break;
+        }
+
+        if (status != XST_SUCCESS)
+            return status;
+
+        count(&tcu->counters, opcode, flags, operand1, operand2);
+    }
+
+    return XST_SUCCESS;
+}
+
+int tcu_get_first_dram0_read(const u8 *program, size_t size,
+                             size_t *address) {
+    for (size_t offset = 0; offset + TCU_INSTRUCTION_SIZE <= size;
+         offset += TCU_INSTRUCTION_SIZE) {
+        u64 instruction = 0;
+
+        for (size_t i = 0; i < TCU_INSTRUCTION_SIZE; i++)
+            instruction |= (u64)program[offset + i] << (i * 8);
+
+        u8 header = instruction >> (TCU_INSTRUCTION_SIZE * 8 - 8);
+        u8 flags = header & 0xf;
+
+        if (header >> 4 != TCU_OPCODE_DATA_MOVE ||
+            (flags != TCU_DATA_MOVE_FLAG_DRAM0_TO_LOCAL &&
+             flags != TCU_DATA_MOVE_FLAG_LOCAL_TO_DRAM0))
+            continue;
+
+        if (flags != TCU_DATA_MOVE_FLAG_DRAM0_TO_LOCAL)
+            return XST_FAILURE;
+
+        u64 operand1 = get_bits(instruction, TCU_OPERAND0_SIZE_BITS,
+                                TCU_OPERAND1_SIZE_BITS);
+
+        *address = get_bits(operand1, 0, TCU_DRAM_ADDRESS_SIZE_BITS);
+
+        return XST_SUCCESS;
+    }
+
+    return XST_FAILURE;
+}
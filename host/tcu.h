@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "architecture_params.h"
+#include "xil_types.h"
+
+/*
+ * Reference interpreter of the Tensil instruction set for the
+ * architecture in ./arch/speech_robot.tarch. It executes compiled
+ * programs (.tprog) against DRAM0 and DRAM1 in host memory and keeps
+ * the local memory, accumulators, systolic array weights and SIMD
+ * registers of the TCU.
+ *
+ * All arithmetic is FP16BP8 fixed point. Products are computed in full
+ * precision, rounded to nearest with ties up and saturated to 16 bits.
+ * Sums are saturated. The systolic array rounds and saturates after
+ * every row, starting from the bias row.
+ */
+
+#define TCU_DT int16_t
+#define TCU_VECTOR_LENGTH TENSIL_ARCHITECTURE_ARRAY_SIZE
+#define TCU_VECTOR_SIZE (TCU_VECTOR_LENGTH * sizeof(TCU_DT))
+
+#define TCU_INSTRUCTION_SIZE 8
+
+/*
+ * Configuration instructions set DRAM base addresses in 64KB blocks
+ * relative to the start of DDR.
+ */
+
+#define TCU_DRAM_OFFSET_SHIFT 16
+
+/*
+ * Work done by the instructions executed since `tcu_init`, in vectors
+ * multiplied, loaded into the systolic array or moved to and from each
+ * memory. Constants are in DRAM1, so DRAM1 vectors and the weight
+ * vectors loaded into the array are the weight traffic of the program.
+ */
+
+struct tcu_counters {
+    u64 instructions;
+    u64 matmul_vectors;
+    u64 load_weight_vectors;
+    u64 dram0_vectors;
+    u64 dram1_vectors;
+    u64 accumulator_vectors;
+    u64 simd_instructions;
+};
+
+struct tcu {
+    u8 *ddr_ptr;
+
+    TCU_DT (*dram0_ptr)[TCU_VECTOR_LENGTH];
+    TCU_DT (*dram1_ptr)[TCU_VECTOR_LENGTH];
+
+    TCU_DT local[TENSIL_ARCHITECTURE_LOCAL_DEPTH][TCU_VECTOR_LENGTH];
+    TCU_DT accumulators[TENSIL_ARCHITECTURE_ACCUMULATOR_DEPTH]
+                       [TCU_VECTOR_LENGTH];
+
+    /*
+     * Weight loads shift vectors in from the highest address down, so
+     * that the vector at the lowest address of the last load is the bias
+     * in row 0 and row i + 1 is multiplied by lane i of the input.
+     */
+
+    TCU_DT weights[TCU_VECTOR_LENGTH + 1][TCU_VECTOR_LENGTH];
+    TCU_DT registers[TENSIL_ARCHITECTURE_SIMD_REGISTERS_DEPTH]
+                    [TCU_VECTOR_LENGTH];
+
+    struct tcu_counters counters;
+};
+
+void tcu_init(struct tcu *tcu, u8 *ddr_ptr);
+
+void tcu_set_dram(struct tcu *tcu, u8 *dram0_ptr, u8 *dram1_ptr);
+
+/*
+ * Executes `size` bytes of instructions. Returns XST_FAILURE when it
+ * meets an unknown instruction or an address outside of the memories.
+ */
+
+int tcu_execute(struct tcu *tcu, const u8 *program, size_t size);
+
+/*
+ * Finds the first data move to or from DRAM0 in `size` bytes of
+ * instructions and returns the DRAM0 address in vectors that it reads
+ * into `address`. Returns XST_FAILURE when there is no such data move or
+ * the first one writes DRAM0.
+ */
+
+int tcu_get_first_dram0_read(const u8 *program, size_t size,
+                             size_t *address);
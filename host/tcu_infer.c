@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "program.h"
+#include "tcu.h"
+#include "xstatus.h"
+
+/*
+ * Runs a compiled model in the reference interpreter and prints the
+ * output logits together with the inference time.
+ *
+ * Usage: tcu_infer model.tprog model.tdata input.bin [runs]
+ *
+ * The input is the raw FP16BP8 DRAM0 image of the spectrogram that the
+ * resize layer at the start of the program reads: 124 lines of 129
+ * vectors with the value in the first lane.
+ *
+ * It also prints the work of an inference counted by the interpreter
+ * and what it would be per window for models compiled with a batch of
+ * windows. Weight traffic, the DRAM1 vectors and the vectors loaded
+ * into the systolic array, is the same for the whole batch, while the
+ * rest grows with the number of windows. Each vector is taken to cost
+ * one cycle, of the array or of the memory port it goes through.
+ */
+
+#define INFER_OUTPUT_LENGTH 12
+#define INFER_MAX_BATCH_SIZE 8
+
+static void print_batches(const struct tcu_counters *counters,
+                          size_t runs) {
+    double weights =
+        (double)(counters->dram1_vectors + counters->load_weight_vectors) /
+        runs;
+    double activations =
+        (double)(counters->matmul_vectors + counters->dram0_vectors +
+                 counters->accumulator_vectors +
+                 counters->simd_instructions) /
+        runs;
+
+    fprintf(stderr,
+            "vectors/inference: %.0f matmul, %.0f load weight, %.0f dram0, "
+            "%.0f dram1, %.0f accumulator, %.0f simd\n",
+            (double)counters->matmul_vectors / runs,
+            (double)counters->load_weight_vectors / runs,
+            (double)counters->dram0_vectors / runs,
+            (double)counters->dram1_vectors / runs,
+            (double)counters->accumulator_vectors / runs,
+            (double)counters->simd_instructions / runs);
+
+    fprintf(stderr, "\n%5s %15s %15s %11s %8s\n", "batch",
+            "dram1 KB/window", "vectors/window", "throughput", "latency");
+
+    for (size_t n = 1; n <= INFER_MAX_BATCH_SIZE; n *= 2) {
+        double vectors = activations + weights / n;
+
+        fprintf(stderr, "%5zu %15.1f %15.0f %10.2fx %7.2fx\n", n,
+                counters->dram1_vectors * TCU_VECTOR_SIZE / 1024.0 / runs / n,
+                vectors, (activations + weights) / vectors,
+                n * vectors / (activations + weights));
+    }
+}
+
+static u64 get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        fprintf(stderr,
+                "usage: %s model.tprog model.tdata input.bin [runs]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct program program;
+
+    if (program_read(&program, argv[1], argv[2]) != XST_SUCCESS) {
+        fprintf(stderr, "failed to read %s or %s\n", argv[1], argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    size_t dram0_size = TENSIL_ARCHITECTURE_DRAM0_DEPTH * TCU_VECTOR_SIZE;
+    u8 *input_ptr = calloc(1, dram0_size);
+    u8 *dram0_ptr = aligned_alloc(TCU_VECTOR_SIZE, dram0_size);
+    struct tcu *tcu = malloc(sizeof(struct tcu));
+    FILE *file = fopen(argv[3], "rb");
+
+    if (!file) {
+        fprintf(stderr, "failed to read %s\n", argv[3]);
+        return EXIT_FAILURE;
+    }
+
+    size_t input_size = fread(input_ptr, 1, dram0_size, file);
+    fclose(file);
+
+    size_t runs = argc > 4 ? atoi(argv[4]) : 1;
+    u64 total_ns = 0;
+
+    tcu_init(tcu, NULL);
+
+    for (size_t i = 0; i < runs; i++) {
+        memcpy(dram0_ptr, input_ptr, input_size);
+
+        u64 start_ns = get_time_ns();
+
+        if (program_run(&program, tcu, dram0_ptr) != XST_SUCCESS) {
+            fprintf(stderr, "invalid program\n");
+            return EXIT_FAILURE;
+        }
+
+        total_ns += get_time_ns() - start_ns;
+    }
+
+    for (size_t i = 0; i < INFER_OUTPUT_LENGTH; i++)
+        printf("%.8f\n", ((TCU_DT *)dram0_ptr)[i] / 256.0);
+
+    fprintf(stderr, "runs: %zu, ms/inference: %.3f\n", runs,
+            total_ns / 1e6 / runs);
+    print_batches(&tcu->counters, runs);
+
+    free(tcu);
+    free(dram0_ptr);
+    free(input_ptr);
+    program_free(&program);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wav.h"
+#include "xstatus.h"
+
+#define WAV_FORMAT_PCM 1
+
+static u32 read_u32(const u8 *ptr) {
+    return (u32)ptr[0] | ((u32)ptr[1] << 8) | ((u32)ptr[2] << 16) |
+           ((u32)ptr[3] << 24);
+}
+
+static u16 read_u16(const u8 *ptr) { return (u16)ptr[0] | ((u16)ptr[1] << 8); }
+
+int wav_read(const char *path, struct wav *wav) {
+    memset(wav, 0, sizeof(struct wav));
+
+    FILE *file = fopen(path, "rb");
+
+    if (!file)
+        return XST_FAILURE;
+
+    u8 header[12];
+    u16 channels = 0;
+    u16 bits_per_sample = 0;
+    int status = XST_FAILURE;
+
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) || memcmp(header + 8, "WAVE", 4))
+        goto done;
+
+    /*
+     * Walk the chunks until "data" is found. The "fmt " chunk must
+     * precede it.
+     */
+
+    while (true) {
+        u8 chunk[8];
+
+        if (fread(chunk, 1, sizeof(chunk), file) != sizeof(chunk))
+            goto done;
+
+        u32 chunk_size = read_u32(chunk + 4);
+
+        if (!memcmp(chunk, "fmt ", 4)) {
+            u8 fmt[16];
+
+            if (chunk_size < sizeof(fmt) ||
+                fread(fmt, 1, sizeof(fmt), file) != sizeof(fmt))
+                goto done;
+
+            if (read_u16(fmt) != WAV_FORMAT_PCM)
+                goto done;
+
+            channels = read_u16(fmt + 2);
+            wav->sample_rate = read_u32(fmt + 4);
+            bits_per_sample = read_u16(fmt + 14);
+
+            if (fseek(file, chunk_size - sizeof(fmt) + (chunk_size & 1),
+                      SEEK_CUR))
+                goto done;
+        } else if (!memcmp(chunk, "data", 4)) {
+            if (!channels || bits_per_sample != 16)
+                goto done;
+
+            size_t frames = chunk_size / (channels * sizeof(int16_t));
+            int16_t *interleaved = malloc(frames * channels * sizeof(int16_t));
+
+            if (!interleaved)
+                goto done;
+
+            frames = fread(interleaved, channels * sizeof(int16_t), frames,
+                           file);
+
+            for (size_t i = 0; i < frames; i++)
+                interleaved[i] = interleaved[i * channels];
+
+            wav->samples = interleaved;
+            wav->length = frames;
+            status = XST_SUCCESS;
+
+            goto done;
+        } else if (fseek(file, chunk_size + (chunk_size & 1), SEEK_CUR))
+            goto done;
+    }
+
+done:
+    fclose(file);
+    return status;
+}
+
+int wav_read_pcm(const char *path, u32 sample_rate, struct wav *wav) {
+    memset(wav, 0, sizeof(struct wav));
+
+    FILE *file = fopen(path, "rb");
+
+    if (!file)
+        return XST_FAILURE;
+
+    int status = XST_FAILURE;
+
+    if (fseek(file, 0, SEEK_END))
+        goto done;
+
+    long size = ftell(file);
+
+    if (size < 0 || fseek(file, 0, SEEK_SET))
+        goto done;
+
+    size_t frames = size / sizeof(int16_t);
+    u8 *bytes = malloc(frames * sizeof(int16_t));
+
+    if (!bytes)
+        goto done;
+
+    frames = fread(bytes, sizeof(int16_t), frames, file);
+
+    for (size_t i = 0; i < frames; i++)
+        ((int16_t *)bytes)[i] = (int16_t)read_u16(bytes + i * sizeof(int16_t));
+
+    wav->samples = (int16_t *)bytes;
+    wav->length = frames;
+    wav->sample_rate = sample_rate;
+    status = XST_SUCCESS;
+
+done:
+    fclose(file);
+    return status;
+}
+
+void wav_free(struct wav *wav) {
+    free(wav->samples);
+    memset(wav, 0, sizeof(struct wav));
+}
@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xil_types.h"
+
+/*
+ * Mono 16-bit PCM audio as found in the speech commands dataset.
+ */
+
+struct wav {
+    int16_t *samples;
+    size_t length;
+    u32 sample_rate;
+};
+
+/*
+ * Reads RIFF/WAVE file with 16-bit PCM samples. Multi-channel files
+ * are reduced to their first channel. Returns XST_SUCCESS on success.
+ */
+
+int wav_read(const char *path, struct wav *wav);
+
+/*
+ * Reads headerless little-endian 16-bit mono PCM file sampled at
+ * `sample_rate`. Returns XST_SUCCESS on success.
+ */
+
+int wav_read_pcm(const char *path, u32 sample_rate, struct wav *wav);
+
+void wav_free(struct wav *wav);
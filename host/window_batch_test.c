@@ -0,0 +1,219 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "resize.h"
+#include "window_batch.h"
+
+/*
+ * Checks the windows that vitis/window_batch.c collects for batches as
+ * speech_robot.c drives it, for every batch size up to
+ * WINDOW_BATCH_MAX_SIZE, both overrun policies and steps and inference
+ * durations that make most windows overrun.
+ *
+ * Usage: window_batch_test [-n lines] [-s seed]
+ *
+ * Each STFT line is resized into zero or one rows of the ring, as
+ * RESIZE_HEIGHT rows per frame of TEST_FRAME_HEIGHT lines. Every
+ * `step` rows a window is due, and passes the gates unless rejected at
+ * random, which flushes the batch. An inference started on a line keeps
+ * the TCU busy for `duration` lines. Each batch started is checked to
+ * hold every window once, in the order they were due and after all
+ * windows inferred before, to be completed by repeating its last
+ * window, and to only read rows that are not overwritten before the
+ * next step. Rows are counted from the start rather than wrapped in
+ * the ring.
+ */
+
+#define TEST_DEFAULT_LINES 100000
+#define TEST_FRAME_HEIGHT 124
+#define TEST_REJECT_PERCENT 10
+
+#define TEST_RING_HEIGHT(step)                                                 \
+    (RESIZE_HEIGHT + (step) + (WINDOW_BATCH_MAX_SIZE - 1) * RESIZE_HEIGHT)
+#define TEST_MAX_AGE(step) (TEST_RING_HEIGHT(step) - RESIZE_HEIGHT - (step))
+
+static const size_t steps[] = {1, 2, 4, 8, 16, 32};
+static const size_t durations[] = {1, 3, 8, 20, 60, 200, 600};
+
+#define TEST_STEPS (sizeof(steps) / sizeof(steps[0]))
+#define TEST_DURATIONS (sizeof(durations) / sizeof(durations[0]))
+
+struct result {
+    size_t batches;
+    size_t windows;
+    size_t overruns;
+    size_t expired;
+    size_t failures;
+};
+
+static u32 seed = 1;
+
+static u32 get_random() {
+    seed = seed * 1664525 + 1013904223;
+
+    return seed >> 16;
+}
+
+static void fail(struct result *result, size_t line, const char *message) {
+    if (!result->failures++)
+        fprintf(stderr, "line %zu: %s\n", line, message);
+}
+
+/*
+ * State of the loop in speech_robot.c, with the rows written so far,
+ * the line the TCU is free again on and the first row of the last
+ * window inferred.
+ */
+
+struct loop {
+    struct window_batch batch;
+    size_t step;
+    size_t duration;
+    size_t rows;
+    size_t window_rows;
+    bool window_pending;
+    size_t free_line;
+    size_t last_row;
+    bool inferred;
+};
+
+static size_t get_window_first_row(const struct loop *loop) {
+    return loop->rows - RESIZE_HEIGHT;
+}
+
+/*
+ * Starts the batch on `line` and checks the windows it holds.
+ */
+
+static void start_inference(struct loop *loop, size_t line,
+                            struct result *result) {
+    size_t rows[WINDOW_BATCH_MAX_SIZE];
+    size_t row = get_window_first_row(loop);
+
+    result->expired += window_batch_expire(&loop->batch, row);
+
+    if (window_batch_is_empty(&loop->batch))
+        return;
+
+    size_t windows = window_batch_start(&loop->batch, row, rows);
+
+    if (!windows || windows > loop->batch.size) {
+        fail(result, line, "wrong number of windows");
+        return;
+    }
+
+    for (size_t i = 0; i < windows; i++) {
+        if (loop->inferred && rows[i] <= loop->last_row)
+            fail(result, line, "window inferred twice or out of order");
+
+        loop->last_row = rows[i];
+        loop->inferred = true;
+    }
+
+    for (size_t i = windows; i < loop->batch.size; i++)
+        if (rows[i] != rows[windows - 1])
+            fail(result, line, "batch not completed by its last window");
+
+    if (row - rows[0] > TEST_MAX_AGE(loop->step))
+        fail(result, line, "window overwritten in the ring");
+
+    loop->free_line = line + loop->duration;
+    result->batches++;
+    result->windows += windows;
+}
+
+static void process_line(struct loop *loop, size_t line,
+                         struct result *result) {
+    bool busy = line < loop->free_line;
+    size_t rows = (line + 1) * RESIZE_HEIGHT / TEST_FRAME_HEIGHT;
+
+    loop->window_rows += rows - loop->rows;
+    loop->rows = rows;
+
+    if (loop->rows >= RESIZE_HEIGHT && loop->window_rows >= loop->step) {
+        size_t row = get_window_first_row(loop);
+
+        loop->window_rows %= loop->step;
+        result->expired += window_batch_expire(&loop->batch, row);
+
+        if (get_random() % 100 < TEST_REJECT_PERCENT) {
+            if (!window_batch_is_empty(&loop->batch))
+                loop->window_pending = true;
+        } else if (!window_batch_is_last(&loop->batch))
+            window_batch_add(&loop->batch, row);
+        else if (busy) {
+            result->overruns++;
+            loop->window_pending = window_batch_overrun(&loop->batch, row);
+        } else {
+            loop->window_pending = true;
+            window_batch_complete(&loop->batch);
+        }
+    }
+
+    if (loop->window_pending && !busy) {
+        loop->window_pending = false;
+        start_inference(loop, line, result);
+    }
+}
+
+static void run(size_t size, bool coalesce, size_t step, size_t duration,
+                size_t lines_length, struct result *result) {
+    struct loop loop = {.step = step, .duration = duration};
+
+    window_batch_init(&loop.batch, size, coalesce, TEST_RING_HEIGHT(step),
+                      TEST_MAX_AGE(step));
+
+    for (size_t line = 0; line < lines_length; line++)
+        process_line(&loop, line, result);
+}
+
+int main(int argc, char **argv) {
+    size_t lines_length = TEST_DEFAULT_LINES;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+        case 'n':
+            lines_length = atol(optarg);
+            break;
+        case 's':
+            seed = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n lines] [-s seed]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("%4s %8s %8s %8s %8s %8s %8s\n", "size", "policy", "batches",
+           "windows", "overruns", "expired", "failed");
+
+    size_t failures = 0;
+
+    for (size_t size = 1; size <= WINDOW_BATCH_MAX_SIZE; size++)
+        for (size_t policy = 0; policy < 2; policy++) {
+            struct result result = {0};
+
+            for (size_t i = 0; i < TEST_STEPS; i++)
+                for (size_t j = 0; j < TEST_DURATIONS; j++)
+                    run(size, policy, steps[i], durations[j], lines_length,
+                        &result);
+
+            printf("%4zu %8s %8zu %8zu %8zu %8zu %8zu\n", size,
+                   policy ? "coalesce" : "skip", result.batches,
+                   result.windows, result.overruns, result.expired,
+                   result.failures);
+
+            if (!result.overruns)
+                result.failures++;
+
+            failures += result.failures;
+        }
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include "decision.h"
+
+void decision_init(struct decision *decision, const u32 *thresholds,
+                   size_t length, size_t min_refractory_lines,
+                   size_t max_refractory_lines) {
+    if (length > DECISION_MAX_LENGTH)
+        length = DECISION_MAX_LENGTH;
+
+    decision->length = length;
+
+    for (size_t i = 0; i < length; i++) {
+        decision->levels[i] = thresholds[i] >> DECISION_LEVEL_SHIFT;
+        decision->floors[i] = thresholds[i] - decision->levels[i];
+        decision->evidence[i] = 0;
+    }
+
+    decision->min_refractory_lines = min_refractory_lines;
+    decision->max_refractory_lines = max_refractory_lines;
+    decision->refractory_lines = 0;
+    decision->held = 0;
+    decision->holding = false;
+}
+
+static void add_evidence(struct decision *decision, size_t i,
+                         u32 probability) {
+    if (i < decision->length && probability > decision->floors[i])
+        decision->evidence[i] += probability - decision->floors[i];
+}
+
+bool decision_update(struct decision *decision,
+                     const struct softmax_result *result) {
+    for (size_t i = 0; i < decision->length; i++)
+        decision->evidence[i] >>= DECISION_DECAY_SHIFT;
+
+    add_evidence(decision, result->first, result->probability);
+    add_evidence(decision, result->second,
+                 result->probability - result->margin);
+
+    size_t first = result->first;
+
+    if (decision->holding) {
+        if (first != decision->held)
+            decision->holding = false;
+        else
+            decision->evidence[first] = 0;
+    }
+
+    if (first >= decision->length || !decision->levels[first] ||
+        decision->refractory_lines < decision->min_refractory_lines ||
+        decision->evidence[first] <= decision->levels[first])
+        return false;
+
+    /*
+     * Evidence of all classes is cleared, so that the next command
+     * needs windows of its own.
+     */
+
+    for (size_t i = 0; i < decision->length; i++)
+        decision->evidence[i] = 0;
+
+    decision->refractory_lines = 0;
+    decision->held = first;
+    decision->holding = true;
+
+    return true;
+}
+
+void decision_tick(struct decision *decision) {
+    if (decision->refractory_lines < decision->max_refractory_lines)
+        decision->refractory_lines++;
+    else
+        decision->holding = false;
+}
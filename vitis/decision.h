@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xil_types.h"
+
+#include "softmax.h"
+
+/*
+ * Streaming decision over the softmax of overlapping windows. A word
+ * stays in the windows for about a second, so its probability rises
+ * over several of them before any single one is confident enough.
+ *
+ * Each class has an evidence that is halved DECISION_DECAY_SHIFT times
+ * with every window and grows by the amount its probability is above
+ * its floor, for the two most probable classes. The floor is the
+ * threshold of the class less its 1 / 2^DECISION_LEVEL_SHIFT part, the
+ * level. The most probable class fires when its evidence exceeds its
+ * level. Thus a single window above the threshold fires as it would
+ * alone, and a few consecutive windows just below it fire too.
+ *
+ * After a class fires no class can fire for `min_refractory_lines`
+ * lines. The class that fired is held until it is no longer the most
+ * probable one, since the same word is still in the windows, but at
+ * most for `max_refractory_lines` lines.
+ *
+ * Probabilities and evidence are in units of 1 / SOFTMAX_PROBABILITY_ONE.
+ */
+
+#define DECISION_MAX_LENGTH 16
+
+#define DECISION_LEVEL_SHIFT 2
+#define DECISION_DECAY_SHIFT 1
+
+struct decision {
+    size_t length;
+    u32 floors[DECISION_MAX_LENGTH];
+    u32 levels[DECISION_MAX_LENGTH];
+    u32 evidence[DECISION_MAX_LENGTH];
+
+    size_t min_refractory_lines;
+    size_t max_refractory_lines;
+
+    /*
+     * Lines since the last class fired, saturated at the maximum
+     * refractory period, and the class held since.
+     */
+
+    size_t refractory_lines;
+    size_t held;
+    bool holding;
+};
+
+/*
+ * Initializes the decision for `length` classes. Class i fires when a
+ * window alone has probability above `thresholds[i]`, or several have
+ * just below it. Classes with zero threshold never fire. The decision
+ * starts as if a class fired, but holds none.
+ */
+
+void decision_init(struct decision *decision, const u32 *thresholds,
+                   size_t length, size_t min_refractory_lines,
+                   size_t max_refractory_lines);
+
+/*
+ * Updates the evidence with the softmax of the next window. Returns
+ * true when the most probable class fires.
+ */
+
+bool decision_update(struct decision *decision,
+                     const struct softmax_result *result);
+
+/*
+ * Advances the refractory period by one STFT line.
+ */
+
+void decision_tick(struct decision *decision);
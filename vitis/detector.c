@@ -0,0 +1,92 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <string.h>
+
+#include "detector.h"
+
+void detector_init(struct detector *detector,
+                   const struct detector_params *params) {
+    detector->params = params;
+    detector->row = 0;
+    memset(detector->rows, 0, sizeof(detector->rows));
+}
+
+void detector_set_params(struct detector *detector,
+                         const struct detector_params *params) {
+    detector->params = params;
+}
+
+/*
+ * Log2 of `value + 1` with DETECTOR_LOG_FRACTION_BITS fraction bits
+ * taken from the bits following the most significant one.
+ */
+
+static u16 get_log2(u32 value) {
+    value++;
+
+    u32 msb = 31 - __builtin_clz(value);
+    u32 fraction =
+        msb >= DETECTOR_LOG_FRACTION_BITS
+            ? value >> (msb - DETECTOR_LOG_FRACTION_BITS)
+            : value << (DETECTOR_LOG_FRACTION_BITS - msb);
+
+    return msb << DETECTOR_LOG_FRACTION_BITS |
+           (fraction & ((1 << DETECTOR_LOG_FRACTION_BITS) - 1));
+}
+
+void detector_push_row(struct detector *detector, const DETECTOR_DT *row,
+                       size_t stride) {
+    u16 *logs = detector->rows[detector->row];
+
+    for (size_t i = 0; i < DETECTOR_BANDS; i++) {
+        u32 energy = 0;
+
+        for (size_t j = 0; j < DETECTOR_BAND_WIDTH; j++) {
+            DETECTOR_DT value = row[(i * DETECTOR_BAND_WIDTH + j) * stride];
+
+            if (value > 0)
+                energy += value;
+        }
+
+        logs[i] = get_log2(energy);
+    }
+
+    detector->row = (detector->row + 1) % RESIZE_HEIGHT;
+}
+
+void detector_get_features(const struct detector *detector,
+                           u16 features[DETECTOR_FEATURES]) {
+    memset(features, 0, DETECTOR_FEATURES * sizeof(u16));
+
+    for (size_t i = 0; i < RESIZE_HEIGHT; i++) {
+        const u16 *logs = detector->rows[(detector->row + i) % RESIZE_HEIGHT];
+        u16 *segment =
+            &features[i / DETECTOR_SEGMENT_HEIGHT * DETECTOR_BANDS];
+
+        for (size_t j = 0; j < DETECTOR_BANDS; j++)
+            segment[j] += logs[j];
+    }
+}
+
+int32_t detector_get_score(const struct detector_params *params,
+                           const u16 features[DETECTOR_FEATURES]) {
+    int32_t score = params->bias;
+
+    for (size_t i = 0; i < DETECTOR_FEATURES; i++)
+        score += params->weights[i] * features[i];
+
+    return score;
+}
+
+bool detector_is_passed(const struct detector *detector) {
+    if (!detector->params)
+        return true;
+
+    u16 features[DETECTOR_FEATURES];
+
+    detector_get_features(detector, features);
+
+    return detector_get_score(detector->params, features) >=
+           detector->params->threshold;
+}
@@ -0,0 +1,101 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "resize.h"
+#include "xil_types.h"
+
+/*
+ * Keyword detector that is the first stage of the model cascade. It
+ * runs on the CPU over every window and lets the full model run on the
+ * TCU only for windows that probably contain a command.
+ *
+ * The detector is a linear classifier over pooled log energies of the
+ * resized model input. As each resized row is written, its values are
+ * summed in DETECTOR_BANDS bands of adjacent columns and the log2 of
+ * each band is kept with DETECTOR_LOG_FRACTION_BITS fraction bits. The
+ * features of a window are these logs summed over DETECTOR_SEGMENTS
+ * segments of consecutive rows, band by band. The score of a window is
+ * the dot product of the features with the weights plus the bias, and
+ * the window passes when the score is at least the threshold. Weights
+ * are trained offline by host/batch.c against the decisions of the full
+ * model and are stored with the model image.
+ */
+
+#define DETECTOR_DT RESIZE_DT
+
+#define DETECTOR_BANDS 8
+#define DETECTOR_SEGMENTS 8
+#define DETECTOR_FEATURES (DETECTOR_BANDS * DETECTOR_SEGMENTS)
+
+#define DETECTOR_BAND_WIDTH (RESIZE_WIDTH / DETECTOR_BANDS)
+#define DETECTOR_SEGMENT_HEIGHT (RESIZE_HEIGHT / DETECTOR_SEGMENTS)
+
+#define DETECTOR_LOG_FRACTION_BITS 4
+
+#if RESIZE_WIDTH % DETECTOR_BANDS || RESIZE_HEIGHT % DETECTOR_SEGMENTS
+#error "Bands and segments must divide the model input"
+#endif
+
+/*
+ * Parameters as stored in the model image.
+ */
+
+struct detector_params {
+    int16_t weights[DETECTOR_FEATURES];
+    int32_t bias;
+    int32_t threshold;
+};
+
+struct detector {
+    const struct detector_params *params;
+
+    /*
+     * Band logs of the last RESIZE_HEIGHT rows, of which the oldest is
+     * at `row`.
+     */
+
+    u16 rows[RESIZE_HEIGHT][DETECTOR_BANDS];
+    size_t row;
+};
+
+/*
+ * Initializes the detector with no rows. Without parameters every
+ * window passes.
+ */
+
+void detector_init(struct detector *detector,
+                   const struct detector_params *params);
+
+void detector_set_params(struct detector *detector,
+                         const struct detector_params *params);
+
+/*
+ * Adds the next resized row. Value j of the row is at `row[j * stride]`.
+ */
+
+void detector_push_row(struct detector *detector, const DETECTOR_DT *row,
+                       size_t stride);
+
+/*
+ * Writes the features of the window of the last RESIZE_HEIGHT rows in
+ * segment major order.
+ */
+
+void detector_get_features(const struct detector *detector,
+                           u16 features[DETECTOR_FEATURES]);
+
+int32_t detector_get_score(const struct detector_params *params,
+                           const u16 features[DETECTOR_FEATURES]);
+
+/*
+ * Returns true when the full model should run on the window of the last
+ * RESIZE_HEIGHT rows.
+ */
+
+bool detector_is_passed(const struct detector *detector);
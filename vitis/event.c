@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <string.h>
+
+#include "event.h"
+
+void scheduler_init(struct scheduler *scheduler, void *context) {
+    scheduler->pending = 0;
+    scheduler->context = context;
+
+    memset(scheduler->handlers, 0, sizeof(scheduler->handlers));
+    memset(scheduler->dispatched, 0, sizeof(scheduler->dispatched));
+}
+
+void scheduler_register(struct scheduler *scheduler, enum event event,
+                        event_handler_t handler) {
+    scheduler->handlers[event] = handler;
+}
+
+void scheduler_post(struct scheduler *scheduler, enum event event) {
+    __sync_fetch_and_or(&scheduler->pending, 1u << event);
+}
+
+tensil_error_t scheduler_dispatch(struct scheduler *scheduler) {
+    u32 pending = scheduler->pending;
+
+    for (size_t i = 0; i < EVENT_LENGTH; i++) {
+        u32 mask = 1u << i;
+
+        if (!(pending & mask))
+            continue;
+
+        /*
+         * Clear the event before running the handler, so that a
+         * completion posted while it runs is not lost.
+         */
+
+        __sync_fetch_and_and(&scheduler->pending, ~mask);
+
+        scheduler->dispatched[i]++;
+
+        if (!scheduler->handlers[i])
+            return TENSIL_ERROR_NONE;
+
+        return scheduler->handlers[i](scheduler->context);
+    }
+
+    return TENSIL_ERROR_NONE;
+}
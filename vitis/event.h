@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xil_types.h"
+
+#include "tensil/error.h"
+
+/*
+ * Run-to-completion scheduler of the main loop. Completions of the
+ * acquisition and STFT DMAs and of TCU instruction blocks are posted
+ * as events, and `scheduler_dispatch` runs the handler of one pending
+ * event. Handlers are never preempted by other handlers, so they share
+ * the main loop state without locks. A handler starts the next transfer
+ * and returns instead of waiting for it.
+ *
+ * Pending events are bits of a mask. Lower events are dispatched first,
+ * so that the TCU is refilled as soon as it drains and the acquisition
+ * is restarted as soon as a packet completes, even while lines of the
+ * spectrogram are waiting to be processed. Posting is atomic and can be
+ * done from an interrupt handler. Posting an event that is already
+ * pending has no effect.
+ */
+
+enum event {
+    EVENT_TCU = 0,
+    EVENT_ACQ,
+    EVENT_STFT,
+    EVENT_LENGTH,
+};
+
+typedef tensil_error_t (*event_handler_t)(void *context);
+
+struct scheduler {
+    volatile u32 pending;
+
+    event_handler_t handlers[EVENT_LENGTH];
+    void *context;
+
+    /*
+     * Number of times each handler has run.
+     */
+
+    u32 dispatched[EVENT_LENGTH];
+};
+
+/*
+ * Initializes the scheduler with no handlers. The `context` is passed
+ * to every handler.
+ */
+
+void scheduler_init(struct scheduler *scheduler, void *context);
+
+void scheduler_register(struct scheduler *scheduler, enum event event,
+                        event_handler_t handler);
+
+void scheduler_post(struct scheduler *scheduler, enum event event);
+
+static inline bool scheduler_is_idle(const struct scheduler *scheduler) {
+    return !scheduler->pending;
+}
+
+/*
+ * Runs the handler of the highest priority pending event, if any, and
+ * returns its error.
+ */
+
+tensil_error_t scheduler_dispatch(struct scheduler *scheduler);
@@ -0,0 +1,166 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xil_types.h"
+
+#include "tensil/error.h"
+#include "tensil/instruction_buffer.h"
+
+/*
+ * Hardware abstraction layer for the speech robot firmware.
+ *
+ * The main loop in speech_robot.c talks to the acquisition and STFT
+ * DMAs, GPIOs, motor timers and the TCU exclusively through these
+ * functions. The board backend (hal_xilinx.c) maps them onto
+ * Xilinx drivers and the Tensil TCU driver. The Linux backend
+ * (host/hal_host.c) emulates the same devices in software so that the
+ * main loop can be run and profiled on a workstation.
+ *
+ * Functions returning int follow Xilinx driver convention and return
+ * XST_SUCCESS on success, so that they can be wrapped with
+ * TENSIL_XILINX_RESULT in the same way as the drivers themselves.
+ */
+
+/*
+ * Format of the samples written by the acquisition DMA and read by the
+ * STFT DMA. The ADC produces 16-bit samples. With HAL_ACQ_FORMAT_FLOAT
+ * they are converted to single precision floating point in the
+ * acquisition pipeline and the STFT window is applied in floating
+ * point. With HAL_ACQ_FORMAT_INT16 they stay 16-bit fixed point with
+ * STFT_SAMPLE_FRACTION_BITS fraction bits (host/stft.h), the window is
+ * applied in fixed point and only the windowed samples are converted
+ * for the FFT, which halves the acquisition ring and the bytes moved by
+ * both DMAs for every hop. It needs a bitstream with the fixed point
+ * acquisition and STFT pipelines, and the host backend emulates both.
+ */
+
+#define HAL_ACQ_FORMAT_FLOAT 0
+#define HAL_ACQ_FORMAT_INT16 1
+
+#ifndef HAL_ACQ_FORMAT
+#define HAL_ACQ_FORMAT HAL_ACQ_FORMAT_FLOAT
+#endif
+
+#if HAL_ACQ_FORMAT == HAL_ACQ_FORMAT_INT16
+#define HAL_ACQ_DT int16_t
+#else
+#define HAL_ACQ_DT float
+#endif
+
+#define HAL_ACQ_SAMPLE_RATE 16000
+
+int hal_init();
+
+/*
+ * Returns false when the backend has no more input to process. The
+ * board backend always returns true.
+ */
+
+bool hal_is_running();
+
+/*
+ * Called by the main loop whenever it has no events to dispatch. The
+ * board backend does nothing.
+ */
+
+void hal_idle();
+
+/*
+ * Base and size of DDR memory that is visible to DMAs and the TCU.
+ */
+
+#define HAL_DDR_SIZE 0x10000000
+
+u8 *hal_get_ddr_base();
+
+/*
+ * Reads `size` bytes at `offset` from the start of flash into `ptr`.
+ */
+
+int hal_flash_read(size_t offset, u8 *ptr, size_t size);
+
+/*
+ * Value for DRAM0 and DRAM1 offset configuration registers of the TCU
+ * that points to the buffer at `ptr`.
+ */
+
+size_t hal_get_dram_offset(const u8 *ptr);
+
+/*
+ * Free-running timer used for profiling. Ticks wrap around at 32 bits.
+ * Returns zero ticks per second when there is no timer.
+ */
+
+u32 hal_get_ticks();
+u32 hal_get_ticks_per_second();
+
+/*
+ * Returns the next character received by the UART or -1 when none is
+ * pending.
+ */
+
+int hal_uart_get_char();
+
+/*
+ * Queues the character for transmission by the UART. Returns false
+ * without waiting when the transmit FIFO is full.
+ */
+
+bool hal_uart_put_char(u8 c);
+
+void hal_set_leds(int leds);
+void hal_set_motor_direction(int direction);
+
+int hal_motor_init();
+void hal_set_motor_pwm(u32 period, u32 high_period);
+
+/*
+ * Acquisition DMA transfers one packet of HAL_ACQ_DT samples from
+ * the microphone to DDR.
+ */
+
+int hal_acq_init();
+void hal_acq_release_reset();
+int hal_acq_start(u8 *ptr, size_t size);
+bool hal_acq_is_busy();
+
+/*
+ * STFT DMA transfers two halves of the sliding window (TX) and
+ * receives one STFT line (RX) using scatter-gather descriptors placed
+ * at `rx_bd_space` and `tx_bd_space`.
+ *
+ * Descriptors form a ring of `depth` hops. Each hop is built once by
+ * `hal_stft_prepare` and recycled as is whenever the ring comes back
+ * to it. `hal_stft_start` submits the next hop of the ring without
+ * waiting for it. `hal_stft_poll` collects the hops completed since the
+ * last poll, in the order they were submitted, releases their
+ * descriptors and adds their number to `*hops`.
+ *
+ * Descriptors take HAL_STFT_BD_SIZE bytes each, one per hop for RX and
+ * two for TX, and their space is aligned to HAL_STFT_BD_ALIGNMENT, so
+ * that it can be laid out at compile time.
+ */
+
+#define HAL_STFT_BD_SIZE 64
+#define HAL_STFT_BD_ALIGNMENT 64
+#define HAL_STFT_RX_BD_SPACE_SIZE(depth) ((depth) * HAL_STFT_BD_SIZE)
+#define HAL_STFT_TX_BD_SPACE_SIZE(depth) (2 * (depth) * HAL_STFT_BD_SIZE)
+
+int hal_stft_init(u8 *rx_bd_space, u8 *tx_bd_space, size_t depth);
+int hal_stft_prepare(size_t hop, u8 *tx_first_ptr, u8 *tx_second_ptr,
+                     size_t tx_size, u8 *rx_ptr, size_t rx_size);
+int hal_stft_start();
+int hal_stft_poll(size_t *hops);
+
+tensil_error_t hal_tcu_init();
+size_t hal_tcu_get_instructions_data_width_bytes();
+tensil_error_t
+hal_tcu_start_instructions(struct tensil_instruction_buffer *buffer,
+                           size_t *run_offset);
+bool hal_tcu_is_instructions_busy();
@@ -0,0 +1,334 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include "xaxidma.h"
+#include "xgpio_l.h"
+#include "xparameters.h"
+#include "xtmrctr.h"
+#include "xuartlite_l.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal.h"
+#include "tensil/instruction.h"
+#include "tensil/tcu.h"
+
+XAxiDma acq_axi_dma;
+XAxiDma stft_axi_dma;
+
+XTmrCtr tmr_ctr_motor0;
+XTmrCtr tmr_ctr_motor1;
+
+/*
+ * Profiling needs an AXI timer named profile_timer_0 in the Vivado
+ * design. Without it the profile is disabled.
+ */
+
+#ifdef XPAR_PROFILE_TIMER_0_DEVICE_ID
+XTmrCtr tmr_ctr_profile;
+#endif
+
+struct tensil_compute_unit tcu;
+
+static XAxiDma_BdRing *stft_rx_ring_ptr;
+static XAxiDma_BdRing *stft_tx_ring_ptr;
+
+int hal_init() {
+#ifdef XPAR_PROFILE_TIMER_0_DEVICE_ID
+    int status =
+        XTmrCtr_Initialize(&tmr_ctr_profile, XPAR_PROFILE_TIMER_0_DEVICE_ID);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    XTmrCtr_SetOptions(&tmr_ctr_profile, 0, XTC_AUTO_RELOAD_OPTION);
+    XTmrCtr_SetResetValue(&tmr_ctr_profile, 0, 0);
+    XTmrCtr_Start(&tmr_ctr_profile, 0);
+#endif
+
+    return XST_SUCCESS;
+}
+
+bool hal_is_running() { return true; }
+
+void hal_idle() {}
+
+u8 *hal_get_ddr_base() { return (u8 *)XPAR_MIG7SERIES_0_BASEADDR; }
+
+int hal_flash_read(size_t offset, u8 *ptr, size_t size) {
+    memcpy(ptr, (const u8 *)XPAR_AXI_QUAD_SPI_0_AXI4_BASEADDR + offset, size);
+
+    return XST_SUCCESS;
+}
+
+size_t hal_get_dram_offset(const u8 *ptr) {
+    return TENSIL_CONFIG_DRAM_OFFSET(ptr);
+}
+
+u32 hal_get_ticks() {
+#ifdef XPAR_PROFILE_TIMER_0_DEVICE_ID
+    return XTmrCtr_GetValue(&tmr_ctr_profile, 0);
+#else
+    return 0;
+#endif
+}
+
+u32 hal_get_ticks_per_second() {
+#ifdef XPAR_PROFILE_TIMER_0_DEVICE_ID
+    return XPAR_PROFILE_TIMER_0_CLOCK_FREQ_HZ;
+#else
+    return 0;
+#endif
+}
+
+int hal_uart_get_char() {
+    if (XUartLite_IsReceiveEmpty(XPAR_UARTLITE_0_BASEADDR))
+        return -1;
+
+    return XUartLite_RecvByte(XPAR_UARTLITE_0_BASEADDR);
+}
+
+bool hal_uart_put_char(u8 c) {
+    if (XUartLite_IsTransmitFull(XPAR_UARTLITE_0_BASEADDR))
+        return false;
+
+    XUartLite_WriteReg(XPAR_UARTLITE_0_BASEADDR, XUL_TX_FIFO_OFFSET, c);
+
+    return true;
+}
+
+void hal_set_leds(int leds) {
+    XGpio_WriteReg(XPAR_LED_GPIO_0_BASEADDR, XGPIO_DATA_OFFSET, leds);
+}
+
+void hal_set_motor_direction(int direction) {
+    XGpio_WriteReg(XPAR_MOTOR_DIR_GPIO_0_BASEADDR, XGPIO_DATA_OFFSET,
+                   direction);
+}
+
+int hal_motor_init() {
+    int status =
+        XTmrCtr_Initialize(&tmr_ctr_motor0, XPAR_MOTOR_EN_TIMER_0_DEVICE_ID);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    return XTmrCtr_Initialize(&tmr_ctr_motor1,
+                              XPAR_MOTOR_EN_TIMER_1_DEVICE_ID);
+}
+
+void hal_set_motor_pwm(u32 period, u32 high_period) {
+    XTmrCtr_PwmDisable(&tmr_ctr_motor0);
+    XTmrCtr_PwmDisable(&tmr_ctr_motor1);
+
+    if (high_period) {
+        XTmrCtr_PwmConfigure(&tmr_ctr_motor0, period, high_period);
+        XTmrCtr_PwmConfigure(&tmr_ctr_motor1, period, high_period);
+
+        XTmrCtr_PwmEnable(&tmr_ctr_motor0);
+        XTmrCtr_PwmEnable(&tmr_ctr_motor1);
+    }
+}
+
+int hal_acq_init() {
+    XAxiDma_Config *acq_cfg_ptr =
+        XAxiDma_LookupConfig(XPAR_ACQUISITION_AXI_DMA_0_DEVICE_ID);
+
+    return XAxiDma_CfgInitialize(&acq_axi_dma, acq_cfg_ptr);
+}
+
+void hal_acq_release_reset() {
+    XGpio_WriteReg(XPAR_ACQUISITION_AXI_GPIO_0_BASEADDR, XGPIO_DATA_OFFSET,
+                   0x1);
+}
+
+int hal_acq_start(u8 *ptr, size_t size) {
+    return XAxiDma_SimpleTransfer(&acq_axi_dma, (UINTPTR)ptr, size,
+                                  XAXIDMA_DEVICE_TO_DMA);
+}
+
+bool hal_acq_is_busy() {
+    return XAxiDma_Busy(&acq_axi_dma, XAXIDMA_DEVICE_TO_DMA);
+}
+
+_Static_assert(XAxiDma_BdRingMemCalc(XAXIDMA_BD_MINIMUM_ALIGNMENT, 1) ==
+                   HAL_STFT_BD_SIZE,
+               "HAL_STFT_BD_SIZE must be the size of AXI DMA descriptors");
+_Static_assert(HAL_STFT_BD_ALIGNMENT % XAXIDMA_BD_MINIMUM_ALIGNMENT == 0,
+               "HAL_STFT_BD_ALIGNMENT must align AXI DMA descriptors");
+
+int hal_stft_init(u8 *rx_bd_space, u8 *tx_bd_space, size_t depth) {
+    XAxiDma_Config *stft_cfg_ptr =
+        XAxiDma_LookupConfig(XPAR_STFT_AXI_DMA_0_DEVICE_ID);
+    int status = XAxiDma_CfgInitialize(&stft_axi_dma, stft_cfg_ptr);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    stft_rx_ring_ptr = XAxiDma_GetRxRing(&stft_axi_dma);
+    stft_tx_ring_ptr = XAxiDma_GetTxRing(&stft_axi_dma);
+
+    XAxiDma_BdRingIntDisable(stft_rx_ring_ptr, XAXIDMA_IRQ_ALL_MASK);
+    XAxiDma_BdRingIntDisable(stft_tx_ring_ptr, XAXIDMA_IRQ_ALL_MASK);
+
+    XAxiDma_BdRingSetCoalesce(stft_rx_ring_ptr, 1, 0);
+    XAxiDma_BdRingSetCoalesce(stft_tx_ring_ptr, 1, 0);
+
+    status = XAxiDma_BdRingCreate(stft_rx_ring_ptr, (UINTPTR)rx_bd_space,
+                                  (UINTPTR)rx_bd_space,
+                                  XAXIDMA_BD_MINIMUM_ALIGNMENT, depth);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    status = XAxiDma_BdRingCreate(stft_tx_ring_ptr, (UINTPTR)tx_bd_space,
+                                  (UINTPTR)tx_bd_space,
+                                  XAXIDMA_BD_MINIMUM_ALIGNMENT, 2 * depth);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    XAxiDma_Bd bd_template;
+    XAxiDma_BdClear(&bd_template);
+
+    status = XAxiDma_BdRingClone(stft_rx_ring_ptr, &bd_template);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    status = XAxiDma_BdRingClone(stft_tx_ring_ptr, &bd_template);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    status = XAxiDma_BdRingStart(stft_rx_ring_ptr);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    return XAxiDma_BdRingStart(stft_tx_ring_ptr);
+}
+
+/*
+ * Descriptors are allocated from the ring in order, so the hop-th
+ * allocation of RX descriptors, modulo the depth, gets the hop-th
+ * descriptor, and likewise for pairs of TX descriptors. The driver
+ * keeps the buffer address, length and control of a descriptor when it
+ * is freed and clears its status when it is submitted again.
+ */
+
+static XAxiDma_Bd *get_stft_bd(XAxiDma_BdRing *ring_ptr, size_t index) {
+    return (XAxiDma_Bd *)(ring_ptr->FirstBdAddr +
+                          index * ring_ptr->Separation);
+}
+
+int hal_stft_prepare(size_t hop, u8 *tx_first_ptr, u8 *tx_second_ptr,
+                     size_t tx_size, u8 *rx_ptr, size_t rx_size) {
+    int status;
+
+    for (size_t i = 0; i < 2; i++) {
+        XAxiDma_Bd *bd_ptr = get_stft_bd(stft_tx_ring_ptr, 2 * hop + i);
+
+        status = XAxiDma_BdSetBufAddr(
+            bd_ptr, (UINTPTR)(i ? tx_second_ptr : tx_first_ptr));
+
+        if (status != XST_SUCCESS)
+            return status;
+
+        status = XAxiDma_BdSetLength(bd_ptr, tx_size,
+                                     stft_tx_ring_ptr->MaxTransferLen);
+
+        if (status != XST_SUCCESS)
+            return status;
+
+        XAxiDma_BdSetCtrl(bd_ptr, i ? XAXIDMA_BD_CTRL_TXEOF_MASK
+                                    : XAXIDMA_BD_CTRL_TXSOF_MASK);
+        XAxiDma_BdSetId(bd_ptr, hop);
+    }
+
+    XAxiDma_Bd *bd_ptr = get_stft_bd(stft_rx_ring_ptr, hop);
+
+    status = XAxiDma_BdSetBufAddr(bd_ptr, (UINTPTR)rx_ptr);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    status = XAxiDma_BdSetLength(bd_ptr, rx_size,
+                                 stft_rx_ring_ptr->MaxTransferLen);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    XAxiDma_BdSetCtrl(bd_ptr, 0);
+    XAxiDma_BdSetId(bd_ptr, hop);
+
+    return XST_SUCCESS;
+}
+
+int hal_stft_start() {
+    XAxiDma_Bd *bd_ptr;
+    int status = XAxiDma_BdRingAlloc(stft_tx_ring_ptr, 2, &bd_ptr);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    status = XAxiDma_BdRingToHw(stft_tx_ring_ptr, 2, bd_ptr);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    status = XAxiDma_BdRingAlloc(stft_rx_ring_ptr, 1, &bd_ptr);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    return XAxiDma_BdRingToHw(stft_rx_ring_ptr, 1, bd_ptr);
+}
+
+/*
+ * A hop is complete once its line is received. Its TX descriptors
+ * completed before that and are released as they are found.
+ */
+
+int hal_stft_poll(size_t *hops) {
+    XAxiDma_Bd *bd_ptr;
+    int count = XAxiDma_BdRingFromHw(stft_tx_ring_ptr, XAXIDMA_ALL_BDS,
+                                     &bd_ptr);
+
+    if (count) {
+        int status = XAxiDma_BdRingFree(stft_tx_ring_ptr, count, bd_ptr);
+
+        if (status != XST_SUCCESS)
+            return status;
+    }
+
+    count =
+        XAxiDma_BdRingFromHw(stft_rx_ring_ptr, XAXIDMA_ALL_BDS, &bd_ptr);
+
+    if (count) {
+        int status = XAxiDma_BdRingFree(stft_rx_ring_ptr, count, bd_ptr);
+
+        if (status != XST_SUCCESS)
+            return status;
+
+        *hops += count;
+    }
+
+    return XST_SUCCESS;
+}
+
+tensil_error_t hal_tcu_init() { return tensil_compute_unit_init(&tcu); }
+
+size_t hal_tcu_get_instructions_data_width_bytes() {
+    return tensil_compute_unit_get_instructions_data_width_bytes(&tcu);
+}
+
+tensil_error_t
+hal_tcu_start_instructions(struct tensil_instruction_buffer *buffer,
+                           size_t *run_offset) {
+    return tensil_compute_unit_start_instructions(&tcu, buffer, run_offset);
+}
+
+bool hal_tcu_is_instructions_busy() {
+    return tensil_compute_unit_is_instructions_busy(&tcu);
+}
@@ -0,0 +1,297 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <string.h>
+
+#include "image.h"
+#include "xstatus.h"
+
+struct image_stream {
+    image_read_t read;
+    void *context;
+
+    /*
+     * Offset of the next chunk in the image and the end of the section.
+     */
+
+    size_t offset;
+    size_t end;
+
+    u8 chunk[IMAGE_CHUNK_SIZE];
+    size_t position;
+    size_t length;
+
+    u32 bits;
+    u32 bits_length;
+
+    int status;
+};
+
+static void stream_init(struct image_stream *stream, image_read_t read,
+                        void *context, const struct image_section *section) {
+    stream->read = read;
+    stream->context = context;
+    stream->offset = section->offset;
+    stream->end = section->offset + section->stored_size;
+    stream->position = 0;
+    stream->length = 0;
+    stream->bits = 0;
+    stream->bits_length = 0;
+    stream->status = XST_SUCCESS;
+}
+
+/*
+ * Reads the next chunk. Reading past the end of the section fails the
+ * stream, after which zeros are returned.
+ */
+
+static bool stream_refill(struct image_stream *stream) {
+    size_t length = stream->end - stream->offset;
+
+    if (length > IMAGE_CHUNK_SIZE)
+        length = IMAGE_CHUNK_SIZE;
+
+    if (!length || stream->status != XST_SUCCESS) {
+        stream->status = XST_FAILURE;
+        return false;
+    }
+
+    stream->status =
+        stream->read(stream->context, stream->offset, stream->chunk, length);
+    stream->offset += length;
+    stream->position = 0;
+    stream->length = length;
+
+    return stream->status == XST_SUCCESS;
+}
+
+static inline u8 stream_read_byte(struct image_stream *stream) {
+    if (stream->position == stream->length && !stream_refill(stream))
+        return 0;
+
+    return stream->chunk[stream->position++];
+}
+
+static void stream_read_bytes(struct image_stream *stream, u8 *ptr,
+                              size_t size) {
+    while (size) {
+        if (stream->position == stream->length && !stream_refill(stream))
+            return;
+
+        size_t length = stream->length - stream->position;
+
+        if (length > size)
+            length = size;
+
+        memcpy(ptr, stream->chunk + stream->position, length);
+
+        stream->position += length;
+        ptr += length;
+        size -= length;
+    }
+}
+
+static inline u32 stream_read_bits(struct image_stream *stream,
+                                   u32 length) {
+    while (stream->bits_length < length) {
+        stream->bits |= (u32)stream_read_byte(stream) << stream->bits_length;
+        stream->bits_length += 8;
+    }
+
+    u32 value = stream->bits & ((1u << length) - 1);
+
+    stream->bits >>= length;
+    stream->bits_length -= length;
+
+    return value;
+}
+
+/*
+ * Counts one bits up to the terminating zero bit, or up to
+ * IMAGE_RICE_ESCAPE which has no terminating bit.
+ */
+
+static inline u32 stream_read_unary(struct image_stream *stream) {
+    u32 quotient = 0;
+
+    while (true) {
+        if (!stream->bits_length) {
+            stream->bits = stream_read_byte(stream);
+            stream->bits_length = 8;
+        }
+
+        u32 bit = stream->bits & 1;
+
+        stream->bits >>= 1;
+        stream->bits_length--;
+
+        if (!bit || ++quotient == IMAGE_RICE_ESCAPE)
+            return quotient;
+    }
+}
+
+u32 image_get_architecture_checksum(
+    const struct image_architecture *architecture) {
+    const u32 *params = (const u32 *)architecture;
+    u32 hash = 2166136261u;
+
+    for (size_t i = 0; i < sizeof(struct image_architecture) / sizeof(u32);
+         i++)
+        for (size_t j = 0; j < sizeof(u32); j++) {
+            hash ^= (params[i] >> (8 * j)) & 0xff;
+            hash *= 16777619u;
+        }
+
+    return hash;
+}
+
+int image_read_header(image_read_t read, void *context,
+                      struct image_header *header) {
+    int status = read(context, 0, (u8 *)header, sizeof(struct image_header));
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    if (header->magic != IMAGE_MAGIC || header->version != IMAGE_VERSION)
+        return XST_FAILURE;
+
+    struct image_manifest *manifest = &header->manifest;
+
+    if (manifest->output_length > IMAGE_MAX_CLASSES ||
+        !manifest->batch_size ||
+        memchr(manifest->name, 0, IMAGE_NAME_SIZE) == NULL)
+        return XST_FAILURE;
+
+    for (size_t i = 0; i < manifest->output_length; i++)
+        if (memchr(manifest->labels[i], 0, IMAGE_LABEL_SIZE) == NULL)
+            return XST_FAILURE;
+
+    return XST_SUCCESS;
+}
+
+static size_t read_length(struct image_stream *stream, size_t length) {
+    if (length == 15) {
+        u8 value;
+
+        do {
+            value = stream_read_byte(stream);
+            length += value;
+        } while (value == 255 && stream->status == XST_SUCCESS);
+    }
+
+    return length;
+}
+
+static int unpack_instructions(struct image_stream *stream,
+                               const struct image_section *section, u8 *ptr) {
+    size_t size = section->size;
+    size_t instruction_size = section->parameter;
+    size_t position = 0;
+
+    if (!instruction_size || size % instruction_size)
+        return XST_FAILURE;
+
+    while (position < size) {
+        u8 token = stream_read_byte(stream);
+        size_t literals = read_length(stream, token >> 4);
+
+        if (literals > size - position)
+            return XST_FAILURE;
+
+        stream_read_bytes(stream, ptr + position, literals);
+        position += literals;
+
+        if (position == size)
+            break;
+
+        size_t offset = stream_read_byte(stream);
+        offset |= (size_t)stream_read_byte(stream) << 8;
+
+        size_t match = read_length(stream, token & 0xf) + IMAGE_LZ_MIN_MATCH;
+
+        if (stream->status != XST_SUCCESS || !offset || offset > position ||
+            match > size - position)
+            return XST_FAILURE;
+
+        /*
+         * The match can overlap the bytes it writes, so that a run is a
+         * match at the offset of its period.
+         */
+
+        for (size_t i = 0; i < match; i++, position++)
+            ptr[position] = ptr[position - offset];
+    }
+
+    if (stream->status != XST_SUCCESS)
+        return stream->status;
+
+    /*
+     * Replace residuals with instructions in place. Instructions before
+     * the second period are stored as they are.
+     */
+
+    size_t period = IMAGE_INSTRUCTION_PERIOD * instruction_size;
+
+    for (size_t i = 2 * period; i < size; i++)
+        ptr[i] += 2 * ptr[i - period] - ptr[i - 2 * period];
+
+    return XST_SUCCESS;
+}
+
+static int unpack_weights(struct image_stream *stream,
+                          const struct image_section *section, u8 *ptr) {
+    size_t length = section->size / sizeof(int16_t);
+    int16_t *values = (int16_t *)ptr;
+
+    if (section->size % sizeof(int16_t))
+        return XST_FAILURE;
+
+    for (size_t i = 0; i < length; i += IMAGE_RICE_BLOCK_LENGTH) {
+        u32 parameter = stream_read_bits(stream, IMAGE_RICE_PARAMETER_BITS);
+        size_t block_length = length - i;
+
+        if (block_length > IMAGE_RICE_BLOCK_LENGTH)
+            block_length = IMAGE_RICE_BLOCK_LENGTH;
+
+        for (size_t j = 0; j < block_length; j++) {
+            u32 quotient = stream_read_unary(stream);
+            u32 value =
+                quotient == IMAGE_RICE_ESCAPE
+                    ? stream_read_bits(stream, 16)
+                    : (quotient << parameter) |
+                          stream_read_bits(stream, parameter);
+
+            values[i + j] = (int16_t)((value >> 1) ^ -(value & 1));
+        }
+    }
+
+    return stream->status;
+}
+
+int image_unpack(image_read_t read, void *context,
+                 const struct image_section *section, u8 *ptr,
+                 size_t capacity) {
+    struct image_stream stream;
+
+    if (section->size > capacity)
+        return XST_FAILURE;
+
+    switch (section->codec) {
+    case IMAGE_CODEC_STORED:
+        if (section->stored_size != section->size)
+            return XST_FAILURE;
+
+        return read(context, section->offset, ptr, section->size);
+
+    case IMAGE_CODEC_INSTRUCTIONS:
+        stream_init(&stream, read, context, section);
+        return unpack_instructions(&stream, section, ptr);
+
+    case IMAGE_CODEC_WEIGHTS:
+        stream_init(&stream, read, context, section);
+        return unpack_weights(&stream, section, ptr);
+
+    default:
+        return XST_FAILURE;
+    }
+}
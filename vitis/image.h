@@ -0,0 +1,177 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xil_types.h"
+
+/*
+ * Packed flash image of the model. The image starts with a header that
+ * describes its sections, the program, the constants and the keyword
+ * detector, each stored with one of the codecs below at an offset from
+ * the start of the image. The detector section holds the parameters in
+ * detector.h of the first stage of the cascade, stored as they are, and
+ * is empty when the model runs on every window. Sections are unpacked
+ * in a single pass over the flash, reading it in chunks of
+ * IMAGE_CHUNK_SIZE bytes, and written directly to their destination in
+ * DDR.
+ *
+ * IMAGE_CODEC_INSTRUCTIONS is for the program. Compiled programs are
+ * runs of the same few instructions with fields that advance by a
+ * constant step, so each byte of an instruction is predicted from the
+ * same byte IMAGE_INSTRUCTION_PERIOD and twice that instructions back
+ * by linear extrapolation. The residuals are mostly zero and repeat,
+ * so they are compressed with LZ77 in the format of LZ4 blocks: a token
+ * with 4-bit literal and match lengths extended by bytes of 255, the
+ * literals, a 16-bit offset and a minimum match of IMAGE_LZ_MIN_MATCH.
+ * Matches are copied from the residuals already written to the
+ * destination, which is converted back to instructions once complete.
+ *
+ * IMAGE_CODEC_WEIGHTS is for the FP16BP8 constants. Weights are close
+ * to zero but differences of neighbours are not, so values are coded
+ * directly, zigzag mapped to unsigned, with Rice codes. Every block of
+ * IMAGE_RICE_BLOCK_LENGTH values starts with its 4-bit Rice parameter.
+ * Quotients of IMAGE_RICE_ESCAPE or more are replaced with the escape
+ * quotient followed by the raw 16-bit value. Bits are read from the
+ * least significant bit of each byte.
+ *
+ * The header also carries the manifest of the model, which the firmware
+ * needs to run it and which is taken from the .tmodel file of the
+ * compiled model rather than built into the firmware. It is checked
+ * against the TCU architecture with a checksum of the architecture
+ * parameters that the model was compiled for.
+ *
+ * All fields are little-endian.
+ */
+
+#define IMAGE_MAGIC 0x4d495253 /* "SRIM" */
+#define IMAGE_VERSION 4
+
+#define IMAGE_CHUNK_SIZE 256
+
+#define IMAGE_INSTRUCTION_PERIOD 3
+#define IMAGE_LZ_MIN_MATCH 4
+#define IMAGE_LZ_MAX_OFFSET 0xffff
+
+#define IMAGE_RICE_BLOCK_LENGTH 64
+#define IMAGE_RICE_PARAMETER_BITS 4
+#define IMAGE_RICE_ESCAPE 24
+
+#define IMAGE_NAME_SIZE 48
+#define IMAGE_MAX_CLASSES 16
+#define IMAGE_LABEL_SIZE 12
+
+#define IMAGE_DATA_TYPE_FP16BP8 1
+
+enum image_codec {
+    IMAGE_CODEC_STORED = 0,
+    IMAGE_CODEC_INSTRUCTIONS = 1,
+    IMAGE_CODEC_WEIGHTS = 2,
+};
+
+enum image_section_kind {
+    IMAGE_SECTION_PROG = 0,
+    IMAGE_SECTION_CONSTS,
+    IMAGE_SECTION_DETECTOR,
+    IMAGE_SECTIONS,
+};
+
+/*
+ * For IMAGE_CODEC_INSTRUCTIONS `parameter` is the instruction size in
+ * bytes and `size` must be a multiple of it. Sizes are in bytes.
+ */
+
+struct image_section {
+    u32 codec;
+    u32 parameter;
+    u32 offset;
+    u32 stored_size;
+    u32 size;
+};
+
+/*
+ * TCU architecture parameters as in the .tarch file, of which only the
+ * checksum is stored.
+ */
+
+struct image_architecture {
+    u32 data_type;
+    u32 array_size;
+    u32 dram0_depth;
+    u32 dram1_depth;
+    u32 local_depth;
+    u32 accumulator_depth;
+    u32 simd_registers_depth;
+    u32 stride0_depth;
+    u32 stride1_depth;
+};
+
+/*
+ * Offsets are in DRAM0 vectors. `input_offset` is where the resize
+ * layer, the first `resize_length` instructions of the program, writes
+ * the `input_height` by `input_width` model input, and `output_offset`
+ * is where the program leaves `output_length` logits. Models compiled
+ * for a batch of `batch_size` windows take the input of each window
+ * after that of the previous one, and leave the logits of each window
+ * in the vectors following those of the previous one. Class labels are
+ * zero terminated. Probability thresholds are in 1/65536 units, and
+ * classes with a zero threshold are never decided on.
+ */
+
+struct image_manifest {
+    char name[IMAGE_NAME_SIZE];
+    u32 architecture_checksum;
+    u32 input_offset;
+    u32 input_height;
+    u32 input_width;
+    u32 resize_length;
+    u32 output_offset;
+    u32 output_length;
+    u32 batch_size;
+    char labels[IMAGE_MAX_CLASSES][IMAGE_LABEL_SIZE];
+    u32 thresholds[IMAGE_MAX_CLASSES];
+};
+
+struct image_header {
+    u32 magic;
+    u32 version;
+    struct image_section sections[IMAGE_SECTIONS];
+    struct image_manifest manifest;
+};
+
+/*
+ * Reads `size` bytes at `offset` from the start of the image into
+ * `ptr`. Returns XST_SUCCESS on success.
+ */
+
+typedef int (*image_read_t)(void *context, size_t offset, u8 *ptr,
+                            size_t size);
+
+/*
+ * Returns the FNV-1a hash of the architecture parameters.
+ */
+
+u32 image_get_architecture_checksum(
+    const struct image_architecture *architecture);
+
+/*
+ * Reads and checks the header. Returns XST_FAILURE when the image does
+ * not start with a header of this version or its manifest is malformed.
+ */
+
+int image_read_header(image_read_t read, void *context,
+                      struct image_header *header);
+
+/*
+ * Unpacks the section into `ptr`, which has room for `capacity` bytes.
+ * Returns XST_FAILURE when it does not fit or the stored data is
+ * malformed.
+ */
+
+int image_unpack(image_read_t read, void *context,
+                 const struct image_section *section, u8 *ptr,
+                 size_t capacity);
@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include "log.h"
+#include "hal.h"
+
+void log_init(struct log *log, const char *const *names,
+              size_t names_length) {
+    log->head = 0;
+    log->tail = 0;
+    log->dropped = 0;
+    log->binary = false;
+    log->names = names;
+    log->names_length = names_length;
+    log->line_length = 0;
+    log->line_offset = 0;
+}
+
+void log_set_names(struct log *log, const char *const *names,
+                   size_t names_length) {
+    log->names = names;
+    log->names_length = names_length;
+}
+
+void log_write(struct log *log, enum log_type type, u8 index, u16 value) {
+    u32 head = log->head;
+
+    if (head - log->tail == LOG_RING_LENGTH) {
+        log->dropped++;
+        return;
+    }
+
+    struct log_record *record = &log->records[head % LOG_RING_LENGTH];
+
+    record->ticks = hal_get_ticks();
+    record->type = type;
+    record->index = index;
+    record->value = value;
+
+    /*
+     * The record must be complete before the consumer can see it.
+     */
+
+    __sync_synchronize();
+
+    log->head = head + 1;
+}
+
+static size_t append_string(char *line, size_t length, const char *s) {
+    while (*s)
+        line[length++] = *s++;
+
+    return length;
+}
+
+static size_t append_number(char *line, size_t length, u32 number,
+                            size_t digits) {
+    char buffer[10];
+    size_t i = 0;
+
+    do {
+        buffer[i++] = '0' + number % 10;
+        number /= 10;
+    } while (number || i < digits);
+
+    while (i)
+        line[length++] = buffer[--i];
+
+    return length;
+}
+
+static size_t format_text(const struct log *log,
+                          const struct log_record *record, char *line) {
+    size_t length = 0;
+
+    switch (record->type) {
+    case LOG_TYPE_PREDICTION: {
+        u8 index = record->index & ~LOG_FLAG_ACTION;
+
+        length = append_string(line, length, "0.");
+        length = append_number(line, length,
+                               (u32)record->value * 10000 /
+                                   LOG_PROBABILITY_ONE,
+                               4);
+        length = append_string(line, length, " ");
+        length = append_string(line, length,
+                               index < log->names_length ? log->names[index]
+                                                         : "?");
+
+        if (record->index & LOG_FLAG_ACTION)
+            length = append_string(line, length, " <<<");
+
+        break;
+    }
+    case LOG_TYPE_GATE_OPEN:
+        length = append_string(line, length, "vad: open");
+        break;
+    case LOG_TYPE_GATE_CLOSE:
+        length = append_string(line, length, "vad: closed, ");
+        length = append_number(line, length, record->value, 1);
+        length = append_string(line, length, " skipped");
+        break;
+    case LOG_TYPE_DROP:
+        length = append_string(line, length, "drop: step ");
+        length = append_number(line, length, record->value, 1);
+        length = append_string(line, length, " rows");
+        break;
+    }
+
+    return append_string(line, length, "\r\n");
+}
+
+static size_t format_binary(const struct log_record *record, char *line) {
+    u8 *frame = (u8 *)line;
+
+    frame[0] = LOG_FRAME_SYNC;
+    frame[1] = record->type;
+    frame[2] = record->index;
+    frame[3] = record->value;
+    frame[4] = record->value >> 8;
+
+    for (size_t i = 0; i < 4; i++)
+        frame[5 + i] = record->ticks >> (8 * i);
+
+    u8 sum = 0;
+
+    for (size_t i = 0; i < LOG_FRAME_SIZE - 1; i++)
+        sum += frame[i];
+
+    frame[LOG_FRAME_SIZE - 1] = sum;
+
+    return LOG_FRAME_SIZE;
+}
+
+bool log_drain(struct log *log) {
+    while (true) {
+        if (log->line_offset == log->line_length) {
+            u32 tail = log->tail;
+
+            if (tail == log->head)
+                return true;
+
+            const struct log_record *record =
+                &log->records[tail % LOG_RING_LENGTH];
+
+            log->line_length = log->binary ? format_binary(record, log->line)
+                                           : format_text(log, record, log->line);
+            log->line_offset = 0;
+            log->tail = tail + 1;
+        }
+
+        if (!hal_uart_put_char(log->line[log->line_offset]))
+            return false;
+
+        log->line_offset++;
+    }
+}
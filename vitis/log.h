@@ -0,0 +1,125 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xil_types.h"
+
+/*
+ * Non-blocking log of the main loop events. Writing a record only
+ * stores it in a ring of LOG_RING_LENGTH records. The ring is drained
+ * to the UART by `log_drain`, which formats records one byte at a time
+ * and stops as soon as the UART transmit FIFO is full, so it can be
+ * called while waiting for the next acquisition packet.
+ *
+ * The ring has a single producer and a single consumer. The producer
+ * only writes `head` and the consumer only writes `tail`, so draining
+ * can be moved to an interrupt handler without locks. When the ring is
+ * full records are dropped and counted.
+ *
+ * Records are printed as text lines, or in binary mode as frames of
+ * LOG_FRAME_SIZE bytes: LOG_FRAME_SYNC, the type, the index, the value
+ * and the timestamp in ticks, both little-endian, and the sum of the
+ * preceding bytes modulo 256. host/log_decode.c decodes binary frames.
+ */
+
+#define LOG_RING_LENGTH 64
+
+#define LOG_FRAME_SYNC 0xa5
+#define LOG_FRAME_SIZE 10
+
+#if LOG_RING_LENGTH & (LOG_RING_LENGTH - 1)
+#error "LOG_RING_LENGTH must be a power of two"
+#endif
+
+/*
+ * Probabilities are logged in units of 1 / LOG_PROBABILITY_ONE and
+ * saturated to 16 bits.
+ */
+
+#define LOG_PROBABILITY_ONE 0x10000
+
+enum log_type {
+
+    /*
+     * Index is the predicted command and value is its probability.
+     * LOG_FLAG_ACTION is set in the index when the prediction moved the
+     * robot.
+     */
+
+    LOG_TYPE_PREDICTION = 0,
+
+    /*
+     * Voice activity gate opened or closed. Value is the number of
+     * windows skipped by the gate so far.
+     */
+
+    LOG_TYPE_GATE_OPEN,
+    LOG_TYPE_GATE_CLOSE,
+
+    /*
+     * Window was not started in time. Value is the new step between
+     * windows in rows.
+     */
+
+    LOG_TYPE_DROP,
+};
+
+#define LOG_FLAG_ACTION 0x80
+
+struct log_record {
+    u32 ticks;
+    u8 type;
+    u8 index;
+    u16 value;
+};
+
+struct log {
+    struct log_record records[LOG_RING_LENGTH];
+
+    volatile u32 head;
+    volatile u32 tail;
+
+    u32 dropped;
+    bool binary;
+
+    const char *const *names;
+    size_t names_length;
+
+    /*
+     * Bytes of the record being transmitted.
+     */
+
+    char line[32];
+    size_t line_length;
+    size_t line_offset;
+};
+
+/*
+ * Initializes the log with the names of predicted commands.
+ */
+
+void log_init(struct log *log, const char *const *names,
+              size_t names_length);
+
+/*
+ * Replaces the names of predicted commands when the model changes.
+ * Records are formatted with the names when they are drained, so the
+ * ring must be drained before the names change.
+ */
+
+void log_set_names(struct log *log, const char *const *names,
+                   size_t names_length);
+
+void log_write(struct log *log, enum log_type type, u8 index, u16 value);
+
+/*
+ * Transmits pending bytes until the ring is empty or the UART cannot
+ * take more. Returns true when everything has been transmitted.
+ */
+
+bool log_drain(struct log *log);
@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <string.h>
+
+#include "hal.h"
+#include "profile.h"
+#include "xil_printf.h"
+
+static const char *stage_names[PROFILE_STAGE_LENGTH] = {
+    "acq", "stft", "resize", "tcu", "softmax", "wait"};
+
+void profile_init(struct profile *profile, u32 ticks_per_second,
+                  u32 period_us) {
+    profile->ticks_per_us = ticks_per_second / 1000000;
+    profile->period_ticks = period_us * profile->ticks_per_us;
+
+    profile_reset(profile);
+}
+
+void profile_reset(struct profile *profile) {
+    memset(profile->stages, 0, sizeof(profile->stages));
+    memset(&profile->slack, 0, sizeof(profile->slack));
+    memset(profile->histogram, 0, sizeof(profile->histogram));
+
+    profile->overruns = 0;
+}
+
+static void add_sample(struct profile_stats *stats, u32 value) {
+    if (!stats->count || value < stats->min)
+        stats->min = value;
+
+    if (value > stats->max)
+        stats->max = value;
+
+    stats->count++;
+    stats->total += value;
+}
+
+void profile_start(struct profile *profile) {
+    profile->start_ticks = hal_get_ticks();
+    profile->mark_ticks = profile->start_ticks;
+}
+
+void profile_mark(struct profile *profile, enum profile_stage stage) {
+    u32 ticks = hal_get_ticks();
+
+    /*
+     * Unsigned difference is correct across the timer wrap around.
+     */
+
+    add_sample(&profile->stages[stage], ticks - profile->mark_ticks);
+
+    profile->mark_ticks = ticks;
+}
+
+void profile_end(struct profile *profile) {
+    u32 ticks = hal_get_ticks();
+
+    /*
+     * Time since the last mark is not part of any stage. The next mark
+     * closes the wait for the packet.
+     */
+
+    profile->mark_ticks = ticks;
+
+    if (!profile->period_ticks)
+        return;
+
+    u32 work_ticks = ticks - profile->start_ticks;
+
+    if (work_ticks > profile->period_ticks) {
+        profile->overruns++;
+
+        return;
+    }
+
+    u32 slack_ticks = profile->period_ticks - work_ticks;
+
+    add_sample(&profile->slack, slack_ticks);
+
+    size_t bucket =
+        (u64)slack_ticks * PROFILE_HISTOGRAM_BUCKETS / profile->period_ticks;
+
+    if (bucket >= PROFILE_HISTOGRAM_BUCKETS)
+        bucket = PROFILE_HISTOGRAM_BUCKETS - 1;
+
+    profile->histogram[bucket]++;
+}
+
+static void print_stats(const char *name, const struct profile_stats *stats,
+                        u32 ticks_per_us) {
+    u32 average = stats->count ? stats->total / stats->count : 0;
+
+    xil_printf("%8s %8d %8d %8d %8d\r\n", name, (int)stats->count,
+               (int)(stats->min / ticks_per_us),
+               (int)(average / ticks_per_us),
+               (int)(stats->max / ticks_per_us));
+}
+
+void profile_print(const struct profile *profile) {
+    if (!profile->period_ticks) {
+        print("profile: no timer\r\n");
+        return;
+    }
+
+    xil_printf("%8s %8s %8s %8s %8s\r\n", "us", "count", "min", "avg",
+               "max");
+
+    for (size_t i = 0; i < PROFILE_STAGE_LENGTH; i++)
+        print_stats(stage_names[i], &profile->stages[i],
+                    profile->ticks_per_us);
+
+    print_stats("slack", &profile->slack, profile->ticks_per_us);
+
+    u32 period_us = profile->period_ticks / profile->ticks_per_us;
+
+    for (size_t i = 0; i < PROFILE_HISTOGRAM_BUCKETS; i++)
+        xil_printf("slack < %5d us: %d\r\n",
+                   (int)((i + 1) * period_us / PROFILE_HISTOGRAM_BUCKETS),
+                   (int)profile->histogram[i]);
+
+    xil_printf("overrun         : %d\r\n", (int)profile->overruns);
+}
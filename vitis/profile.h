@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xil_types.h"
+
+/*
+ * Time spent by the main loop in each of its stages and the slack left
+ * in the acquisition packet period, measured with the free-running
+ * timer of the HAL.
+ *
+ * Each iteration starts with `profile_start`. `profile_mark` closes the
+ * stage that ran since the previous mark. Stages that do not run in an
+ * iteration are not marked and their count is lower. `profile_end` is
+ * called when the work for the packet is done and before waiting for
+ * the next packet, and records the slack: the packet period less the
+ * time since the start of the iteration. Work between the last mark and
+ * `profile_end` is not attributed to a stage. Slack is collected into
+ * PROFILE_HISTOGRAM_BUCKETS buckets over the period. Iterations that
+ * take longer than the period are counted as overruns.
+ */
+
+#define PROFILE_HISTOGRAM_BUCKETS 8
+
+enum profile_stage {
+    PROFILE_STAGE_ACQ = 0,
+    PROFILE_STAGE_STFT,
+    PROFILE_STAGE_RESIZE,
+    PROFILE_STAGE_TCU,
+    PROFILE_STAGE_SOFTMAX,
+    PROFILE_STAGE_WAIT,
+    PROFILE_STAGE_LENGTH,
+};
+
+struct profile_stats {
+    u32 count;
+    u32 min;
+    u32 max;
+    u64 total;
+};
+
+struct profile {
+    u32 period_ticks;
+    u32 ticks_per_us;
+
+    u32 start_ticks;
+    u32 mark_ticks;
+
+    struct profile_stats stages[PROFILE_STAGE_LENGTH];
+    struct profile_stats slack;
+    u32 overruns;
+    u32 histogram[PROFILE_HISTOGRAM_BUCKETS];
+};
+
+/*
+ * Initializes the profile for the packet period in timer ticks. The
+ * profile is disabled when the HAL has no timer and `ticks_per_second`
+ * is zero.
+ */
+
+void profile_init(struct profile *profile, u32 ticks_per_second,
+                  u32 period_us);
+
+void profile_reset(struct profile *profile);
+
+void profile_start(struct profile *profile);
+void profile_mark(struct profile *profile, enum profile_stage stage);
+void profile_end(struct profile *profile);
+
+/*
+ * Prints stage times and slack in microseconds and the slack histogram
+ * to the UART.
+ */
+
+void profile_print(const struct profile *profile);
@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include "resize.h"
+
+#define RESIZE_FRACTION_BITS 8
+
+static void init_tap(struct resize_tap *tap, size_t i, size_t source_size,
+                     size_t size) {
+
+    /*
+     * Source coordinate of output pixel i is (i + 0.5) * source_size /
+     * size - 0.5, which is kept as a fraction with denominator 2 * size.
+     */
+
+    int numerator = (int)((2 * i + 1) * source_size) - (int)size;
+    int denominator = 2 * size;
+
+    if (numerator < 0)
+        numerator = 0;
+
+    size_t first = numerator / denominator;
+    size_t fraction = numerator % denominator;
+
+    tap->first = first;
+    tap->second = first + 1 < source_size ? first + 1 : source_size - 1;
+    tap->first_weight = denominator - fraction;
+    tap->second_weight = fraction;
+}
+
+void resize_init(struct resize *resize, size_t source_height,
+                 size_t source_width) {
+    for (size_t i = 0; i < RESIZE_HEIGHT; i++)
+        init_tap(&resize->rows[i], i, source_height, RESIZE_HEIGHT);
+
+    for (size_t i = 0; i < RESIZE_WIDTH; i++)
+        init_tap(&resize->columns[i], i, source_width, RESIZE_WIDTH);
+}
+
+static s32 get_weight(u32 row_weight, u32 column_weight) {
+    u32 scale = 4 * RESIZE_HEIGHT * RESIZE_WIDTH;
+
+    return (row_weight * column_weight * (1 << RESIZE_FRACTION_BITS) +
+            scale / 2) /
+           scale;
+}
+
+static s32 multiply(RESIZE_DT value, s32 weight) {
+    return ((s32)value * weight + (1 << (RESIZE_FRACTION_BITS - 1))) >>
+           RESIZE_FRACTION_BITS;
+}
+
+void resize_row(const struct resize *resize, size_t row,
+                const RESIZE_DT *first_line, const RESIZE_DT *second_line,
+                int stride, RESIZE_DT *dest, size_t dest_stride) {
+    const struct resize_tap *row_tap = &resize->rows[row];
+
+    for (size_t j = 0; j < RESIZE_WIDTH; j++) {
+        const struct resize_tap *column_tap = &resize->columns[j];
+        int first = column_tap->first * stride;
+        int second = column_tap->second * stride;
+
+        s32 value =
+            multiply(first_line[first], get_weight(row_tap->first_weight,
+                                                   column_tap->first_weight)) +
+            multiply(second_line[first],
+                     get_weight(row_tap->second_weight,
+                                column_tap->first_weight)) +
+            multiply(first_line[second],
+                     get_weight(row_tap->first_weight,
+                                column_tap->second_weight)) +
+            multiply(second_line[second],
+                     get_weight(row_tap->second_weight,
+                                column_tap->second_weight));
+
+        if (value > INT16_MAX)
+            value = INT16_MAX;
+        else if (value < INT16_MIN)
+            value = INT16_MIN;
+
+        dest[j * dest_stride] = value;
+    }
+}
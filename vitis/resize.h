@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xil_types.h"
+
+/*
+ * Bilinear resize of the spectrogram to the RESIZE_HEIGHT by
+ * RESIZE_WIDTH model input, as done by `layers.Resizing(32, 32)` at
+ * the start of the speech commands model.
+ *
+ * https://github.com/petrohi/speech-robot/blob/main/model/speech_commands.ipynb
+ *
+ * Output pixels are sampled at half-pixel centers. Each output row and
+ * column is described by a tap of two source indices and their weights
+ * in units of 1 / (2 * size). The weight of each of the four source
+ * pixels is the product of its row and column weights rounded to
+ * FP16BP8, and the products with source pixels are rounded to nearest
+ * with ties up. This is the same arithmetic as the resize layer in the
+ * compiled TCU program, so the output is bit-exact with it.
+ */
+
+#define RESIZE_DT int16_t
+
+#define RESIZE_HEIGHT 32
+#define RESIZE_WIDTH 32
+
+struct resize_tap {
+    u16 first;
+    u16 second;
+    u16 first_weight;
+    u16 second_weight;
+};
+
+struct resize {
+    struct resize_tap rows[RESIZE_HEIGHT];
+    struct resize_tap columns[RESIZE_WIDTH];
+};
+
+void resize_init(struct resize *resize, size_t source_height,
+                 size_t source_width);
+
+/*
+ * Computes output row `row` from the two source lines given by
+ * `resize->rows[row]`. Source column j is at `first_line[j * stride]`
+ * and `second_line[j * stride]`, where `stride` can be negative.
+ * Output column j is written to `dest[j * dest_stride]`.
+ */
+
+void resize_row(const struct resize *resize, size_t row,
+                const RESIZE_DT *first_line, const RESIZE_DT *second_line,
+                int stride, RESIZE_DT *dest, size_t dest_stride);
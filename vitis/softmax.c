@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include "softmax.h"
+
+#define SOFTMAX_EXP_ROUND (1 << (SOFTMAX_EXP_FRACTION_BITS - 1))
+
+/*
+ * e^-i, e^(-i/16) and e^(-i/256) with SOFTMAX_EXP_FRACTION_BITS fraction
+ * bits.
+ */
+
+static const u16 exp_integer[SOFTMAX_EXP_INTEGER_LENGTH] = {
+    32768, 12055, 4435, 1631, 600, 221, 81, 30, 11, 4, 1, 1};
+
+static const u16 exp_high[16] = {32768, 30783, 28918, 27166, 25520, 23974,
+                                 22521, 21157, 19875, 18671, 17539, 16477,
+                                 15479, 14541, 13660, 12832};
+
+static const u16 exp_low[16] = {32768, 32640, 32513, 32386, 32260, 32134,
+                                32009, 31884, 31760, 31636, 31513, 31390,
+                                31267, 31146, 31024, 30903};
+
+/*
+ * Returns e^(-d) for d with SOFTMAX_LOGIT_FRACTION_BITS fraction bits.
+ */
+
+static u32 exp_negative(u32 d) {
+    u32 integer = d >> SOFTMAX_LOGIT_FRACTION_BITS;
+
+    if (integer >= SOFTMAX_EXP_INTEGER_LENGTH)
+        return 0;
+
+    u32 e = exp_integer[integer];
+
+    e = (e * exp_high[(d >> 4) & 0xf] + SOFTMAX_EXP_ROUND) >>
+        SOFTMAX_EXP_FRACTION_BITS;
+    e = (e * exp_low[d & 0xf] + SOFTMAX_EXP_ROUND) >>
+        SOFTMAX_EXP_FRACTION_BITS;
+
+    return e;
+}
+
+void softmax_top2(const int16_t *logits, size_t length,
+                  struct softmax_result *result) {
+    size_t first = 0;
+    size_t second = 1;
+
+    if (logits[1] > logits[0]) {
+        first = 1;
+        second = 0;
+    }
+
+    for (size_t i = 2; i < length; i++) {
+        if (logits[i] > logits[first]) {
+            second = first;
+            first = i;
+        } else if (logits[i] > logits[second])
+            second = i;
+    }
+
+    /*
+     * The exponent of the largest logit is one. Every other exponent is
+     * at most one, so the sum fits in a few bits above the fraction.
+     */
+
+    s32 max = logits[first];
+    u32 sum = 0;
+
+    for (size_t i = 0; i < length; i++)
+        sum += exp_negative(max - logits[i]);
+
+    u32 probability =
+        ((exp_negative(0) << SOFTMAX_PROBABILITY_BITS) + sum / 2) / sum;
+    u32 second_probability =
+        ((exp_negative(max - logits[second]) << SOFTMAX_PROBABILITY_BITS) +
+         sum / 2) /
+        sum;
+
+    result->first = first;
+    result->second = second;
+    result->probability = probability;
+    result->margin = probability - second_probability;
+}
@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xil_types.h"
+
+/*
+ * Softmax of the model output fused with the search for the two most
+ * probable classes, in integer arithmetic only.
+ *
+ * Logits are FP16BP8. Each logit is subtracted from the largest one and
+ * the exponent of the difference is looked up in three tables of 16
+ * entries: for its integer part and for the upper and lower 4 bits of
+ * its fraction. Exponents are kept with SOFTMAX_EXP_FRACTION_BITS
+ * fraction bits, so that products of two and the exponent of the
+ * largest logit shifted to probability units fit 32 bits. Differences
+ * of SOFTMAX_EXP_INTEGER_LENGTH or more round to zero.
+ *
+ * Probabilities are in units of 1 / SOFTMAX_PROBABILITY_ONE, and
+ * SOFTMAX_PROBABILITY converts constant thresholds at compile time.
+ */
+
+#define SOFTMAX_LOGIT_FRACTION_BITS 8
+#define SOFTMAX_EXP_FRACTION_BITS 15
+#define SOFTMAX_EXP_INTEGER_LENGTH 12
+
+#define SOFTMAX_PROBABILITY_BITS 16
+#define SOFTMAX_PROBABILITY_ONE (1 << SOFTMAX_PROBABILITY_BITS)
+#define SOFTMAX_PROBABILITY(p) ((u32)((p)*SOFTMAX_PROBABILITY_ONE))
+
+struct softmax_result {
+    size_t first;
+    size_t second;
+
+    /*
+     * Probability of the first class and how much it exceeds the
+     * probability of the second.
+     */
+
+    u32 probability;
+    u32 margin;
+};
+
+/*
+ * Computes the result for `length` logits. The first of equal logits
+ * wins. `length` must be at least 2.
+ */
+
+void softmax_top2(const int16_t *logits, size_t length,
+                  struct softmax_result *result);
@@ -1,21 +1,29 @@
 /* SPDX-License-Identifier: Apache-2.0 */
 /* Copyright © 2019-2022 Tensil AI Company */
 
-#include "xaxidma.h"
-#include "xgpio_l.h"
 #include "xil_printf.h"
-#include "xtmrctr.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "architecture_params.h"
+#include "decision.h"
+#include "detector.h"
+#include "event.h"
+#include "hal.h"
+#include "image.h"
+#include "log.h"
+#include "profile.h"
+#include "resize.h"
+#include "softmax.h"
 #include "tensil/architecture.h"
-#include "tensil/dram.h"
 #include "tensil/error.h"
 #include "tensil/instruction.h"
 #include "tensil/instruction_buffer.h"
-#include "tensil/tcu.h"
+#include "vad.h"
+#include "window_batch.h"
 
 /*
  * Definitions for packet and frame shapes are derived from the
@@ -24,105 +32,349 @@
  * https://github.com/petrohi/speech-robot/blob/main/model/speech_commands.ipynb
  */
 
-#define ACQ_DT float
+#define ACQ_DT HAL_ACQ_DT
 
 #define ACQ_PACKET_LENGTH 128
 #define ACQ_PACKET_SIZE (ACQ_PACKET_LENGTH * sizeof(ACQ_DT))
-#define ACQ_PACKET_DOUBLE_SIZE (2 * ACQ_PACKET_SIZE)
-
-#define STFT_TX_PACKET_SIZE ACQ_PACKET_DOUBLE_SIZE
+#define ACQ_PACKET_PERIOD_US                                                   \
+    (ACQ_PACKET_LENGTH * 1000000 / HAL_ACQ_SAMPLE_RATE)
 
 #define STFT_RX_FRAME_WIDTH (2 * ACQ_PACKET_LENGTH)
 #define STFT_RX_FRAME_LINE_SIZE (STFT_RX_FRAME_WIDTH * sizeof(MODEL_DT))
 #define STFT_RX_FRAME_HEIGHT 124
 #define STFT_RX_FRAME_SIZE (STFT_RX_FRAME_HEIGHT * STFT_RX_FRAME_LINE_SIZE)
 
+/*
+ * Acquisition packets are written into a ring of ACQ_RING_LENGTH
+ * packets, which the STFT DMA reads in place. The packet acquired
+ * during hop i is written to slot i + 1, so that the sliding window of
+ * hop i is in slots i - 1 and i and the ring needs at least three
+ * slots.
+ *
+ * STFT descriptors are prepared once for STFT_RING_DEPTH hops. Hop i
+ * always reads the same slots and writes the same line of the STFT RX
+ * frame, so the depth must be a multiple of both the ring length and
+ * the frame height.
+ *
+ * The acquisition is restarted as soon as a packet completes, together
+ * with the hop of that packet, whether or not the lines of earlier hops
+ * are processed. When the loop falls behind, hops stay in flight and
+ * completed lines queue in the frame. The packet acquired during hop i
+ * overwrites the slot read by hop i - ACQ_RING_LENGTH + 2, so at most
+ * STFT_MAX_HOPS_BUSY hops are in flight. A hop must not overwrite the
+ * line being processed or the line before it, which the resize reads,
+ * so at most STFT_MAX_LINES_AHEAD lines are in flight or queued.
+ */
+
+#define ACQ_RING_LENGTH 4
+#define ACQ_RING_SIZE (ACQ_RING_LENGTH * ACQ_PACKET_SIZE)
+
+#define STFT_RING_DEPTH STFT_RX_FRAME_HEIGHT
+#define STFT_MAX_HOPS_BUSY (ACQ_RING_LENGTH - 2)
+#define STFT_MAX_LINES_AHEAD (STFT_RX_FRAME_HEIGHT - 1)
+
+#if ACQ_RING_LENGTH < 3
+#error "ACQ_RING_LENGTH must be at least 3"
+#endif
+
+#if STFT_RING_DEPTH % ACQ_RING_LENGTH
+#error "STFT_RING_DEPTH must be a multiple of ACQ_RING_LENGTH"
+#endif
+
+#if STFT_RING_DEPTH % STFT_RX_FRAME_HEIGHT
+#error "STFT_RING_DEPTH must be a multiple of STFT_RX_FRAME_HEIGHT"
+#endif
+
 #define MODEL_DT int16_t
 #define MODEL_DT_MIN INT16_MIN
 
 #define MODEL_VECTOR_LENGTH TENSIL_ARCHITECTURE_ARRAY_SIZE
 #define MODEL_VECTOR_SIZE (MODEL_VECTOR_LENGTH * sizeof(MODEL_DT))
 
+/*
+ * The number of windows and the refractory periods can be overridden
+ * on the compiler command line to sweep them in the host emulation.
+ */
+
+#ifndef MODEL_INPUT_WINDOW_NUMBER
 #define MODEL_INPUT_WINDOW_NUMBER 4
+#endif
+
+/*
+ * The model starts with resizing the spectrogram of the lower half of
+ * STFT RX frame to 32 by 32. We do the resize on the fly, one row at a
+ * time as STFT lines arrive, and place the result in DRAM0 where the
+ * resize layer of the compiled program would have written it. The
+ * program is then run from the first instruction past that layer.
+ *
+ * Resized rows are sampled every 124 / 32 = 3.875 STFT lines. A window
+ * of 32 consecutive resized rows is therefore the resize of 124 STFT
+ * lines starting at a row boundary, and each row is computed once for
+ * all windows it belongs to. A new window starts every
+ * MODEL_INPUT_ROW_STEP rows.
+ */
 
-#define MODEL_INPUT_WIDTH (STFT_RX_FRAME_WIDTH / 2 + 1)
+#define SPECTROGRAM_WIDTH (STFT_RX_FRAME_WIDTH / 2 + 1)
+#define SPECTROGRAM_HEIGHT STFT_RX_FRAME_HEIGHT
+
+#define MODEL_INPUT_WIDTH RESIZE_WIDTH
 #define MODEL_INPUT_LINE_SIZE (MODEL_INPUT_WIDTH * MODEL_VECTOR_SIZE)
-#define MODEL_INPUT_HEIGHT STFT_RX_FRAME_HEIGHT
-#define MODEL_INPUT_STEP (MODEL_INPUT_HEIGHT / MODEL_INPUT_WINDOW_NUMBER)
+#define MODEL_INPUT_HEIGHT RESIZE_HEIGHT
+#define MODEL_INPUT_ROW_STEP (MODEL_INPUT_HEIGHT / MODEL_INPUT_WINDOW_NUMBER)
 #define MODEL_INPUT_SIZE (MODEL_INPUT_HEIGHT * MODEL_INPUT_LINE_SIZE)
 
-#define MODEL_OUTPUT_LENGTH 12
+/*
+ * The model input has one channel, so each value occupies the first
+ * position of a channels vector and the rest of the vector is zero.
+ * Rather than writing 7/8 of zeros to DRAM0 we write packed input with
+ * MODEL_VECTOR_LENGTH adjacent values per vector and let the TCU unpack
+ * it into the model input before running the program.
+ *
+ * Packed rows are written once, straight from the resize, into a ring
+ * of MODEL_RING_HEIGHT rows in DRAM0. Each inference reads its window
+ * from the ring in at most two segments. The ring has room for the rows
+ * of one more step, so that rows computed while the TCU is reading the
+ * current window do not overwrite it.
+ *
+ * Windows of a batch wait in the ring until the batch is complete. The
+ * first of them starts at most MODEL_INPUT_HEIGHT rows before the next
+ * one, since the step between windows is never longer than a window, so
+ * the ring has room for that many rows more per window of a batch.
+ * Windows that wait longer, because the TCU is still busy when a
+ * partial batch is started, expire after MODEL_WINDOW_MAX_AGE rows.
+ *
+ * The ring is followed by the unpack weights, which are
+ * MODEL_VECTOR_LENGTH matrices, each selecting one lane into the first
+ * lane, with their bias vector. Both are placed past the model input,
+ * the last DRAM0 vector used by the program, so their offsets depend
+ * on the model and are set when it is loaded.
+ */
+
+#define MODEL_PACKED_INPUT_LINE_SIZE (MODEL_INPUT_WIDTH * sizeof(MODEL_DT))
+#define MODEL_PACKED_INPUT_LINE_VECTORS                                        \
+    (MODEL_INPUT_WIDTH / MODEL_VECTOR_LENGTH)
+#define MODEL_PACKED_INPUT_SIZE_VECTORS                                        \
+    (MODEL_INPUT_HEIGHT * MODEL_PACKED_INPUT_LINE_VECTORS)
+
+#define MODEL_RING_HEIGHT                                                      \
+    (MODEL_INPUT_HEIGHT + MODEL_INPUT_ROW_STEP +                               \
+     (MODEL_MAX_BATCH_SIZE - 1) * MODEL_INPUT_HEIGHT)
+#define MODEL_RING_SIZE (MODEL_RING_HEIGHT * MODEL_PACKED_INPUT_LINE_SIZE)
+#define MODEL_WINDOW_MAX_AGE                                                   \
+    (MODEL_RING_HEIGHT - MODEL_INPUT_HEIGHT - MODEL_INPUT_ROW_STEP)
+#define MODEL_RING_SIZE_VECTORS                                                \
+    (MODEL_RING_HEIGHT * MODEL_PACKED_INPUT_LINE_VECTORS)
+
+#define MODEL_UNPACK_WEIGHTS_LENGTH (MODEL_VECTOR_LENGTH + 1)
+#define MODEL_UNPACK_WEIGHTS_SIZE_VECTORS                                      \
+    (MODEL_VECTOR_LENGTH * MODEL_UNPACK_WEIGHTS_LENGTH)
+
+#if MODEL_INPUT_WIDTH % MODEL_VECTOR_LENGTH
+#error "MODEL_INPUT_WIDTH must be a multiple of MODEL_VECTOR_LENGTH"
+#endif
+
+/*
+ * Models compiled with a batch size infer that many consecutive windows
+ * with a single pass over their weights, up to MODEL_MAX_BATCH_SIZE.
+ * While the input is unpacked, local memory holds the packed windows of
+ * the batch, followed by the unpack weights and by the input of one
+ * window as it is moved from accumulators to DRAM0.
+ */
+
+#define MODEL_MAX_BATCH_SIZE WINDOW_BATCH_MAX_SIZE
+
+#if MODEL_MAX_BATCH_SIZE * MODEL_PACKED_INPUT_SIZE_VECTORS +                   \
+        MODEL_UNPACK_WEIGHTS_SIZE_VECTORS +                                    \
+        MODEL_INPUT_HEIGHT * MODEL_INPUT_WIDTH >                               \
+    TENSIL_ARCHITECTURE_LOCAL_DEPTH
+#error "Local memory must fit the unpack of MODEL_MAX_BATCH_SIZE windows"
+#endif
+
+/*
+ * Each inference is numbered. The CPU writes the number to the first
+ * lanes of the sequence vector before starting the program, and the
+ * last data moves of the program copy it to the completion vector. The
+ * program is complete once the completion vector holds the number of
+ * the inference. Numbers only grow, so the completion vector never
+ * needs to be cleared.
+ */
+
+#define MODEL_SEQUENCE_OFFSET_VECTORS (TENSIL_ARCHITECTURE_DRAM0_DEPTH - 1)
+#define MODEL_COMPLETION_OFFSET_VECTORS (TENSIL_ARCHITECTURE_DRAM0_DEPTH - 2)
+
+/*
+ * Strides in TCU instruction operands are encoded as log2 in the bits
+ * following the address. The address in the second operand (DRAM and
+ * accumulators) takes 17 bits for the memory depths in
+ * ./arch/speech_robot.tarch.
+ */
+
+#define TCU_OPERAND1_STRIDE_SHIFT 17
+
+#define MODEL_VECTOR_LENGTH_LOG2 3
+
+#if MODEL_VECTOR_LENGTH != (1 << MODEL_VECTOR_LENGTH_LOG2)
+#error "MODEL_VECTOR_LENGTH_LOG2 does not match MODEL_VECTOR_LENGTH"
+#endif
+
+#define MODEL_FIXED_POINT_ONE (1 << 8)
+
+#if MODEL_INPUT_HEIGHT % MODEL_INPUT_WINDOW_NUMBER
+#error "MODEL_INPUT_WINDOW_NUMBER must divide MODEL_INPUT_HEIGHT"
+#endif
+
+/*
+ * When a window is due while the previous inference is still running,
+ * OVERRUN_POLICY_SKIP drops it and waits for the next window, while
+ * OVERRUN_POLICY_COALESCE starts an inference on the latest rows as soon
+ * as the TCU is done, so that any number of missed windows become one.
+ * Either way the step between windows is doubled on each overrun, up to
+ * one window per MODEL_INPUT_HEIGHT rows, and halved again after
+ * MODEL_ROW_STEP_RECOVERY_WINDOWS windows started in time.
+ *
+ * A late window is read from the ring after more than
+ * MODEL_INPUT_ROW_STEP rows were written since the previous one. This
+ * only overwrites rows of the previous window, which the TCU reads into
+ * local memory in the first instructions of the program.
+ */
+
+enum overrun_policy {
+    OVERRUN_POLICY_SKIP,
+    OVERRUN_POLICY_COALESCE,
+};
+
+#define MODEL_OVERRUN_POLICY OVERRUN_POLICY_COALESCE
+#define MODEL_ROW_STEP_RECOVERY_WINDOWS 8
 
 /*
- * We place the artifacts produced by `tensil compile` tool
- * in flash image following the FPGA bitstream. The flash offsets
- * for program and consts are determined by sizes of bitstream and
- * program correspondingly to allow for compact flash image.
+ * We place the artifacts produced by `tensil compile` tool in flash
+ * image following the FPGA bitstream, packed into the model image
+ * described in image.h by host/image_pack.c. The image is unpacked
+ * directly into DDR when the model is loaded.
  *
  * Program is the content of speech_commands_onnx_speech_robot.tprog file.
  *
  * Const is the content of speech_commands_onnx_speech_robot.tdata file.
  *
- * Flash sizes are set from `prog.size` and `consts[0].size` in
- * speech_commands_onnx_speech_robot.tmodel file.
+ * The manifest in the image header describes the model: where the
+ * resize layer at the start of the program writes the model input and
+ * how many instructions it takes, where the program leaves the logits,
+ * the class labels and their thresholds. There are MODEL_FLASH_SLOTS
+ * slots for images, so that models of different accuracy and latency
+ * can be flashed side by side. The firmware boots the model in
+ * MODEL_DEFAULT_SLOT, or in the first valid slot when that one is not,
+ * and sending a slot number over the UART switches to the model in it.
  */
 
-#define MODEL_FLASH_PROG_OFFSET 0x400000
-#define MODEL_FLASH_PROG_BASE                                                  \
-    (XPAR_AXI_QUAD_SPI_0_AXI4_BASEADDR + MODEL_FLASH_PROG_OFFSET)
-#define MODEL_FLASH_PROG_SIZE 642464
+#define MODEL_FLASH_SLOT_OFFSET 0x400000
+#define MODEL_FLASH_SLOT_SIZE 0x400000
+#define MODEL_FLASH_SLOTS 3
+
+#ifndef MODEL_DEFAULT_SLOT
+#define MODEL_DEFAULT_SLOT 0
+#endif
 
-#define MODEL_FLASH_CONST_OFFSET 0x500000
-#define MODEL_FLASH_CONST_BASE                                                 \
-    (XPAR_AXI_QUAD_SPI_0_AXI4_BASEADDR + MODEL_FLASH_CONST_OFFSET)
-#define MODEL_FLASH_CONST_SIZE_VECTORS 93937
-#define MODEL_FLASH_CONST_SIZE                                                 \
-    (MODEL_FLASH_CONST_SIZE_VECTORS * TENSIL_ARCHITECTURE_ARRAY_SIZE *         \
-     sizeof(MODEL_DT))
+#define MODEL_MAX_OUTPUT_LENGTH IMAGE_MAX_CLASSES
 
-#define EXP_DT double
+#if MODEL_MAX_OUTPUT_LENGTH > DECISION_MAX_LENGTH
+#error "DECISION_MAX_LENGTH must fit all classes of the model"
+#endif
 
-#define EXP_TX_PACKET_SIZE (MODEL_OUTPUT_LENGTH * sizeof(MODEL_DT))
-#define EXP_RX_PACKET_SIZE (MODEL_OUTPUT_LENGTH * sizeof(EXP_DT))
+#if MODEL_DEFAULT_SLOT >= MODEL_FLASH_SLOTS
+#error "MODEL_DEFAULT_SLOT must be less than MODEL_FLASH_SLOTS"
+#endif
 
-#define BUFFER_ALIGNMENT 0x10000
-#define BUFFER_ALIGN(s) (s / BUFFER_ALIGNMENT + 1) * BUFFER_ALIGNMENT
-#define BUFFER_START ((u8 *)XPAR_MIG7SERIES_0_BASEADDR)
+#if SOFTMAX_PROBABILITY_ONE != LOG_PROBABILITY_ONE
+#error "Probabilities are logged in the units of softmax"
+#endif
 
 #define TENSIL_INSTRUCTION_BUFFER_SIZE 0x100000
 
-static void print_float(EXP_DT f) {
-    if (f < 0.0)
-        print("-");
+/*
+ * Buffers in DDR are laid out at compile time from the table of
+ * regions below, each with its size, alignment and the devices that
+ * access it besides the CPU. Regions touched for every acquisition
+ * packet are marked hot and must come before all others, which is
+ * checked at compile time, so that the small ones are packed together
+ * rather than each taking a 64KB block. DRAM0 is hot too, since the
+ * resized rows are written into its ring as STFT lines arrive, and it
+ * is the last of them. DRAM0 and DRAM1 are aligned to the 64KB blocks
+ * of the TCU offset registers. The regions are the members of `struct
+ * memory_map` in the order of the table, so the compiler computes
+ * their offsets from the start of DDR, keeps them apart and pads only
+ * to the alignment of the next one. The map is printed at boot.
+ *
+ * Every region is accessed by a DMA or the TCU, which cannot reach the
+ * local memory of the CPU, so none of them can be moved out of DDR.
+ */
 
-    int integer = abs((int)f);
-    int fraction = abs((int)((f - (double)integer) * 1e9));
-    xil_printf("%d.%09d", integer, fraction);
-}
+#define MEMORY_DMA 0x1
+#define MEMORY_TCU 0x2
+#define MEMORY_HOT 0x4
+
+#define MEMORY_DMA_ALIGNMENT 64
+#define MEMORY_DRAM_ALIGNMENT 0x10000
+
+#define MEMORY_DRAM0_SIZE                                                      \
+    (TENSIL_ARCHITECTURE_DRAM0_DEPTH * MODEL_VECTOR_SIZE)
+#define MEMORY_DRAM1_SIZE                                                      \
+    (TENSIL_ARCHITECTURE_DRAM1_DEPTH * MODEL_VECTOR_SIZE)
+
+#define MEMORY_REGIONS(REGION)                                                 \
+    REGION(stft_rx_bd_space, HAL_STFT_RX_BD_SPACE_SIZE(STFT_RING_DEPTH),       \
+           HAL_STFT_BD_ALIGNMENT, MEMORY_DMA | MEMORY_HOT)                     \
+    REGION(stft_tx_bd_space, HAL_STFT_TX_BD_SPACE_SIZE(STFT_RING_DEPTH),       \
+           HAL_STFT_BD_ALIGNMENT, MEMORY_DMA | MEMORY_HOT)                     \
+    REGION(acq_ring, ACQ_RING_SIZE, MEMORY_DMA_ALIGNMENT,                      \
+           MEMORY_DMA | MEMORY_HOT)                                            \
+    REGION(stft_rx_buffer, STFT_RX_FRAME_SIZE, MEMORY_DMA_ALIGNMENT,           \
+           MEMORY_DMA | MEMORY_HOT)                                            \
+    REGION(dram0_buffer, MEMORY_DRAM0_SIZE, MEMORY_DRAM_ALIGNMENT,             \
+           MEMORY_TCU | MEMORY_HOT)                                            \
+    REGION(dram1_buffer, MEMORY_DRAM1_SIZE, MEMORY_DRAM_ALIGNMENT, MEMORY_TCU) \
+    REGION(prog_buffer, TENSIL_INSTRUCTION_BUFFER_SIZE, MEMORY_DMA_ALIGNMENT,  \
+           MEMORY_TCU)
+
+#define MEMORY_MEMBER(name, size, alignment, flags)                            \
+    u8 name[size] __attribute__((aligned(alignment)));
+
+struct memory_map {
+    MEMORY_REGIONS(MEMORY_MEMBER)
+};
 
-static size_t argmax(size_t size, const EXP_DT *buffer, EXP_DT *max) {
-    if (!size)
-        return -1;
+_Static_assert(sizeof(struct memory_map) <= HAL_DDR_SIZE,
+               "Buffers must fit DDR");
 
-    *max = buffer[0];
-    size_t max_i = 0;
+#define MEMORY_INDEX(name, size, alignment, flags) MEMORY_INDEX_##name,
 
-    for (size_t i = 1; i < size; i++)
-        if (buffer[i] > *max) {
-            *max = buffer[i];
-            max_i = i;
-        }
+enum memory_index { MEMORY_REGIONS(MEMORY_INDEX) };
 
-    return max_i;
-}
+#define MEMORY_HOT_BIT(name, size, alignment, flags)                           \
+    | ((flags) & MEMORY_HOT ? 1u << MEMORY_INDEX_##name : 0)
+
+#define MEMORY_HOT_MASK (0 MEMORY_REGIONS(MEMORY_HOT_BIT))
+
+_Static_assert((MEMORY_HOT_MASK & (MEMORY_HOT_MASK + 1)) == 0,
+               "Hot regions must come before all other regions");
+
+#define MEMORY_GET_PTR(name)                                                   \
+    (hal_get_ddr_base() + offsetof(struct memory_map, name))
 
-XAxiDma acq_axi_dma;
-XAxiDma stft_axi_dma;
-XAxiDma exp_axi_dma;
+struct memory_region {
+    const char *name;
+    size_t offset;
+    size_t size;
+    u32 flags;
+};
+
+#define MEMORY_REGION(name, size, alignment, flags)                            \
+    {#name, offsetof(struct memory_map, name), size, flags},
 
-const char *commands[MODEL_OUTPUT_LENGTH] = {
-    "down",  "go",   "left", "no",  "off",       "on",
-    "right", "stop", "up",   "yes", "_silence_", "_unknown_"};
+static const struct memory_region memory_regions[] = {
+    MEMORY_REGIONS(MEMORY_REGION)};
+
+#define MEMORY_REGIONS_LENGTH                                                  \
+    (sizeof(memory_regions) / sizeof(struct memory_region))
 
 enum motor_direction {
     MOTOR_DIRECTION_FORWARD = 0x1,
@@ -131,19 +383,25 @@ enum motor_direction {
     MOTOR_DIRECTION_BACKWARD = 0x2,
 };
 
+/*
+ * Commands the robot acts on. Classes of the model are mapped to them
+ * by their labels, and classes with other labels are no command.
+ */
+
 enum command {
-    COMMAND_DOWN = 0,
-    COMMAND_GO = 1,
-    COMMAND_LEFT = 2,
-    COMMAND_NO = 3,
-    COMMAND_OFF = 4,
-    COMMAND_ON = 5,
-    COMMAND_RIGHT = 6,
-    COMMAND_STOP = 7,
-    COMMAND_UP = 8,
-    COMMAND_YES = 9,
-    COMMAND_SILENCE = 10,
-    COMMAND_UNKNOWN = 11,
+    COMMAND_NONE = 0,
+    COMMAND_GO,
+    COMMAND_LEFT,
+    COMMAND_RIGHT,
+    COMMAND_STOP,
+    COMMANDS,
+};
+
+static const char *command_labels[COMMANDS] = {
+    [COMMAND_GO] = "go",
+    [COMMAND_LEFT] = "left",
+    [COMMAND_RIGHT] = "right",
+    [COMMAND_STOP] = "stop",
 };
 
 enum led {
@@ -153,34 +411,41 @@ enum led {
     LED_3 = 0x8,
 };
 
-struct state {
-    XTmrCtr tmr_ctr_motor0;
-    XTmrCtr tmr_ctr_motor1;
+/*
+ * The model that is loaded. Ring and unpack weights offsets are in
+ * DRAM0 vectors past the model input of all windows of a batch, and the
+ * logits of each window take `output_size_vectors`. Labels point into
+ * the manifest. Models with a keyword detector only run on windows that
+ * it passes.
+ */
+
+struct model {
+    size_t slot;
+    struct image_manifest manifest;
+    struct detector_params detector_params;
+    const char *labels[MODEL_MAX_OUTPUT_LENGTH];
+    enum command commands[MODEL_MAX_OUTPUT_LENGTH];
+    size_t ring_offset_vectors;
+    size_t unpack_weights_offset_vectors;
+    size_t output_size_vectors;
+};
 
+struct state {
     enum command current_command;
-    size_t debounce_ticks;
+    const enum command *commands;
+    struct decision decision;
 };
 
 #define PWM_PERIOD 500000
 
-static void set_motor_speed(struct state *state, float speed) {
+static void set_motor_speed(float speed) {
     u32 high_period = (u32)((float)PWM_PERIOD * speed);
 
-    XTmrCtr_PwmDisable(&state->tmr_ctr_motor0);
-    XTmrCtr_PwmDisable(&state->tmr_ctr_motor1);
-
-    if (high_period) {
-        XTmrCtr_PwmConfigure(&state->tmr_ctr_motor0, PWM_PERIOD, high_period);
-        XTmrCtr_PwmConfigure(&state->tmr_ctr_motor1, PWM_PERIOD, high_period);
-
-        XTmrCtr_PwmEnable(&state->tmr_ctr_motor0);
-        XTmrCtr_PwmEnable(&state->tmr_ctr_motor1);
-    }
+    hal_set_motor_pwm(PWM_PERIOD, high_period);
 }
 
 static void set_motor_direction(enum motor_direction direction) {
-    XGpio_WriteReg(XPAR_MOTOR_DIR_GPIO_0_BASEADDR, XGPIO_DATA_OFFSET,
-                   direction);
+    hal_set_motor_direction(direction);
 }
 
 static float get_command_motor_speed(enum command command) {
@@ -205,46 +470,32 @@ static float get_command_motor_direction(enum command command) {
     }
 }
 
-static bool is_known_command(enum command command) {
-    switch (command) {
-    case COMMAND_GO:
-    case COMMAND_LEFT:
-    case COMMAND_RIGHT:
-    case COMMAND_STOP:
-        return true;
-    default:
-        return false;
-    }
-}
+/*
+ * No command is actuated for MIN_REFRACTORY_TICKS after the previous
+ * one, about a quarter of a second. The command that was actuated is
+ * not actuated again while it is still the most probable one, but at
+ * most for the period of 1 full spectogram frame, assuming `tick` is
+ * called for every spectogram line.
+ */
+#ifndef MIN_REFRACTORY_TICKS
+#define MIN_REFRACTORY_TICKS 32
+#endif
 
-static float get_command_probability_threshold(enum command command) {
-    switch (command) {
-    case COMMAND_GO:
-        return 0.6;
-    case COMMAND_STOP:
-        return 0.7;
-    default:
-        return 0.8;
-    }
-}
+#ifndef MAX_REFRACTORY_TICKS
+#define MAX_REFRACTORY_TICKS STFT_RX_FRAME_HEIGHT
+#endif
 
-/**
- * Let the command run for the period of 1 full spectogram frame,
- * assuming `tick` is called for every spectogram line
- */
-#define MAX_DEBOUNCE_TICKS STFT_RX_FRAME_HEIGHT
+static bool handle_event(struct state *state,
+                         const struct softmax_result *result) {
+    enum command command = state->commands[result->first];
 
-static bool handle_event(struct state *state, enum command command,
-                         double probability) {
-    if (!state->debounce_ticks && is_known_command(command) &&
-        state->current_command != command &&
-        probability > get_command_probability_threshold(command)) {
+    if (decision_update(&state->decision, result) &&
+        state->current_command != command) {
 
-        set_motor_speed(state, get_command_motor_speed(command));
+        set_motor_speed(get_command_motor_speed(command));
         set_motor_direction(get_command_motor_direction(command));
 
         state->current_command = command;
-        state->debounce_ticks = MAX_DEBOUNCE_TICKS;
 
         return true;
     }
@@ -252,41 +503,92 @@ static bool handle_event(struct state *state, enum command command,
     return false;
 }
 
-static void tick(struct state *state) {
-    if (state->debounce_ticks)
-        state->debounce_ticks--;
-}
+static void tick(struct state *state) { decision_tick(&state->decision); }
 
 static tensil_error_t state_init(struct state *state) {
     TENSIL_XILINX_RESULT_FRAME
 
     tensil_error_t error = TENSIL_ERROR_NONE;
 
-    error = TENSIL_XILINX_RESULT(XTmrCtr_Initialize(
-        &state->tmr_ctr_motor0, XPAR_MOTOR_EN_TIMER_0_DEVICE_ID));
-
-    if (error)
-        return error;
-
-    error = TENSIL_XILINX_RESULT(XTmrCtr_Initialize(
-        &state->tmr_ctr_motor1, XPAR_MOTOR_EN_TIMER_1_DEVICE_ID));
+    error = TENSIL_XILINX_RESULT(hal_motor_init());
 
     if (error)
         return error;
 
     state->current_command = COMMAND_STOP;
-    state->debounce_ticks = MAX_DEBOUNCE_TICKS;
 
     set_motor_direction(0);
-    set_motor_speed(state, 0);
+    set_motor_speed(0);
 
     return TENSIL_ERROR_NONE;
 }
 
+/*
+ * Decides on the classes of the model that are commands, with the
+ * thresholds of its manifest. The current command carries over to the
+ * new model.
+ */
+
+static void state_set_model(struct state *state, const struct model *model) {
+    const struct image_manifest *manifest = &model->manifest;
+    u32 thresholds[MODEL_MAX_OUTPUT_LENGTH];
+
+    for (size_t i = 0; i < manifest->output_length; i++)
+        thresholds[i] =
+            model->commands[i] != COMMAND_NONE ? manifest->thresholds[i] : 0;
+
+    state->commands = model->commands;
+    decision_init(&state->decision, thresholds, manifest->output_length,
+                  MIN_REFRACTORY_TICKS, MAX_REFRACTORY_TICKS);
+}
+
 struct state state;
+struct model model;
+struct resize resize;
+struct vad vad;
+struct detector detector;
+struct profile profile;
+struct log uart_log;
+
+static void set_leds(int leds) { hal_set_leds(leds); }
+
+/*
+ * Appends a pair of data moves that read the window of packed input
+ * rows starting at `first_row` in the ring to local memory at `local`.
+ * When the window does not wrap around the end of the ring the second
+ * data move is replaced by a no-op, so that the pair always takes the
+ * same space in the instruction buffer and prologues are of the same
+ * size.
+ */
+
+static tensil_error_t
+append_window_read(struct tensil_instruction_buffer *buffer,
+                   const struct tensil_instruction_layout *layout,
+                   size_t local, size_t ring_offset, size_t first_row) {
+    size_t first_rows = MODEL_RING_HEIGHT - first_row;
 
-static void set_leds(int leds) {
-    XGpio_WriteReg(XPAR_LED_GPIO_0_BASEADDR, XGPIO_DATA_OFFSET, leds);
+    if (first_rows > MODEL_INPUT_HEIGHT)
+        first_rows = MODEL_INPUT_HEIGHT;
+
+    tensil_error_t error = tensil_buffer_append_instruction(
+        buffer, layout, TENSIL_OPCODE_DATA_MOVE,
+        TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL, local,
+        ring_offset + first_row * MODEL_PACKED_INPUT_LINE_VECTORS,
+        first_rows * MODEL_PACKED_INPUT_LINE_VECTORS - 1);
+
+    if (error)
+        return error;
+
+    if (first_rows == MODEL_INPUT_HEIGHT)
+        return tensil_buffer_append_instruction(
+            buffer, layout, TENSIL_OPCODE_NOOP, 0, 0, 0, 0);
+
+    return tensil_buffer_append_instruction(
+        buffer, layout, TENSIL_OPCODE_DATA_MOVE,
+        TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL,
+        local + first_rows * MODEL_PACKED_INPUT_LINE_VECTORS, ring_offset,
+        (MODEL_INPUT_HEIGHT - first_rows) * MODEL_PACKED_INPUT_LINE_VECTORS -
+            1);
 }
 
 static float get_command_leds(enum command command) {
@@ -304,671 +606,1405 @@ static float get_command_leds(enum command command) {
     }
 }
 
-int main() {
-    tensil_error_t error = TENSIL_ERROR_NONE;
+/*
+ * State of the main loop shared by the event handlers.
+ */
 
-    TENSIL_XILINX_RESULT_FRAME
+struct loop {
+    u8 *acq_ring_ptr;
+    u8 *stft_rx_buffer_ptr;
+    u8 *dram0_buffer_ptr;
+    u8 *dram1_buffer_ptr;
+    u8 *ring_ptr;
+
+    struct tensil_architecture arch;
+    struct tensil_instruction_layout layout;
+    struct tensil_instruction_buffer buffer;
 
     /*
-     * Flash all LEDs to indicate initialization.
+     * The instruction buffer starts with the body of the program and is
+     * followed by a prologue for each window of a batch and each first
+     * row of the window in the ring, which configures DRAM offsets and
+     * reads the window to local memory. Each is padded to the TCU data
+     * width. An inference runs the prologues of its windows and then
+     * the body, so nothing is patched per window.
      */
 
-    set_leds(LED_0 | LED_1 | LED_2 | LED_3);
+    size_t body_size;
+    size_t prologue_size;
 
     /*
-     * Initialize various buffers in DDR.
+     * Next hop to submit, number of hops submitted but not completed,
+     * number of completed hops whose lines are not yet processed and the
+     * next line to process.
      */
 
-    u8 *stft_rx_bd_space = BUFFER_START;
-    u8 *stft_tx_bd_space =
-        stft_rx_bd_space +
-        BUFFER_ALIGN(XAxiDma_BdRingMemCalc(XAXIDMA_BD_MINIMUM_ALIGNMENT, 1));
+    size_t stft_hop;
+    size_t stft_hops_busy;
+    size_t stft_lines;
+    int stft_line;
 
-    u8 *acq_buffer_ptr =
-        stft_tx_bd_space +
-        BUFFER_ALIGN(XAxiDma_BdRingMemCalc(XAXIDMA_BD_MINIMUM_ALIGNMENT, 2));
-    u8 *stft_tx_buffer_ptr =
-        acq_buffer_ptr + BUFFER_ALIGN(ACQ_PACKET_DOUBLE_SIZE);
-    u8 *stft_rx_buffer_ptr =
-        stft_tx_buffer_ptr + BUFFER_ALIGN(STFT_TX_PACKET_SIZE);
-
-    u8 *drma0_buffer_ptrs[2];
-
-    drma0_buffer_ptrs[0] =
-        stft_rx_buffer_ptr + BUFFER_ALIGN(STFT_RX_FRAME_SIZE);
+    /*
+     * Position of the next resized row in the ring and the number of
+     * rows written since the start of the last inference.
+     */
 
-    for (size_t i = 1; i < 2; i++) {
-        drma0_buffer_ptrs[i] =
-            drma0_buffer_ptrs[i - 1] +
-            BUFFER_ALIGN(TENSIL_ARCHITECTURE_DRAM0_DEPTH *
-                         TENSIL_ARCHITECTURE_ARRAY_SIZE * sizeof(MODEL_DT));
-    }
+    size_t ring_row;
+    size_t window_rows;
 
-    u8 *dram1_buffer_ptr =
-        drma0_buffer_ptrs[1] +
-        BUFFER_ALIGN(TENSIL_ARCHITECTURE_DRAM0_DEPTH *
-                     TENSIL_ARCHITECTURE_ARRAY_SIZE * sizeof(MODEL_DT));
-    u8 *prog_buffer_ptr =
-        dram1_buffer_ptr +
-        BUFFER_ALIGN(TENSIL_ARCHITECTURE_DRAM1_DEPTH *
-                     TENSIL_ARCHITECTURE_ARRAY_SIZE * sizeof(MODEL_DT));
+    /*
+     * Number of windows inferred, skipped by the voice activity gate and
+     * rejected by the keyword detector.
+     */
 
-    u8 *exp_rx_buffer_ptr =
-        prog_buffer_ptr + BUFFER_ALIGN(TENSIL_INSTRUCTION_BUFFER_SIZE);
+    u32 inferences_run;
+    u32 inferences_skipped;
+    u32 inferences_rejected;
 
     /*
-     * Initialize acquisition DMA.
+     * Number of windows not started in time because of the previous
+     * inference, the current step between windows in rows, the number
+     * of windows started in time since the last overrun and whether a
+     * window is waiting for the TCU.
      */
 
-    XAxiDma_Config *acq_cfg_ptr =
-        XAxiDma_LookupConfig(XPAR_ACQUISITION_AXI_DMA_0_DEVICE_ID);
-    error =
-        TENSIL_XILINX_RESULT(XAxiDma_CfgInitialize(&acq_axi_dma, acq_cfg_ptr));
-
-    if (error)
-        goto error;
+    u32 inferences_dropped;
+    size_t row_step;
+    size_t on_time_windows;
+    bool window_pending;
 
     /*
-     * Once acquisition DMA is initialize we can release microhone SPI
-     * from reset. Otherwise the sporadic ready signals sent by Xilinx
-     * AXI DMA will upset SPI packet counter.
+     * Windows collected for the next batch.
      */
 
-    XGpio_WriteReg(XPAR_ACQUISITION_AXI_GPIO_0_BASEADDR, XGPIO_DATA_OFFSET,
-                   0x1);
+    struct window_batch batch;
 
     /*
-     * Initialize STFT scatter-gather DMA.
+     * An inference is busy from the start of the TCU program to the end
+     * of the softmax. The run offset is non-zero while the TCU runs the
+     * program, and the end offset is the end of the prologue or of the
+     * body it runs. The sequence number is that of the last inference.
+     * Inference rows are the first rows of the windows of the batch
+     * being inferred, of which the inference windows were not repeated
+     * to complete it. They are kept apart from the windows collected
+     * for the next batch, which may be due before the prologues of this
+     * one are run. The run window is that of the prologue being run or
+     * the batch size once the body runs.
      */
 
-    XAxiDma_Config *stft_cfg_ptr =
-        XAxiDma_LookupConfig(XPAR_STFT_AXI_DMA_0_DEVICE_ID);
-    error = TENSIL_XILINX_RESULT(
-        XAxiDma_CfgInitialize(&stft_axi_dma, stft_cfg_ptr));
+    bool inference_busy;
+    size_t instructions_run_offset;
+    size_t instructions_end_offset;
+    u32 sequence;
+    size_t inference_rows[MODEL_MAX_BATCH_SIZE];
+    size_t inference_windows;
+    size_t run_window;
 
-    if (error)
-        goto error;
+    /*
+     * Slot of the model to switch to once the TCU is done.
+     */
 
-    XAxiDma_BdRing *stft_rx_ring_ptr = XAxiDma_GetRxRing(&stft_axi_dma);
-    XAxiDma_BdRing *stft_tx_ring_ptr = XAxiDma_GetTxRing(&stft_axi_dma);
+    size_t requested_slot;
 
-    XAxiDma_BdRingIntDisable(stft_rx_ring_ptr, XAXIDMA_IRQ_ALL_MASK);
-    XAxiDma_BdRingIntDisable(stft_tx_ring_ptr, XAXIDMA_IRQ_ALL_MASK);
+    /*
+     * Whether the lines of all acquired packets are processed, which
+     * ends an iteration of the profile, and whether the loop had no
+     * events to dispatch when it last looked.
+     */
 
-    XAxiDma_BdRingSetCoalesce(stft_rx_ring_ptr, 1, 0);
-    XAxiDma_BdRingSetCoalesce(stft_tx_ring_ptr, 1, 0);
+    bool packet_done;
+    bool idle;
+};
 
-    error = TENSIL_XILINX_RESULT(XAxiDma_BdRingCreate(
-        stft_rx_ring_ptr, (UINTPTR)stft_rx_bd_space, (UINTPTR)stft_rx_bd_space,
-        XAXIDMA_BD_MINIMUM_ALIGNMENT, 1));
+struct loop loop;
+struct scheduler scheduler;
 
-    if (error)
-        goto error;
+static void print_memory_map() {
+    size_t size = 0;
 
-    error = TENSIL_XILINX_RESULT(XAxiDma_BdRingCreate(
-        stft_tx_ring_ptr, (UINTPTR)stft_tx_bd_space, (UINTPTR)stft_tx_bd_space,
-        XAXIDMA_BD_MINIMUM_ALIGNMENT, 2));
+    for (size_t i = 0; i < MEMORY_REGIONS_LENGTH; i++) {
+        const struct memory_region *region = &memory_regions[i];
 
-    if (error)
-        goto error;
+        xil_printf("memory: %s at 0x%x, %d bytes%s%s%s\r\n", region->name,
+                   (int)region->offset, (int)region->size,
+                   region->flags & MEMORY_DMA ? ", dma" : "",
+                   region->flags & MEMORY_TCU ? ", tcu" : "",
+                   region->flags & MEMORY_HOT ? ", hot" : "");
+        size += region->size;
+    }
 
-    XAxiDma_Bd bd_template;
-    XAxiDma_BdClear(&bd_template);
+    xil_printf("memory: %d bytes, %d of padding\r\n",
+               (int)sizeof(struct memory_map),
+               (int)(sizeof(struct memory_map) - size));
+}
 
-    error = TENSIL_XILINX_RESULT(
-        XAxiDma_BdRingClone(stft_rx_ring_ptr, &bd_template));
+static void print_counters(const struct loop *loop) {
+    xil_printf("windows: %d run, %d skipped, %d rejected, %d dropped, "
+               "step %d rows\r\n",
+               (int)loop->inferences_run, (int)loop->inferences_skipped,
+               (int)loop->inferences_rejected, (int)loop->inferences_dropped,
+               (int)loop->row_step);
+    xil_printf("events: %d tcu, %d stft, %d acq\r\n",
+               (int)scheduler.dispatched[EVENT_TCU],
+               (int)scheduler.dispatched[EVENT_STFT],
+               (int)scheduler.dispatched[EVENT_ACQ]);
+    xil_printf("log: %d dropped\r\n", (int)uart_log.dropped);
+}
 
-    if (error)
-        goto error;
+static int read_model_image(void *context, size_t offset, u8 *ptr,
+                            size_t size) {
+    const size_t *slot = context;
 
-    error = TENSIL_XILINX_RESULT(
-        XAxiDma_BdRingClone(stft_tx_ring_ptr, &bd_template));
+    return hal_flash_read(MODEL_FLASH_SLOT_OFFSET +
+                              *slot * MODEL_FLASH_SLOT_SIZE + offset,
+                          ptr, size);
+}
 
-    if (error)
-        goto error;
+static size_t align_size(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
 
-    error = TENSIL_XILINX_RESULT(XAxiDma_BdRingStart(stft_rx_ring_ptr));
+/*
+ * Returns the size of the instruction buffer that load_model needs for
+ * the model: the unpack of the input of each window, the program, of
+ * which the whole is unpacked before the resize layer is moved out, the
+ * pair of completion instructions and, for each window of a batch and
+ * each first row in the ring, a prologue of two configuration
+ * instructions and the two instructions of the window read.
+ */
 
-    if (error)
-        goto error;
+static size_t get_instructions_size(const struct loop *loop,
+                                    const struct image_header *header) {
+    const struct image_manifest *manifest = &header->manifest;
+    size_t instruction_size = loop->layout.instruction_size_bytes;
+    size_t data_width = hal_tcu_get_instructions_data_width_bytes();
+    size_t prog_size = header->sections[IMAGE_SECTION_PROG].size;
+    size_t prog_resize_size = manifest->resize_length * instruction_size;
+    size_t unpack_size =
+        (1 + manifest->batch_size * (2 * MODEL_VECTOR_LENGTH + 2)) *
+        instruction_size;
+    size_t body_size = align_size(
+        unpack_size + prog_size - prog_resize_size + 2 * instruction_size,
+        data_width);
+    size_t prologue_size = align_size(4 * instruction_size, data_width);
+    size_t size =
+        body_size + manifest->batch_size * MODEL_RING_HEIGHT * prologue_size;
+
+    return size > unpack_size + prog_size ? size : unpack_size + prog_size;
+}
 
-    error = TENSIL_XILINX_RESULT(XAxiDma_BdRingStart(stft_tx_ring_ptr));
+/*
+ * Reads the header of the image in the slot and checks that the
+ * firmware can run its model: it was compiled for this architecture,
+ * its input is what the resize produces, its batch is not larger than
+ * the firmware collects, DRAM0 has room for its logits and, past its
+ * input, for the ring and the unpack weights below the sequence and
+ * completion vectors, and its program and prologues fit the instruction
+ * buffer.
+ */
 
-    if (error)
-        goto error;
+static int read_model_header(const struct loop *loop, size_t slot,
+                             struct image_header *header) {
+    const struct image_manifest *manifest = &header->manifest;
+    struct image_architecture architecture = {
+        .data_type = loop->arch.data_type == TENSIL_DATA_TYPE_FP16BP8
+                         ? IMAGE_DATA_TYPE_FP16BP8
+                         : 0,
+        .array_size = loop->arch.array_size,
+        .dram0_depth = loop->arch.dram0_depth,
+        .dram1_depth = loop->arch.dram1_depth,
+        .local_depth = loop->arch.local_depth,
+        .accumulator_depth = loop->arch.accumulator_depth,
+        .simd_registers_depth = loop->arch.simd_registers_depth,
+        .stride0_depth = loop->arch.stride0_depth,
+        .stride1_depth = loop->arch.stride1_depth,
+    };
 
-    /*
-     * Initialze buffers to zero since we will be using them while
-     * not fully filled for sliding windows.
-     */
+    int status = image_read_header(read_model_image, &slot, header);
+
+    if (status != XST_SUCCESS)
+        return status;
+
+    u32 detector_size = header->sections[IMAGE_SECTION_DETECTOR].size;
+
+    size_t output_end =
+        manifest->output_offset +
+        manifest->batch_size *
+            ((manifest->output_length + MODEL_VECTOR_LENGTH - 1) /
+             MODEL_VECTOR_LENGTH);
+    size_t input_end =
+        manifest->input_offset +
+        manifest->batch_size * manifest->input_height * manifest->input_width;
+    size_t dram0_end = input_end + MODEL_RING_SIZE_VECTORS +
+                       MODEL_UNPACK_WEIGHTS_SIZE_VECTORS;
+
+    if (manifest->architecture_checksum !=
+            image_get_architecture_checksum(&architecture) ||
+        manifest->input_height != MODEL_INPUT_HEIGHT ||
+        manifest->input_width != MODEL_INPUT_WIDTH ||
+        !manifest->output_length ||
+        manifest->batch_size > MODEL_MAX_BATCH_SIZE ||
+        output_end > MODEL_COMPLETION_OFFSET_VECTORS ||
+        dram0_end > MODEL_COMPLETION_OFFSET_VECTORS ||
+        header->sections[IMAGE_SECTION_PROG].size <
+            manifest->resize_length * loop->layout.instruction_size_bytes ||
+        get_instructions_size(loop, header) > loop->buffer.size ||
+        (detector_size && detector_size != sizeof(struct detector_params)))
+        return XST_FAILURE;
+
+    return XST_SUCCESS;
+}
 
-    memset((void *)acq_buffer_ptr, 0, ACQ_PACKET_DOUBLE_SIZE);
-    memset((void *)stft_tx_buffer_ptr, 0, STFT_TX_PACKET_SIZE);
-    memset((void *)stft_rx_buffer_ptr, 0, STFT_RX_FRAME_SIZE);
+static enum command get_label_command(const char *label) {
+    for (size_t i = 0; i < COMMANDS; i++)
+        if (command_labels[i] && !strcmp(command_labels[i], label))
+            return i;
 
-    /*
-     * TENSIL_ARCHITECTURE parameters come from architecture_params.h
-     * created by `tensil rtl` tool based on architecture definition in
-     * ./arch/speech_robot.tarch.
-     */
+    return COMMAND_NONE;
+}
 
-    struct tensil_architecture arch = {
-        .array_size = TENSIL_ARCHITECTURE_ARRAY_SIZE,
-        .data_type = TENSIL_ARCHITECTURE_DATA_TYPE,
-        .local_depth = TENSIL_ARCHITECTURE_LOCAL_DEPTH,
-        .accumulator_depth = TENSIL_ARCHITECTURE_ACCUMULATOR_DEPTH,
-        .dram0_depth = TENSIL_ARCHITECTURE_DRAM0_DEPTH,
-        .dram1_depth = TENSIL_ARCHITECTURE_DRAM1_DEPTH,
-        .stride0_depth = TENSIL_ARCHITECTURE_STRIDE0_DEPTH,
-        .stride1_depth = TENSIL_ARCHITECTURE_STRIDE1_DEPTH,
-        .simd_registers_depth = TENSIL_ARCHITECTURE_SIMD_REGISTERS_DEPTH,
-    };
+static void print_model(const struct image_header *header, u32 ticks) {
+    u32 ticks_per_ms = hal_get_ticks_per_second() / 1000;
+    size_t stored_size = 0;
+    size_t size = 0;
 
-    if (!tensil_architecture_is_valid(&arch))
-        goto error;
+    for (size_t i = 0; i < IMAGE_SECTIONS; i++) {
+        stored_size += header->sections[i].stored_size;
+        size += header->sections[i].size;
+    }
 
-    struct tensil_instruction_layout layout;
+    xil_printf("model %d: %s, %d bytes unpacked from %d bytes", (int)model.slot,
+               header->manifest.name, (int)size, (int)stored_size);
 
-    tensil_instruction_layout_init(&layout, &arch);
+    if (ticks_per_ms)
+        xil_printf(" in %d ms", (int)(ticks / ticks_per_ms));
 
-    struct tensil_compute_unit tcu;
+    xil_printf("\r\n");
+}
 
-    error = tensil_compute_unit_init(&tcu);
+static volatile u32 *get_sequence_ptr(const struct loop *loop,
+                                      size_t offset_vectors) {
+    return (volatile u32 *)(loop->dram0_buffer_ptr +
+                            offset_vectors * MODEL_VECTOR_SIZE);
+}
 
-    if (error)
-        goto error;
+/*
+ * Appends the prologue for window `window` of a batch starting at
+ * `first_row` in the ring. It starts by configuring DRAM0 and DRAM1
+ * offsets and reads the window to its place in local memory.
+ */
 
-    struct tensil_instruction_buffer buffer = {
-        .ptr = prog_buffer_ptr,
-        .size = TENSIL_INSTRUCTION_BUFFER_SIZE,
-        .offset = 0};
+static tensil_error_t append_prologue(struct loop *loop, size_t window,
+                                      size_t first_row) {
+    struct tensil_instruction_buffer *buffer = &loop->buffer;
+    const struct tensil_instruction_layout *layout = &loop->layout;
 
-    tensil_buffer_reset(&buffer);
+    tensil_error_t error = tensil_buffer_append_config_instruction(
+        buffer, layout, TENSIL_CONFIG_REGISTER_DRAM0_OFFSET,
+        hal_get_dram_offset(loop->dram0_buffer_ptr));
 
-    /*
-     * We start TCU program by configring DRAM0 and DRAM1 offsets.
-     * Since we use multiple DRAM0 buffers, DRAM0 offset configuration
-     * instruction is a placeholder with offset set to 0xffff. Before
-     * running the program we will set this offset to real one by
-     * overwriting this instruction.
-     */
+    if (error)
+        return error;
 
     error = tensil_buffer_append_config_instruction(
-        &buffer, &layout, TENSIL_CONFIG_REGISTER_DRAM0_OFFSET, 0xffff);
+        buffer, layout, TENSIL_CONFIG_REGISTER_DRAM1_OFFSET,
+        hal_get_dram_offset(loop->dram1_buffer_ptr));
 
     if (error)
-        goto error;
+        return error;
 
-    error = tensil_buffer_append_config_instruction(
-        &buffer, &layout, TENSIL_CONFIG_REGISTER_DRAM1_OFFSET,
-        TENSIL_CONFIG_DRAM_OFFSET(dram1_buffer_ptr));
+    error = append_window_read(buffer, layout,
+                               window * MODEL_PACKED_INPUT_SIZE_VECTORS,
+                               model.ring_offset_vectors, first_row);
 
     if (error)
-        goto error;
+        return error;
 
-    /*
-     * Copy compiled TCU program from flash memory to the instruction
-     * buffer in DDR. Since there is "preamble" and "postamble"
-     * instructions that are not generated by the compiler we cannot
-     * run the program as-is from flash memory.
-     */
+    return tensil_buffer_pad_to_alignment(
+        buffer, layout, hal_tcu_get_instructions_data_width_bytes());
+}
 
-    error = tensil_buffer_append_program(
-        &buffer, (const u8 *)MODEL_FLASH_PROG_BASE, MODEL_FLASH_PROG_SIZE);
+/*
+ * Loads the model whose header was read from the slot. The TCU program
+ * is rebuilt around the program of the model and its constants are
+ * unpacked to DRAM1. Rows already in the ring are moved with it, so
+ * that windows continue across the switch.
+ */
 
-    if (error)
-        goto error;
+static tensil_error_t load_model(struct loop *loop, size_t slot,
+                                 const struct image_header *header) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+    TENSIL_XILINX_RESULT_FRAME
+
+    u32 start_ticks = hal_get_ticks();
+    const struct image_manifest *manifest = &header->manifest;
+
+    model.slot = slot;
+    model.manifest = *manifest;
+    model.ring_offset_vectors =
+        manifest->input_offset +
+        manifest->batch_size * manifest->input_height * manifest->input_width;
+    model.unpack_weights_offset_vectors =
+        model.ring_offset_vectors + MODEL_RING_SIZE_VECTORS;
+    model.output_size_vectors =
+        (manifest->output_length + MODEL_VECTOR_LENGTH - 1) /
+        MODEL_VECTOR_LENGTH;
+
+    for (size_t i = 0; i < manifest->output_length; i++) {
+        model.labels[i] = model.manifest.labels[i];
+        model.commands[i] = get_label_command(model.labels[i]);
+    }
 
     /*
-     * In order to ensure that TCU program ran to its completion
-     * we add a pair of data move instructions at the end of the
-     * program to copy special "probe" vector from last location to
-     * second to last location in DRAM0. We later will monitor DRAM0
-     * for this change.
+     * Unpack weight matrix i has the bias vector followed by rows for
+     * each input lane, of which only row i is non-zero with one in the
+     * first position.
      */
 
-    error = tensil_buffer_append_instruction(
-        &buffer, &layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL, 0,
-        TENSIL_ARCHITECTURE_DRAM0_DEPTH - 1, 0);
+    u8 *ring_ptr = loop->dram0_buffer_ptr +
+                   model.ring_offset_vectors * MODEL_VECTOR_SIZE;
+    MODEL_DT *unpack_weights_ptr =
+        (MODEL_DT *)(loop->dram0_buffer_ptr +
+                     model.unpack_weights_offset_vectors * MODEL_VECTOR_SIZE);
 
-    if (error)
-        goto error;
+    if (loop->ring_ptr)
+        memmove((void *)ring_ptr, (const void *)loop->ring_ptr,
+                MODEL_RING_SIZE);
+    else
+        memset((void *)ring_ptr, 0, MODEL_RING_SIZE);
 
-    error = tensil_buffer_append_instruction(
-        &buffer, &layout, TENSIL_OPCODE_DATA_MOVE,
-        TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0, 0,
-        TENSIL_ARCHITECTURE_DRAM0_DEPTH - 2, 0);
+    memset((void *)unpack_weights_ptr, 0,
+           MODEL_UNPACK_WEIGHTS_SIZE_VECTORS * MODEL_VECTOR_SIZE);
 
-    if (error)
-        goto error;
+    for (size_t i = 0; i < MODEL_VECTOR_LENGTH; i++)
+        unpack_weights_ptr[(i * MODEL_UNPACK_WEIGHTS_LENGTH + 1 + i) *
+                           MODEL_VECTOR_LENGTH] = MODEL_FIXED_POINT_ONE;
 
-    error = tensil_buffer_pad_to_alignment(
-        &buffer, &layout,
-        tensil_compute_unit_get_instructions_data_width_bytes(&tcu));
+    loop->ring_ptr = ring_ptr;
 
-    if (error)
-        goto error;
+    struct tensil_instruction_buffer *buffer = &loop->buffer;
+    const struct tensil_instruction_layout *layout = &loop->layout;
+
+    tensil_buffer_reset(buffer);
 
     /*
-     * Copy ML model constants (weights) from flash memory to DDR. If there
-     * is insufficient amount of DDR memory the TCU could read directly from
-     * flash address space with corresponding changes in Vivado design Address
-     * Editor.
+     * Unpack the input. The prologues have loaded the windows of packed
+     * input to local memory. Load unpack weights after them. Then for
+     * each window and each lane of packed input multiply it by the
+     * weights selecting that lane into the first position and write the
+     * result to every MODEL_VECTOR_LENGTH-th accumulator starting at the
+     * lane index. This leaves the model input of the window in
+     * accumulators, which we move to DRAM0 via local memory.
      */
 
-    memcpy((void *)dram1_buffer_ptr, (const void *)MODEL_FLASH_CONST_BASE,
-           MODEL_FLASH_CONST_SIZE);
+    size_t unpack_weights_local =
+        manifest->batch_size * MODEL_PACKED_INPUT_SIZE_VECTORS;
+    size_t unpack_input_local =
+        unpack_weights_local + MODEL_UNPACK_WEIGHTS_SIZE_VECTORS;
 
-    XAxiDma_Config *exp_cfg_ptr =
-        XAxiDma_LookupConfig(XPAR_EXP_AXI_DMA_0_DEVICE_ID);
-    error =
-        TENSIL_XILINX_RESULT(XAxiDma_CfgInitialize(&exp_axi_dma, exp_cfg_ptr));
+    error = tensil_buffer_append_instruction(
+        buffer, layout, TENSIL_OPCODE_DATA_MOVE,
+        TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL, unpack_weights_local,
+        model.unpack_weights_offset_vectors,
+        MODEL_UNPACK_WEIGHTS_SIZE_VECTORS - 1);
 
     if (error)
-        goto error;
+        return error;
 
-    error = state_init(&state);
+    for (size_t j = 0; j < manifest->batch_size; j++) {
+        for (size_t i = 0; i < MODEL_VECTOR_LENGTH; i++) {
+            error = tensil_buffer_append_instruction(
+                buffer, layout, TENSIL_OPCODE_LOAD_WEIGHT, 0,
+                unpack_weights_local + i * MODEL_UNPACK_WEIGHTS_LENGTH,
+                MODEL_UNPACK_WEIGHTS_LENGTH - 1, 0);
 
-    if (error)
-        goto error;
+            if (error)
+                return error;
 
-    set_leds(get_command_leds(state.current_command));
+            error = tensil_buffer_append_instruction(
+                buffer, layout, TENSIL_OPCODE_MAT_MUL, 0,
+                j * MODEL_PACKED_INPUT_SIZE_VECTORS,
+                i | (MODEL_VECTOR_LENGTH_LOG2 << TCU_OPERAND1_STRIDE_SHIFT),
+                MODEL_PACKED_INPUT_SIZE_VECTORS - 1);
 
-    int acq_reversed = 0;
-    int stft_line = 0;
+            if (error)
+                return error;
+        }
 
-    size_t instructions_run_offset = 0;
+        error = tensil_buffer_append_instruction(
+            buffer, layout, TENSIL_OPCODE_DATA_MOVE,
+            TENSIL_DATA_MOVE_FLAG_ACC_TO_LOCAL, unpack_input_local, 0,
+            MODEL_INPUT_HEIGHT * MODEL_INPUT_WIDTH - 1);
 
-    /* The main loop starts with initiating DMA transfer of
-     * of acqisition packet and ends with waiting for it to
-     * complete. At 16Hz sampling rate it takes 8ms to acquire
-     * 128 samples. Therefore, everything that happens between
-     * initiating the transfer and its wait loop must take less
-     * than 8ms. Otherwise samples will be dropped.
+        if (error)
+            return error;
+
+        error = tensil_buffer_append_instruction(
+            buffer, layout, TENSIL_OPCODE_DATA_MOVE,
+            TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0, unpack_input_local,
+            manifest->input_offset +
+                j * MODEL_INPUT_HEIGHT * MODEL_INPUT_WIDTH,
+            MODEL_INPUT_HEIGHT * MODEL_INPUT_WIDTH - 1);
+
+        if (error)
+            return error;
+    }
+
+    /*
+     * Unpack compiled TCU program from flash memory to the instruction
+     * buffer in DDR. Since there is "preamble" and "postamble"
+     * instructions that are not generated by the compiler we cannot
+     * run the program as-is from flash memory. The resize layer is
+     * skipped since the model input is already resized, so the program
+     * past it is moved down over it once unpacked.
      */
 
-    while (true) {
+    const struct image_section *prog_section =
+        &header->sections[IMAGE_SECTION_PROG];
+    size_t prog_resize_size =
+        manifest->resize_length * layout->instruction_size_bytes;
+    u8 *prog_ptr = buffer->ptr + buffer->offset;
 
-        /*
-         * Acquisition uses double-buffering to allow DMA transfer
-         * of acqisition packet to proceed into one half of the buffer
-         * while the other half is available for copying to STFT TX buffer.
-         */
+    error = TENSIL_XILINX_RESULT(
+        image_unpack(read_model_image, &slot, prog_section, prog_ptr,
+                     buffer->size - buffer->offset));
 
-        size_t acq_offset = (1 - acq_reversed) * ACQ_PACKET_SIZE;
+    if (error)
+        return error;
 
-        error = TENSIL_XILINX_RESULT(XAxiDma_SimpleTransfer(
-            &acq_axi_dma, (UINTPTR)(acq_buffer_ptr + acq_offset),
-            ACQ_PACKET_SIZE, XAXIDMA_DEVICE_TO_DMA));
+    memmove(prog_ptr, prog_ptr + prog_resize_size,
+            prog_section->size - prog_resize_size);
+    buffer->offset += prog_section->size - prog_resize_size;
 
-        if (error)
-            goto error;
+    /*
+     * In order to ensure that TCU program ran to its completion we add
+     * a pair of data move instructions at the end of the program to
+     * copy the sequence vector to the completion vector. We later will
+     * monitor the completion vector for the number of the inference.
+     */
+
+    error = tensil_buffer_append_instruction(
+        buffer, layout, TENSIL_OPCODE_DATA_MOVE,
+        TENSIL_DATA_MOVE_FLAG_DRAM0_TO_LOCAL, 0,
+        MODEL_SEQUENCE_OFFSET_VECTORS, 0);
 
-        acq_reversed = (acq_reversed + 1) % 2;
-        acq_offset = (1 - acq_reversed) * ACQ_PACKET_SIZE;
+    if (error)
+        return error;
 
-        memcpy((void *)(stft_tx_buffer_ptr + acq_offset),
-               (const void *)(acq_buffer_ptr + acq_offset), ACQ_PACKET_SIZE);
+    error = tensil_buffer_append_instruction(
+        buffer, layout, TENSIL_OPCODE_DATA_MOVE,
+        TENSIL_DATA_MOVE_FLAG_LOCAL_TO_DRAM0, 0,
+        MODEL_COMPLETION_OFFSET_VECTORS, 0);
 
-        /*
-         * Each STFT TX packet is comprised of two acqisition packet to
-         * represent a sliding window over acqisition samples. This sliding
-         * window is required to produce STFT, which we will call a spectogram.
-         *
-         * https://en.wikipedia.org/wiki/Short-time_Fourier_transform
-         *
-         * Because we minimize copying the STFT TX packet halves are
-         * alternated between natural and reverse order. To accomodate
-         * this we use scatter-gather DMA with STFT. Transfer side (TX)
-         * uses two DMA blocks, each mapping into STFT TX packet halves
-         * in their current order. Receiving side (RX) uses one block to
-         * place resulting STFT RX line into STFT RX frame. This frame height
-         * is defined by the model input dimentions, which is 124 so that
-         * each frame represents 1 second spectogram at 16Hz sample rate.
-         */
+    if (error)
+        return error;
 
-        XAxiDma_Bd *stft_rx_bd_head_ptr;
-        error = TENSIL_XILINX_RESULT(
-            XAxiDma_BdRingAlloc(stft_tx_ring_ptr, 2, &stft_rx_bd_head_ptr));
+    error = tensil_buffer_pad_to_alignment(
+        buffer, layout, hal_tcu_get_instructions_data_width_bytes());
 
-        if (error)
-            goto error;
+    if (error)
+        return error;
 
-        XAxiDma_Bd *cur_bd_ptr = stft_rx_bd_head_ptr;
-        for (size_t i = 0; i < 2; i++) {
-            size_t tx_offset = abs(i - acq_reversed) * ACQ_PACKET_SIZE;
+    loop->body_size = buffer->offset;
 
-            error = TENSIL_XILINX_RESULT(XAxiDma_BdSetBufAddr(
-                cur_bd_ptr, (UINTPTR)(stft_tx_buffer_ptr + tx_offset)));
+    for (size_t j = 0; j < manifest->batch_size; j++)
+        for (size_t i = 0; i < MODEL_RING_HEIGHT; i++) {
+            error = append_prologue(loop, j, i);
 
             if (error)
-                goto error;
+                return error;
 
-            error = TENSIL_XILINX_RESULT(XAxiDma_BdSetLength(
-                cur_bd_ptr, ACQ_PACKET_SIZE, stft_tx_ring_ptr->MaxTransferLen));
+            if (!i && !j)
+                loop->prologue_size = buffer->offset - loop->body_size;
+        }
 
-            if (error)
-                goto error;
+    /*
+     * Windows collected for the previous model are dropped, since the
+     * batch size may differ.
+     */
 
-            XAxiDma_BdSetCtrl(cur_bd_ptr, i ? XAXIDMA_BD_CTRL_TXEOF_MASK
-                                            : XAXIDMA_BD_CTRL_TXSOF_MASK);
-            XAxiDma_BdSetId(cur_bd_ptr, i);
+    window_batch_init(&loop->batch, manifest->batch_size,
+                      MODEL_OVERRUN_POLICY == OVERRUN_POLICY_COALESCE,
+                      MODEL_RING_HEIGHT, MODEL_WINDOW_MAX_AGE);
+    loop->window_pending = false;
 
-            cur_bd_ptr =
-                (XAxiDma_Bd *)XAxiDma_BdRingNext(stft_tx_ring_ptr, cur_bd_ptr);
-        }
+    *get_sequence_ptr(loop, MODEL_COMPLETION_OFFSET_VECTORS) =
+        loop->sequence;
 
-        error = TENSIL_XILINX_RESULT(
-            XAxiDma_BdRingToHw(stft_tx_ring_ptr, 2, stft_rx_bd_head_ptr));
+    /*
+     * Unpack ML model constants (weights) from flash memory to DDR. If
+     * there is insufficient amount of DDR memory the TCU could read
+     * stored constants directly from flash address space with
+     * corresponding changes in Vivado design Address Editor.
+     */
 
-        if (error)
-            goto error;
+    error = TENSIL_XILINX_RESULT(image_unpack(
+        read_model_image, &slot, &header->sections[IMAGE_SECTION_CONSTS],
+        loop->dram1_buffer_ptr,
+        TENSIL_ARCHITECTURE_DRAM1_DEPTH * TENSIL_ARCHITECTURE_ARRAY_SIZE *
+            sizeof(MODEL_DT)));
+
+    if (error)
+        return error;
+
+    const struct image_section *detector_section =
+        &header->sections[IMAGE_SECTION_DETECTOR];
 
-        XAxiDma_Bd *stft_rx_head_ptr;
-        error = TENSIL_XILINX_RESULT(
-            XAxiDma_BdRingAlloc(stft_rx_ring_ptr, 1, &stft_rx_head_ptr));
+    if (detector_section->size) {
+        error = TENSIL_XILINX_RESULT(image_unpack(
+            read_model_image, &slot, detector_section,
+            (u8 *)&model.detector_params, sizeof(struct detector_params)));
 
         if (error)
-            goto error;
+            return error;
+    }
 
-        cur_bd_ptr = stft_rx_head_ptr;
+    detector_set_params(&detector, detector_section->size
+                                       ? &model.detector_params
+                                       : NULL);
+    state_set_model(&state, &model);
+    log_set_names(&uart_log, model.labels, manifest->output_length);
+    print_model(header, hal_get_ticks() - start_ticks);
 
-        error = TENSIL_XILINX_RESULT(XAxiDma_BdSetBufAddr(
-            cur_bd_ptr, (UINTPTR)(stft_rx_buffer_ptr +
-                                  stft_line * STFT_RX_FRAME_LINE_SIZE)));
+    return TENSIL_ERROR_NONE;
+}
 
-        if (error)
-            goto error;
+/*
+ * Switches to the requested model. A slot without a valid image is
+ * ignored, and when the image turns out to be malformed while loading
+ * it the previous model is loaded again.
+ */
 
-        error = TENSIL_XILINX_RESULT(
-            XAxiDma_BdSetLength(cur_bd_ptr, STFT_RX_FRAME_LINE_SIZE,
-                                stft_rx_ring_ptr->MaxTransferLen));
+static tensil_error_t switch_model(struct loop *loop) {
+    TENSIL_XILINX_RESULT_FRAME
 
-        if (error)
-            goto error;
+    struct image_header header;
+    size_t slot = model.slot;
 
-        XAxiDma_BdSetCtrl(cur_bd_ptr, 0);
-        XAxiDma_BdSetId(cur_bd_ptr, 0);
+    /*
+     * Records in the log are formatted with the labels of the model as
+     * they are transmitted, and loading overwrites the labels, so the
+     * records of the current model are transmitted first.
+     */
 
-        error = TENSIL_XILINX_RESULT(
-            XAxiDma_BdRingToHw(stft_rx_ring_ptr, 1, stft_rx_head_ptr));
+    while (!log_drain(&uart_log))
+        ;
 
-        if (error)
-            goto error;
+    if (read_model_header(loop, loop->requested_slot, &header) !=
+        XST_SUCCESS) {
+        xil_printf("model %d: no valid image\r\n", (int)loop->requested_slot);
+        loop->requested_slot = slot;
 
-        while (XAxiDma_BdRingFromHw(stft_rx_ring_ptr, XAXIDMA_ALL_BDS,
-                                    &stft_rx_head_ptr) != 1 ||
-               XAxiDma_BdRingFromHw(stft_tx_ring_ptr, XAXIDMA_ALL_BDS,
-                                    &stft_rx_bd_head_ptr) != 2)
-            ;
+        return TENSIL_ERROR_NONE;
+    }
 
-        error = TENSIL_XILINX_RESULT(
-            XAxiDma_BdRingFree(stft_tx_ring_ptr, 2, stft_rx_bd_head_ptr));
+    if (load_model(loop, loop->requested_slot, &header) == TENSIL_ERROR_NONE)
+        return TENSIL_ERROR_NONE;
 
-        if (error)
-            goto error;
+    xil_printf("model %d: failed to load\r\n", (int)loop->requested_slot);
+    loop->requested_slot = slot;
+
+    tensil_error_t error = TENSIL_XILINX_RESULT(
+        read_model_header(loop, slot, &header));
+
+    if (error)
+        return error;
+
+    return load_model(loop, slot, &header);
+}
 
-        error = TENSIL_XILINX_RESULT(
-            XAxiDma_BdRingFree(stft_rx_ring_ptr, 1, stft_rx_head_ptr));
+/*
+ * The acquisition packet completed, and the next one is started along
+ * with the hop of the completed one. Sending "p" over the UART prints
+ * the profile and "r" resets it. Printing takes several packet periods,
+ * so the packets during it are lost. Events are logged without blocking
+ * and "b" toggles the binary log framing. A slot number switches to the
+ * model in it once the TCU is done, which also loses the packets while
+ * the model is unpacked.
+ */
+
+static tensil_error_t handle_acq(void *context) {
+    struct loop *loop = context;
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+    TENSIL_XILINX_RESULT_FRAME
+
+    int c = hal_uart_get_char();
+
+    switch (c) {
+    case 'p':
+        profile_print(&profile);
+        print_counters(loop);
+        break;
+    case 'r':
+        profile_reset(&profile);
+        break;
+    case 'b':
+        uart_log.binary = !uart_log.binary;
+        break;
+    default:
+        if (c >= '0' && c < '0' + MODEL_FLASH_SLOTS)
+            loop->requested_slot = c - '0';
+        break;
+    }
+
+    if (loop->requested_slot != model.slot && !loop->inference_busy) {
+        error = switch_model(loop);
 
         if (error)
-            goto error;
+            return error;
+    }
+
+    /*
+     * An iteration of the profile lasts until the loop has processed
+     * the lines of all packets, so that the loop falling behind shows
+     * as an overrun.
+     */
+
+    if (loop->packet_done)
+        profile_start(&profile);
+
+    /*
+     * The packet acquired last is the newest half of the sliding window
+     * of the next hop. The following packet is acquired into the slot
+     * after it while the hop runs.
+     */
+
+    size_t acq_slot = (loop->stft_hop + 1) % ACQ_RING_LENGTH;
+
+    error = TENSIL_XILINX_RESULT(hal_acq_start(
+        loop->acq_ring_ptr + acq_slot * ACQ_PACKET_SIZE, ACQ_PACKET_SIZE));
+
+    if (error)
+        return error;
+
+    profile_mark(&profile, PROFILE_STAGE_ACQ);
+
+    error = TENSIL_XILINX_RESULT(hal_stft_start());
+
+    if (error)
+        return error;
+
+    loop->stft_hop = (loop->stft_hop + 1) % STFT_RING_DEPTH;
+    loop->stft_hops_busy++;
+    loop->packet_done = false;
+
+    return TENSIL_ERROR_NONE;
+}
+
+/*
+ * Starts the next block of instructions up to the end offset.
+ */
+
+static tensil_error_t start_instructions(struct loop *loop) {
+    struct tensil_instruction_buffer buffer = loop->buffer;
+
+    buffer.offset = loop->instructions_end_offset;
+
+    return hal_tcu_start_instructions(&buffer,
+                                      &loop->instructions_run_offset);
+}
+
+/*
+ * Returns the first row in the ring of the window of the last
+ * MODEL_INPUT_HEIGHT rows written.
+ */
+
+static size_t get_window_first_row(const struct loop *loop) {
+    return (loop->ring_row + MODEL_RING_HEIGHT - MODEL_INPUT_HEIGHT) %
+           MODEL_RING_HEIGHT;
+}
+
+/*
+ * Sets the instructions to run to the prologue of the window of the
+ * batch, or to the body once past the last window.
+ */
+
+static void set_run_window(struct loop *loop, size_t window) {
+    loop->run_window = window;
+
+    if (window < model.manifest.batch_size) {
+        loop->instructions_run_offset =
+            loop->body_size +
+            (window * MODEL_RING_HEIGHT + loop->inference_rows[window]) *
+                loop->prologue_size;
+        loop->instructions_end_offset =
+            loop->instructions_run_offset + loop->prologue_size;
+    } else {
+        loop->instructions_run_offset = 0;
+        loop->instructions_end_offset = loop->body_size;
+    }
+}
+
+/*
+ * Starts the windows collected for a batch once the TCU is free rather
+ * than waiting for more windows to pass the gates, which may not come
+ * until the next command is spoken.
+ */
+
+static void flush_batch(struct loop *loop) {
+    if (!window_batch_is_empty(&loop->batch))
+        loop->window_pending = true;
+}
+
+/*
+ * Drops collected windows whose rows are about to be overwritten,
+ * which are counted with the windows dropped on overruns.
+ */
+
+static void expire_batch(struct loop *loop) {
+    loop->inferences_dropped +=
+        window_batch_expire(&loop->batch, get_window_first_row(loop));
+}
+
+static tensil_error_t start_inference(struct loop *loop) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+    /*
+     * A partial batch may have waited for the TCU long enough for all
+     * of its windows to expire.
+     */
+
+    expire_batch(loop);
+
+    if (window_batch_is_empty(&loop->batch))
+        return TENSIL_ERROR_NONE;
+
+    /*
+     * The batch is completed by the window of the last
+     * MODEL_INPUT_HEIGHT rows written to the ring, or when flushed by
+     * repeating its last window, whose results are not used.
+     */
+
+    loop->inference_windows = window_batch_start(
+        &loop->batch, get_window_first_row(loop), loop->inference_rows);
+
+    set_run_window(loop, 0);
+
+    /*
+     * Number the inference for the completion vector to be compared
+     * with.
+     */
+
+    *get_sequence_ptr(loop, MODEL_SEQUENCE_OFFSET_VECTORS) = ++loop->sequence;
+
+    /*
+     * Start running TCU program to perform the inference. This will
+     * proceed concurrently with acqistion and STFT processing. Each
+     * following block of instructions is started by the TCU event
+     * as soon as the previous one is consumed.
+     */
+
+    error = start_instructions(loop);
+
+    if (error)
+        return error;
+
+    loop->inference_busy = true;
+    loop->inferences_run += loop->inference_windows;
+
+    return TENSIL_ERROR_NONE;
+}
+
+static tensil_error_t process_line(struct loop *loop) {
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+    const u8 *stft_rx_buffer_ptr = loop->stft_rx_buffer_ptr;
+    int stft_line = loop->stft_line;
+
+    /*
+     * Update the voice activity gate with the new line, which like
+     * the resize below reads the line backwards. Changes of the gate
+     * are logged with the number of inferences it saved.
+     */
+
+    bool vad_was_open = vad.open;
+
+    vad_update(&vad,
+               (const MODEL_DT *)(stft_rx_buffer_ptr +
+                                  (stft_line + 1) * STFT_RX_FRAME_LINE_SIZE) -
+                   1,
+               -1);
+
+    if (vad_was_open != vad.open)
+        log_write(&uart_log,
+                  vad.open ? LOG_TYPE_GATE_OPEN : LOG_TYPE_GATE_CLOSE, 0,
+                  loop->inferences_skipped);
+
+    /*
+     * Compute resized rows that have both of their STFT lines
+     * available with this line. Depending on the position in the
+     * frame there are one or two such rows, and sometimes none.
+     */
+
+    for (size_t i = 0; i < MODEL_INPUT_HEIGHT; i++) {
+        const struct resize_tap *tap = &resize.rows[i];
+
+        if (tap->second != stft_line)
+            continue;
 
         /*
-         * To minimize the overhead of copying STFT lines we setup double-
-         * buffering with two DRAM0 buffers to serve alternatively as an
-         * input to ML model. While one buffer is being prepared by copying
-         * spectogram lines from STFT RX buffer, the other one is being used
-         * for running ML inference.
+         * A full line of STFT RX buffer contains magnitudes of complex
+         * Fourier transform, which for purely real input produces
+         * Hermitian symmetry. Thus SPECTROGRAM_WIDTH is equal to
+         * STFT_RX_FRAME_WIDTH / 2 + 1 and the rest of STFT RX line
+         * can be ignored.
+         *
+         * https://en.wikipedia.org/wiki/Fourier_transform
          *
-         * The MODEL_INPUT_WINDOW_NUMBER determines how many windows are
-         * being tracked over a 1 second long spectrogram. For example, if
-         * this is set to 1 there will be an inference every second.
+         * Xilinx FFT documentation recommends taking values from the
+         * second (upper) half of the line due to lesser precision noise.
+         * Thus we read the lines backwards from their last value.
          *
-         * This can be a problem if interesting spectrogram pattern occurs
-         * at the edge, so that it is split between two inferences. When
-         * MODEL_INPUT_WINDOW_NUMBER is set to 4, there will be an inference
-         * every 250ms using a 1/4 of recent spectogram lines and a 3/4 of
-         * lines that already been processed with previous inferences. The
-         * limit to how many windows we can use is the latency of ML inference.
+         * https://docs.xilinx.com/r/en-US/pg109-xfft/Real-Valued-Input-Data
          */
 
-        size_t prepare_index = (stft_line / MODEL_INPUT_STEP) % 2;
-        size_t infer_index = (prepare_index + 1) % 2;
+        const MODEL_DT *first_line_ptr =
+            (const MODEL_DT *)(stft_rx_buffer_ptr +
+                               (tap->first + 1) * STFT_RX_FRAME_LINE_SIZE) -
+            1;
+        const MODEL_DT *second_line_ptr =
+            (const MODEL_DT *)(stft_rx_buffer_ptr +
+                               (tap->second + 1) * STFT_RX_FRAME_LINE_SIZE) -
+            1;
+
+        MODEL_DT *row_ptr =
+            (MODEL_DT *)(loop->ring_ptr +
+                         loop->ring_row * MODEL_PACKED_INPUT_LINE_SIZE);
+
+        resize_row(&resize, i, first_line_ptr, second_line_ptr, -1, row_ptr,
+                   1);
+        detector_push_row(&detector, row_ptr, 1);
+
+        loop->ring_row = (loop->ring_row + 1) % MODEL_RING_HEIGHT;
+        loop->window_rows++;
+    }
 
-        u8 *dram0_prepare_buffer_ptr = drma0_buffer_ptrs[prepare_index];
-        u8 *dram0_infer_buffer_ptr = drma0_buffer_ptrs[infer_index];
+    profile_mark(&profile, PROFILE_STAGE_RESIZE);
 
-        if (stft_line % MODEL_INPUT_STEP == 0) {
+    /*
+     * The MODEL_INPUT_WINDOW_NUMBER determines how many windows are
+     * being tracked over a 1 second long spectrogram. For example, if
+     * this is set to 1 there will be an inference every second.
+     *
+     * This can be a problem if interesting spectrogram pattern occurs
+     * at the edge, so that it is split between two inferences. When
+     * MODEL_INPUT_WINDOW_NUMBER is set to 4, there will be an inference
+     * every 250ms using a 1/4 of recent spectogram lines and a 3/4 of
+     * lines that already been processed with previous inferences. The
+     * limit to how many windows we can use is the latency of ML inference.
+     * Past that limit windows are shed according to MODEL_OVERRUN_POLICY.
+     */
+
+    if (loop->window_rows >= loop->row_step) {
+        loop->window_rows %= loop->row_step;
+
+        expire_batch(loop);
+
+        if (!vad.open) {
 
             /*
-             * If instructions_run_offset is non-zero the current inference
-             * did not finish in time to start new inference.
+             * While the gate is closed there is nothing but background
+             * in the window and the inference would predict silence,
+             * so we skip it. The gate opens on the line of an onset,
+             * so the first window after it is inferred.
              */
 
-            if (instructions_run_offset)
-                goto error;
+            loop->inferences_skipped++;
+            flush_batch(loop);
+        } else if (!detector_is_passed(&detector)) {
 
             /*
-             * New inference buffer is ready. We adjust the TCU program
-             * in-place to set DRAM0 offset configuration. This configuration
-             * instruction was written at offset 0 in initalization phase.
-             * Thus, we temporarily set buffer.offset to 0, then we append
-             * (overwite) the instruction, and restore buffer.offset to its
-             * original value.
+             * The keyword detector found no command in the window, so
+             * the TCU is left idle.
              */
 
-            size_t buffer_offset = buffer.offset;
-            buffer.offset = 0;
+            loop->inferences_rejected++;
+            flush_batch(loop);
+        } else if (!window_batch_is_last(&loop->batch)) {
 
-            error = tensil_buffer_append_config_instruction(
-                &buffer, &layout, TENSIL_CONFIG_REGISTER_DRAM0_OFFSET,
-                TENSIL_CONFIG_DRAM_OFFSET(dram0_infer_buffer_ptr));
+            /*
+             * The window is not the last of a batch, so it waits in the
+             * ring for the batch to be complete.
+             */
 
-            buffer.offset = buffer_offset;
+            window_batch_add(&loop->batch, get_window_first_row(loop));
+        } else if (loop->inference_busy) {
 
             /*
-             * Write "probe" vectors to DRAM0. Vectors need to be filled
-             * with different byte values. Once the TCU performed the
-             * copy at the end of the program, they will contain should be
-             * the same.
+             * The previous inference did not finish in time to start
+             * this one. The window is dropped or left pending
+             * according to MODEL_OVERRUN_POLICY, and the step between
+             * windows is doubled to lower the load on the TCU. When
+             * windows were collected for the batch the oldest of them
+             * is dropped instead, so that the rest stay in the ring.
              */
 
-            tensil_dram_fill_bytes(dram0_infer_buffer_ptr, arch.data_type,
-                                   (TENSIL_ARCHITECTURE_DRAM0_DEPTH - 1) *
-                                       arch.array_size,
-                                   0, arch.array_size);
+            loop->inferences_dropped++;
+            loop->window_pending =
+                window_batch_overrun(&loop->batch, get_window_first_row(loop));
+            loop->on_time_windows = 0;
 
-            tensil_dram_fill_bytes(dram0_infer_buffer_ptr, arch.data_type,
-                                   (TENSIL_ARCHITECTURE_DRAM0_DEPTH - 2) *
-                                       arch.array_size,
-                                   0xff, arch.array_size);
+            if (loop->row_step < MODEL_INPUT_HEIGHT)
+                loop->row_step *= 2;
+
+            log_write(&uart_log, LOG_TYPE_DROP, 0, loop->row_step);
+        } else {
+            loop->window_pending = true;
+            window_batch_complete(&loop->batch);
 
             /*
-             * Start running TCU program to perform the inference. This
-             * will proceed concurrently with acqistion and STFT processing
-             * and may take multiple loop iterations to complete.
+             * Return to the configured step gradually once inferences
+             * keep up with it again.
              */
 
-            error = tensil_compute_unit_start_instructions(
-                &tcu, &buffer, &instructions_run_offset);
+            if (loop->row_step > MODEL_INPUT_ROW_STEP &&
+                ++loop->on_time_windows >= MODEL_ROW_STEP_RECOVERY_WINDOWS) {
+                loop->row_step /= 2;
+                loop->on_time_windows = 0;
+            }
+        }
+    }
+
+    if (loop->window_pending && !loop->inference_busy) {
+        loop->window_pending = false;
 
-            if (error)
-                goto error;
+        error = start_inference(loop);
+
+        if (error)
+            return error;
+
+        profile_mark(&profile, PROFILE_STAGE_TCU);
+    }
+
+    loop->stft_line = (stft_line + 1) % STFT_RX_FRAME_HEIGHT;
+
+    tick(&state);
+
+    return TENSIL_ERROR_NONE;
+}
+
+/*
+ * Processes the next line of the completed hops. Lines queue when the
+ * loop falls behind, and are processed one per event, so that the
+ * acquisition is restarted between them as soon as a packet completes.
+ */
+
+static tensil_error_t handle_stft(void *context) {
+    struct loop *loop = context;
+
+    profile_mark(&profile, PROFILE_STAGE_STFT);
+
+    tensil_error_t error = process_line(loop);
+
+    if (error)
+        return error;
+
+    if (--loop->stft_lines) {
+        scheduler_post(&scheduler, EVENT_STFT);
+    } else if (!loop->stft_hops_busy) {
+        profile_end(&profile);
+        loop->packet_done = true;
+    }
+
+    return TENSIL_ERROR_NONE;
+}
+
+static tensil_error_t handle_tcu(void *context) {
+    struct loop *loop = context;
+    tensil_error_t error = TENSIL_ERROR_NONE;
+
+    /*
+     * The current block of TCU instructions has been consumed. If there
+     * are more instructions we start the next block right away.
+     */
+
+    if (loop->instructions_run_offset != loop->instructions_end_offset) {
+        error = start_instructions(loop);
+
+        if (error)
+            return error;
+
+        profile_mark(&profile, PROFILE_STAGE_TCU);
+
+        return TENSIL_ERROR_NONE;
+    }
+
+    /*
+     * The prologue of a window has been consumed, so the prologue of the
+     * next window or the body follows it. The TCU runs instructions in
+     * order, so the windows are read before the body starts.
+     */
+
+    if (loop->run_window < model.manifest.batch_size) {
+        set_run_window(loop, loop->run_window + 1);
+
+        error = start_instructions(loop);
+
+        if (error)
+            return error;
+
+        profile_mark(&profile, PROFILE_STAGE_TCU);
+
+        return TENSIL_ERROR_NONE;
+    }
+
+    /*
+     * The entire body has been processed by the TCU. This does not
+     * mean that the program is fully completed since some instructions,
+     * like data moves, may continue to be "in-flight". To ensure the
+     * program completion we compare the completion vector with the
+     * number of the inference, which is copied there at the end of the
+     * program. Until they match the event is posted again.
+     */
+
+    if (*get_sequence_ptr(loop, MODEL_COMPLETION_OFFSET_VECTORS) !=
+        loop->sequence)
+        return TENSIL_ERROR_NONE;
+
+    profile_mark(&profile, PROFILE_STAGE_TCU);
+
+    loop->instructions_run_offset = 0;
+
+    /*
+     * The ML inference is complete. DRAM0 contains the predictions
+     * which can be used by argmax.
+     *
+     * But, in order to provide a better basis for probability
+     * thresholding we perform softmax function. This function
+     * normalizes the output of the model to a probability distribution
+     * over predicted output classes.
+     *
+     * https://en.wikipedia.org/wiki/Softmax_function
+     *
+     * The softmax is computed in fixed point directly from the logits
+     * in DRAM0 together with the argmax, so that no floating point
+     * operations need to be emulated by the CPU. The windows of a batch
+     * are handled in the order they were collected.
+     */
+
+    for (size_t i = 0; i < loop->inference_windows; i++) {
+        struct softmax_result result;
+
+        softmax_top2(
+            (const MODEL_DT *)(loop->dram0_buffer_ptr +
+                               (model.manifest.output_offset +
+                                i * model.output_size_vectors) *
+                                   MODEL_VECTOR_SIZE),
+            model.manifest.output_length, &result);
+
+        u8 index = result.first;
+
+        if (handle_event(&state, &result)) {
+            set_leds(get_command_leds(state.current_command));
+            index |= LOG_FLAG_ACTION;
         }
 
-        if (instructions_run_offset) {
+        log_write(&uart_log, LOG_TYPE_PREDICTION, index,
+                  result.probability < LOG_PROBABILITY_ONE
+                      ? result.probability
+                      : LOG_PROBABILITY_ONE - 1);
+    }
 
-            /*
-             * We are currently running the TCU program. Check if the current
-             * block of TCU instructions has been processed. If so, check
-             * of all instructions have been processed.
-             */
+    profile_mark(&profile, PROFILE_STAGE_SOFTMAX);
 
-            if (!tensil_compute_unit_is_instructions_busy(&tcu)) {
-                if (instructions_run_offset == buffer.offset) {
-
-                    /*
-                     * The entire instruction buffer has been processed by
-                     * the TCU. This does not mean that the program is fully
-                     * completed since some instructions, like data moves,
-                     * may continue to be "in-flight". To ensure the program
-                     * completion we compare "probe" vectors that should be
-                     * copied at the end of the program.
-                     */
-
-                    if (tensil_dram_compare_bytes(
-                            dram0_infer_buffer_ptr, arch.data_type,
-                            (TENSIL_ARCHITECTURE_DRAM0_DEPTH - 1) *
-                                arch.array_size,
-                            (TENSIL_ARCHITECTURE_DRAM0_DEPTH - 2) *
-                                arch.array_size,
-                            arch.array_size) == 0) {
-
-                        /*
-                         * The ML inference is complete. DRAM0 contains the
-                         * predictions which can be used by argmax.
-                         *
-                         * But, in order to provide a better basis for
-                         * probability thresholding we perform softmax function.
-                         * This function normalizes the output of the model to a
-                         * probability distribution over predicted output
-                         * classes.
-                         *
-                         * https://en.wikipedia.org/wiki/Softmax_function
-                         *
-                         * We use hardware acceleration to convert DRAM0 fixed
-                         * point values to double precistion floating point, and
-                         * then calculate the exponent function for each value.
-                         * To do this we initiate the transfer (TX) from DRAM0
-                         * and the receiving (RX) to exponent RX buffer.
-                         */
-
-                        error = TENSIL_XILINX_RESULT(XAxiDma_SimpleTransfer(
-                            &exp_axi_dma, (UINTPTR)(dram0_infer_buffer_ptr),
-                            EXP_TX_PACKET_SIZE, XAXIDMA_DMA_TO_DEVICE));
-
-                        if (error)
-                            goto error;
-
-                        error = TENSIL_XILINX_RESULT(XAxiDma_SimpleTransfer(
-                            &exp_axi_dma, (UINTPTR)(exp_rx_buffer_ptr),
-                            EXP_RX_PACKET_SIZE, XAXIDMA_DEVICE_TO_DMA));
-
-                        if (error)
-                            goto error;
-
-                        while (
-                            XAxiDma_Busy(&exp_axi_dma, XAXIDMA_DEVICE_TO_DMA))
-                            ;
-
-                        EXP_DT softmax_buffer[MODEL_OUTPUT_LENGTH];
-                        EXP_DT sum = 0;
-
-                        /*
-                         * We copy exponent RX buffer (DDR) to stack (BRAM)
-                         * to make sure that further calculations are happening
-                         * in the fast memory.
-                         */
-
-                        memcpy((void *)softmax_buffer,
-                               (const void *)exp_rx_buffer_ptr,
-                               EXP_RX_PACKET_SIZE);
-
-                        for (size_t i = 0; i < MODEL_OUTPUT_LENGTH; i++)
-                            sum += softmax_buffer[i];
-
-                        for (size_t i = 0; i < MODEL_OUTPUT_LENGTH; i++)
-                            softmax_buffer[i] = softmax_buffer[i] / sum;
-
-                        EXP_DT max;
-                        size_t max_i =
-                            argmax(MODEL_OUTPUT_LENGTH, softmax_buffer, &max);
-
-                        print_float(max);
-                        print(" ");
-                        print(commands[max_i]);
-
-                        if (handle_event(&state, max_i, max)) {
-                            set_leds(get_command_leds(max_i));
-                            print(" <<<\r\n");
-                        } else
-                            print("\r\n");
-
-                        instructions_run_offset = 0;
-                    }
-
-                } else {
-                    error = tensil_compute_unit_start_instructions(
-                        &tcu, &buffer, &instructions_run_offset);
-
-                    if (error)
-                        goto error;
-                }
-            }
+    loop->inference_busy = false;
+
+    return TENSIL_ERROR_NONE;
+}
+
+/*
+ * Neither the DMAs nor the TCU have their interrupt connected to the
+ * interrupt controller in the Vivado design, so their completions are
+ * polled here and posted as events. With interrupts connected the same
+ * events would be posted by the interrupt handlers. The acquisition is
+ * restarted as soon as it completes, unless as many hops or lines as the
+ * rings allow are in flight or queued.
+ */
+
+static tensil_error_t poll_events(struct loop *loop) {
+    TENSIL_XILINX_RESULT_FRAME
+
+    if (loop->instructions_run_offset && !hal_tcu_is_instructions_busy())
+        scheduler_post(&scheduler, EVENT_TCU);
+
+    if (loop->stft_hops_busy) {
+        size_t hops = 0;
+        tensil_error_t error = TENSIL_XILINX_RESULT(hal_stft_poll(&hops));
+
+        if (error)
+            return error;
+
+        if (hops) {
+            loop->stft_hops_busy -= hops;
+            loop->stft_lines += hops;
+            scheduler_post(&scheduler, EVENT_STFT);
         }
+    }
 
-        /*
-         * Copy a spectrogram lines from STFT RX buffer to DRAM0 prepare
-         * buffer. Since copying the entire spectrogram frame would take
-         * longer than main loop deadline, we schedule copying to be
-         * distributed over its iterations.
-         */
+    if (loop->stft_hops_busy < STFT_MAX_HOPS_BUSY &&
+        loop->stft_hops_busy + loop->stft_lines < STFT_MAX_LINES_AHEAD &&
+        !hal_acq_is_busy())
+        scheduler_post(&scheduler, EVENT_ACQ);
 
-        for (size_t i = 0; i < MODEL_INPUT_WINDOW_NUMBER; i++) {
-            int shifted_line = stft_line - i * MODEL_INPUT_STEP;
+    return TENSIL_ERROR_NONE;
+}
 
-            size_t stft_source_line = shifted_line < 0
-                                          ? STFT_RX_FRAME_HEIGHT + shifted_line
-                                          : shifted_line;
-            size_t model_dest_line =
-                (stft_line % MODEL_INPUT_STEP) +
-                (MODEL_INPUT_WINDOW_NUMBER - 1 - i) * MODEL_INPUT_STEP;
+int main() {
+    tensil_error_t error = TENSIL_ERROR_NONE;
 
-            u8 *stft_rx_line_ptr =
-                stft_rx_buffer_ptr + stft_source_line * STFT_RX_FRAME_LINE_SIZE;
-            u8 *dram0_line_ptr = dram0_prepare_buffer_ptr +
-                                 model_dest_line * MODEL_INPUT_LINE_SIZE;
+    TENSIL_XILINX_RESULT_FRAME
 
-            /*
-             * STFT values appear in the "channel" dimension of ML model,
-             * which needs to be aligned on TENSIL_ARCHITECTURE_ARRAY_SIZE.
-             * This means that the STFT value will occupy the first position
-             * of a channels vector and the rest needs to be filled with zeros.
-             */
+    error = TENSIL_XILINX_RESULT(hal_init());
+
+    if (error)
+        goto error;
+
+    /*
+     * Flash all LEDs to indicate initialization.
+     */
+
+    set_leds(LED_0 | LED_1 | LED_2 | LED_3);
+
+    /*
+     * Initialize various buffers in DDR.
+     */
+
+    u8 *stft_rx_bd_space = MEMORY_GET_PTR(stft_rx_bd_space);
+    u8 *stft_tx_bd_space = MEMORY_GET_PTR(stft_tx_bd_space);
+    u8 *acq_ring_ptr = MEMORY_GET_PTR(acq_ring);
+    u8 *stft_rx_buffer_ptr = MEMORY_GET_PTR(stft_rx_buffer);
+    u8 *dram0_buffer_ptr = MEMORY_GET_PTR(dram0_buffer);
+    u8 *dram1_buffer_ptr = MEMORY_GET_PTR(dram1_buffer);
+    u8 *prog_buffer_ptr = MEMORY_GET_PTR(prog_buffer);
+
+    print_memory_map();
+
+    /*
+     * Initialize acquisition DMA.
+     */
+
+    error = TENSIL_XILINX_RESULT(hal_acq_init());
+
+    if (error)
+        goto error;
+
+    /*
+     * Once acquisition DMA is initialize we can release microhone SPI
+     * from reset. Otherwise the sporadic ready signals sent by Xilinx
+     * AXI DMA will upset SPI packet counter.
+     */
+
+    hal_acq_release_reset();
+
+    /*
+     * Initialize STFT scatter-gather DMA.
+     */
+
+    error = TENSIL_XILINX_RESULT(hal_stft_init(
+        stft_rx_bd_space, stft_tx_bd_space, STFT_RING_DEPTH));
+
+    if (error)
+        goto error;
+
+    /*
+     * Initialze buffers to zero since we will be using them while
+     * not fully filled for sliding windows.
+     */
+
+    memset((void *)acq_ring_ptr, 0, ACQ_RING_SIZE);
+    memset((void *)stft_rx_buffer_ptr, 0, STFT_RX_FRAME_SIZE);
+
+    /*
+     * Each STFT TX packet is comprised of two acqisition packet to
+     * represent a sliding window over acqisition samples. This sliding
+     * window is required to produce STFT, which we will call a spectogram.
+     *
+     * https://en.wikipedia.org/wiki/Short-time_Fourier_transform
+     *
+     * The STFT DMA reads the window in place from the acquisition ring,
+     * so the transfer side (TX) uses two DMA blocks, one for each
+     * packet. Receiving side (RX) uses one block to place resulting STFT
+     * RX line into STFT RX frame. This frame height is defined by the
+     * model input dimentions, which is 124 so that each frame represents
+     * 1 second spectogram at 16Hz sample rate.
+     */
+
+    for (size_t i = 0; i < STFT_RING_DEPTH; i++) {
+        size_t first_slot = (i + ACQ_RING_LENGTH - 1) % ACQ_RING_LENGTH;
+        size_t second_slot = i % ACQ_RING_LENGTH;
+
+        error = TENSIL_XILINX_RESULT(hal_stft_prepare(
+            i, acq_ring_ptr + first_slot * ACQ_PACKET_SIZE,
+            acq_ring_ptr + second_slot * ACQ_PACKET_SIZE, ACQ_PACKET_SIZE,
+            stft_rx_buffer_ptr +
+                (i % STFT_RX_FRAME_HEIGHT) * STFT_RX_FRAME_LINE_SIZE,
+            STFT_RX_FRAME_LINE_SIZE));
+
+        if (error)
+            goto error;
+    }
+
+    resize_init(&resize, SPECTROGRAM_HEIGHT, SPECTROGRAM_WIDTH);
+
+    /*
+     * Keep the gate open for a frame past the last voiced line, so that
+     * every window containing voiced lines is inferred.
+     */
+
+    vad_init(&vad, STFT_RX_FRAME_HEIGHT);
+    detector_init(&detector, NULL);
+
+    /*
+     * TENSIL_ARCHITECTURE parameters come from architecture_params.h
+     * created by `tensil rtl` tool based on architecture definition in
+     * ./arch/speech_robot.tarch.
+     */
+
+    struct tensil_architecture arch = {
+        .array_size = TENSIL_ARCHITECTURE_ARRAY_SIZE,
+        .data_type = TENSIL_ARCHITECTURE_DATA_TYPE,
+        .local_depth = TENSIL_ARCHITECTURE_LOCAL_DEPTH,
+        .accumulator_depth = TENSIL_ARCHITECTURE_ACCUMULATOR_DEPTH,
+        .dram0_depth = TENSIL_ARCHITECTURE_DRAM0_DEPTH,
+        .dram1_depth = TENSIL_ARCHITECTURE_DRAM1_DEPTH,
+        .stride0_depth = TENSIL_ARCHITECTURE_STRIDE0_DEPTH,
+        .stride1_depth = TENSIL_ARCHITECTURE_STRIDE1_DEPTH,
+        .simd_registers_depth = TENSIL_ARCHITECTURE_SIMD_REGISTERS_DEPTH,
+    };
 
-            memset((void *)dram0_line_ptr, 0, MODEL_INPUT_LINE_SIZE);
+    if (!tensil_architecture_is_valid(&arch))
+        goto error;
+
+    struct tensil_instruction_layout layout;
+
+    tensil_instruction_layout_init(&layout, &arch);
+
+    error = hal_tcu_init();
+
+    if (error)
+        goto error;
+
+    loop.acq_ring_ptr = acq_ring_ptr;
+    loop.stft_rx_buffer_ptr = stft_rx_buffer_ptr;
+    loop.dram0_buffer_ptr = dram0_buffer_ptr;
+    loop.dram1_buffer_ptr = dram1_buffer_ptr;
+    loop.arch = arch;
+    loop.layout = layout;
+    loop.buffer.ptr = prog_buffer_ptr;
+    loop.buffer.size = TENSIL_INSTRUCTION_BUFFER_SIZE;
+    loop.row_step = MODEL_INPUT_ROW_STEP;
+    loop.packet_done = true;
+
+    error = state_init(&state);
+
+    if (error)
+        goto error;
+
+    log_init(&uart_log, NULL, 0);
+
+    /*
+     * Boot the model in the default slot, or in the first slot after
+     * it with an image that loads. An image with a valid header can
+     * still fail to load, for example when a section is corrupt.
+     */
+
+    bool model_loaded = false;
+
+    for (size_t i = 0; i < MODEL_FLASH_SLOTS && !model_loaded; i++) {
+        size_t slot = (MODEL_DEFAULT_SLOT + i) % MODEL_FLASH_SLOTS;
+        struct image_header header;
+
+        if (read_model_header(&loop, slot, &header) != XST_SUCCESS)
+            continue;
+
+        model_loaded = load_model(&loop, slot, &header) == TENSIL_ERROR_NONE;
+
+        if (!model_loaded)
+            xil_printf("model %d: failed to load\r\n", (int)slot);
+    }
+
+    if (!model_loaded) {
+        xil_printf("no valid model image\r\n");
+        goto error;
+    }
+
+    loop.requested_slot = model.slot;
+
+    set_leds(get_command_leds(state.current_command));
+
+    /*
+     * The main loop is profiled with the HAL timer. Time when the loop
+     * has no events to dispatch is attributed to the wait stage and is
+     * the headroom left for more work.
+     */
+
+    profile_init(&profile, hal_get_ticks_per_second(), ACQ_PACKET_PERIOD_US);
+    profile_start(&profile);
+
+    scheduler_init(&scheduler, &loop);
+    scheduler_register(&scheduler, EVENT_TCU, handle_tcu);
+    scheduler_register(&scheduler, EVENT_STFT, handle_stft);
+    scheduler_register(&scheduler, EVENT_ACQ, handle_acq);
+
+    /* The main loop starts with initiating DMA transfer of
+     * of acqisition packet and ends with waiting for it to
+     * complete. At 16Hz sampling rate it takes 8ms to acquire
+     * 128 samples. Therefore, everything that happens between
+     * initiating the transfer and its wait loop must take less
+     * than 8ms. Otherwise samples will be dropped.
+     *
+     * The work is split between handlers of the events that complete
+     * each step. Blocks of the TCU program are started as soon as the
+     * previous block is consumed, whether or not the loop is waiting
+     * for the packet, so that an inference takes as little time as
+     * the TCU allows. The acquisition is restarted as soon as the
+     * packet completes, so the 8ms only need to hold on average: the
+     * work for a packet can spill into the following periods while
+     * hops queue up to the limits of the rings. Once the input ends
+     * the loop runs until the lines of all hops are processed.
+     */
+
+    while (hal_is_running() || loop.stft_hops_busy || loop.stft_lines) {
+        error = poll_events(&loop);
+
+        if (error)
+            goto error;
+
+        if (scheduler_is_idle(&scheduler)) {
 
             /*
-             * A full line of STFT RX buffer contains magnitudes of complex
-             * Fourier transform, which for purely real input produces
-             * Hermitian symmetry. Thus MODEL_INPUT_WIDTH is equal to
-             * STFT_RX_FRAME_WIDTH / 2 + 1 and the rest of STFT RX line
-             * can be ignored.
-             *
-             * https://en.wikipedia.org/wiki/Fourier_transform
-             *
-             * Xilinx FFT documentation recommends taking values from the
-             * second (upper) half of the line due to lesser precision noise.
-             *
-             * https://docs.xilinx.com/r/en-US/pg109-xfft/Real-Valued-Input-Data
+             * Transmit the log while there is nothing else to do. The
+             * UART takes about 87us per byte at 115200 baud, so a
+             * prediction line takes 2 ms and is spread over the waits
+             * of several packets.
              */
 
-            for (size_t j = 0; j < MODEL_INPUT_WIDTH; j++) {
-                ((MODEL_DT *)dram0_line_ptr)[j * MODEL_VECTOR_LENGTH] = ((
-                    MODEL_DT *)stft_rx_line_ptr)[STFT_RX_FRAME_WIDTH - (j + 1)];
-            }
+            log_drain(&uart_log);
+            hal_idle();
+
+            loop.idle = true;
+            continue;
         }
 
-        stft_line = (stft_line + 1) % STFT_RX_FRAME_HEIGHT;
+        if (loop.idle) {
+            profile_mark(&profile, PROFILE_STAGE_WAIT);
+            loop.idle = false;
+        }
 
-        tick(&state);
+        error = scheduler_dispatch(&scheduler);
 
-        while (XAxiDma_Busy(&acq_axi_dma, XAXIDMA_DEVICE_TO_DMA))
-            ;
+        if (error)
+            goto error;
     }
 
+    while (!log_drain(&uart_log))
+        ;
+
+    profile_print(&profile);
+    print_counters(&loop);
+
 error:
     return 0;
 }
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include "vad.h"
+
+void vad_init(struct vad *vad, size_t hangover_lines) {
+
+    /*
+     * The floor starts high and falls to the background within the
+     * first few dozen lines. Until then onsets cannot be detected, so
+     * the gate starts open for the hangover.
+     */
+
+    vad->floor = UINT32_MAX;
+    vad->hangover = hangover_lines;
+    vad->hangover_lines = hangover_lines;
+    vad->open = true;
+    vad->onsets = 0;
+}
+
+static u32 get_energy(const VAD_DT *line, int stride) {
+    u32 energy = 0;
+
+    for (int j = VAD_BAND_FIRST; j <= VAD_BAND_LAST; j++) {
+        VAD_DT value = line[j * stride];
+
+        if (value > 0)
+            energy += value;
+    }
+
+    return energy;
+}
+
+bool vad_update(struct vad *vad, const VAD_DT *line, int stride) {
+    u32 energy = get_energy(line, stride);
+    u32 floor = vad->floor >> VAD_FLOOR_FRACTION_BITS;
+    u32 ratio = vad->open ? VAD_RELEASE_RATIO : VAD_ONSET_RATIO;
+
+    bool voiced = energy >= VAD_MIN_ENERGY &&
+                  energy * VAD_RATIO_ONE > floor * ratio;
+
+    if (voiced) {
+        if (!vad->open)
+            vad->onsets++;
+
+        vad->open = true;
+        vad->hangover = vad->hangover_lines;
+    } else if (vad->hangover) {
+        vad->hangover--;
+    } else
+        vad->open = false;
+
+    u32 scaled_energy = energy << VAD_FLOOR_FRACTION_BITS;
+
+    if (scaled_energy < vad->floor)
+        vad->floor -= (vad->floor - scaled_energy) >> VAD_FLOOR_FALL_SHIFT;
+    else
+        vad->floor += (scaled_energy - vad->floor) >> VAD_FLOOR_RISE_SHIFT;
+
+    return vad->open;
+}
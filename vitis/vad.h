@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "xil_types.h"
+
+/*
+ * Voice activity gate over STFT lines. It decides whether there is
+ * anything in the spectrogram worth running the model on, so that the
+ * TCU can stay idle on silence.
+ *
+ * The energy of a line is the sum of its magnitudes in the speech band
+ * from VAD_BAND_FIRST to VAD_BAND_LAST bins. A noise floor tracks the
+ * energy, falling quickly to quieter lines and rising slowly to louder
+ * ones, so that it follows the background but not speech. The gate
+ * opens on the line whose energy exceeds VAD_ONSET_RATIO times the
+ * floor. Once open, lines above the lower VAD_RELEASE_RATIO times the
+ * floor count as voiced, and the gate closes `hangover` lines after
+ * the last voiced line.
+ *
+ * Ratios are in units of 1 / VAD_RATIO_ONE. The floor is kept with
+ * VAD_FLOOR_FRACTION_BITS fraction bits so that the slow rise does not
+ * round to zero.
+ */
+
+#define VAD_DT int16_t
+
+#define VAD_BAND_FIRST 4
+#define VAD_BAND_LAST 64
+
+#define VAD_RATIO_ONE 16
+#define VAD_ONSET_RATIO (4 * VAD_RATIO_ONE)
+#define VAD_RELEASE_RATIO (2 * VAD_RATIO_ONE)
+
+/*
+ * Energy below which lines are never voiced, so that digital silence
+ * with its floor at zero does not open the gate on the smallest noise.
+ */
+
+#define VAD_MIN_ENERGY 512
+
+#define VAD_FLOOR_FRACTION_BITS 8
+#define VAD_FLOOR_FALL_SHIFT 2
+#define VAD_FLOOR_RISE_SHIFT 10
+
+struct vad {
+    u32 floor;
+    size_t hangover;
+    size_t hangover_lines;
+    bool open;
+
+    u32 onsets;
+};
+
+void vad_init(struct vad *vad, size_t hangover_lines);
+
+/*
+ * Updates the gate with the next STFT line. Bin j of the line is at
+ * `line[j * stride]`, where `stride` can be negative. Returns true when
+ * the gate is open after the line.
+ */
+
+bool vad_update(struct vad *vad, const VAD_DT *line, int stride);
@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#include <string.h>
+
+#include "window_batch.h"
+
+void window_batch_init(struct window_batch *batch, size_t size,
+                       bool coalesce, size_t ring_height, size_t max_age) {
+    if (size > WINDOW_BATCH_MAX_SIZE)
+        size = WINDOW_BATCH_MAX_SIZE;
+
+    batch->size = size;
+    batch->coalesce = coalesce;
+    batch->ring_height = ring_height;
+    batch->max_age = max_age;
+    batch->length = 0;
+    batch->latest = false;
+}
+
+static void drop_oldest(struct window_batch *batch, size_t length) {
+    memmove(batch->rows, batch->rows + length,
+            (batch->length - length) * sizeof(size_t));
+    batch->length -= length;
+}
+
+size_t window_batch_expire(struct window_batch *batch, size_t row) {
+    size_t length = 0;
+
+    while (length < batch->length &&
+           (row + batch->ring_height - batch->rows[length]) %
+                   batch->ring_height >
+               batch->max_age)
+        length++;
+
+    drop_oldest(batch, length);
+
+    return length;
+}
+
+void window_batch_add(struct window_batch *batch, size_t row) {
+    batch->rows[batch->length++] = row;
+}
+
+void window_batch_complete(struct window_batch *batch) {
+    batch->latest = true;
+}
+
+bool window_batch_overrun(struct window_batch *batch, size_t row) {
+    if (!batch->length) {
+        batch->latest = batch->coalesce;
+        return batch->latest;
+    }
+
+    drop_oldest(batch, 1);
+
+    /*
+     * The window on the latest rows takes the place of the window that
+     * was due when the batch is started. Collecting both would infer
+     * the same window twice when no rows are written in between.
+     */
+
+    if (batch->coalesce)
+        batch->latest = true;
+    else
+        window_batch_add(batch, row);
+
+    return batch->latest;
+}
+
+size_t window_batch_start(struct window_batch *batch, size_t row,
+                          size_t *rows) {
+    size_t length = batch->length;
+
+    memcpy(rows, batch->rows, length * sizeof(size_t));
+
+    if (batch->latest)
+        rows[length++] = row;
+
+    for (size_t i = length; i < batch->size; i++)
+        rows[i] = rows[length - 1];
+
+    batch->length = 0;
+    batch->latest = false;
+
+    return length;
+}
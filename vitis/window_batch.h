@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/* Copyright © 2019-2022 Tensil AI Company */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Windows collected for the next batch of a model compiled for a batch
+ * of windows. Windows are given by their first row in the ring of model
+ * input rows, in the order they are due. The batch is started either
+ * with the window on the latest rows as its last window, or when no
+ * more windows pass the gates, with the windows collected so far,
+ * completed by repeating the last of them.
+ *
+ * When the last window of a batch is due while the previous inference
+ * is still running, the oldest collected window is dropped. With
+ * `coalesce` the batch is then completed by the window on the latest
+ * rows once it is started, so that any number of missed windows become
+ * one, and otherwise the window that was due is collected in place of
+ * the dropped one. Either way every window is inferred at most once,
+ * and the windows of a batch are in the order they were due.
+ *
+ * Collected windows wait in the ring while rows are written. Windows
+ * that start more than `max_age` rows before the latest window expire,
+ * so that the TCU never reads rows that were overwritten.
+ */
+
+#ifndef WINDOW_BATCH_MAX_SIZE
+#define WINDOW_BATCH_MAX_SIZE 4
+#endif
+
+struct window_batch {
+    size_t size;
+    bool coalesce;
+    size_t ring_height;
+    size_t max_age;
+
+    size_t rows[WINDOW_BATCH_MAX_SIZE];
+    size_t length;
+
+    /*
+     * Whether the window on the latest rows completes the batch.
+     */
+
+    bool latest;
+};
+
+/*
+ * Initializes an empty batch of `size` windows, at most
+ * WINDOW_BATCH_MAX_SIZE, in a ring of `ring_height` rows. `max_age`
+ * must leave room in the ring for more than the rows between two
+ * calls of `window_batch_expire`.
+ */
+
+void window_batch_init(struct window_batch *batch, size_t size,
+                       bool coalesce, size_t ring_height, size_t max_age);
+
+/*
+ * Drops collected windows that start more than `max_age` rows before
+ * `row`, the first row of the latest window. Returns the number of
+ * windows dropped.
+ */
+
+size_t window_batch_expire(struct window_batch *batch, size_t row);
+
+/*
+ * Returns true when the next window due completes the batch.
+ */
+
+static inline bool window_batch_is_last(const struct window_batch *batch) {
+    return batch->latest || batch->length + 1 >= batch->size;
+}
+
+/*
+ * Collects the window starting at `row`, which does not complete the
+ * batch.
+ */
+
+void window_batch_add(struct window_batch *batch, size_t row);
+
+/*
+ * Completes the batch with the window on the latest rows.
+ */
+
+void window_batch_complete(struct window_batch *batch);
+
+/*
+ * Handles the last window of the batch, starting at `row`, being due
+ * while the previous inference is still running. Returns true when the
+ * batch is to be started on the latest rows once the TCU is free.
+ */
+
+bool window_batch_overrun(struct window_batch *batch, size_t row);
+
+/*
+ * Returns true when there is nothing to start. A batch that is not
+ * empty can be started before it is complete.
+ */
+
+static inline bool window_batch_is_empty(const struct window_batch *batch) {
+    return !batch->length && !batch->latest;
+}
+
+/*
+ * Starts the batch, which must not be empty. Writes the first rows of
+ * its `size` windows to `rows`, where `row` is the first row of the
+ * latest window, and returns the number of windows that were not
+ * repeated to complete it. The batch is then empty.
+ */
+
+size_t window_batch_start(struct window_batch *batch, size_t row,
+                          size_t *rows);